@@ -4,10 +4,15 @@
 #include <glad/glad.h>
 #include <imgui/imgui_impl_sdl.h>
 #include <imgui/imgui_impl_opengl3.h>
+#include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <algorithm>
+#include <chrono>
 
 #include "imguiExt.hpp"
+#include "tracing.hpp"
 
 #define AINI_IMPLEMENTATION
 #include "aini.hpp"
@@ -61,6 +66,50 @@ static void initDockspace()
 	ImGui::End();
 }
 
+static ImU32 changeHeatColor(ImU8 const*, size_t offset, void* userData)
+{
+	uint8_t const heat = static_cast<ChangeHeat const*>(userData)->at(static_cast<uint16_t>(offset));
+	if (heat == 0)
+		return 0;
+	// fresh changes are red, they fade through orange and yellow
+	uint8_t const green = static_cast<uint8_t>(255 - heat * 3 / 4);
+	uint8_t const alpha = static_cast<uint8_t>(32 + heat * 5 / 8);
+	return IM_COL32(255, green, 0, alpha);
+}
+
+// settings section of a rom's cheats, the title and the global checksum
+static std::string cheatSettingsKeyFor(MMU const& mmu)
+{
+	std::string key = "cheats-";
+	for (size_t i = 0; i < 16 && mmu.memMap[MMU::titleAddress + i] != 0; i++)
+	{
+		char const c = static_cast<char>(mmu.memMap[MMU::titleAddress + i]);
+		key += isalnum(static_cast<unsigned char>(c)) ? c : '_';
+	}
+	char checksum[8];
+	snprintf(checksum, sizeof(checksum), "-%02X%02X", mmu.memMap[0x014E], mmu.memMap[0x014F]);
+	return key + checksum;
+}
+
+// creates the texture the first time, nearest filtering keeps the pixels sharp when zoomed
+static void uploadTexture(unsigned int& texture, uint32_t width, uint32_t height, uint32_t const* rgba)
+{
+	bool const created = texture == 0;
+	if (created)
+	{
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+	}
+	else
+	{
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+	}
+}
+
 static std::string readTextFile(std::filesystem::path const& path)
 {
 	std::ifstream const settingsFile(path);
@@ -136,16 +185,49 @@ void App::init()
     ImGui_ImplOpenGL3_Init();
 
 	mem_edit.Open = false;
+	mem_edit.BgColorFn = changeHeatColor;
+	mem_edit.UserData = &memoryHeat;
 	openDialog.SetTitle("File browser");
 	saveDialog.SetTitle("Save dialog");
 	
 	if (std::filesystem::exists(fileSettingsPath))
 	{
 		aini::Reader reader(readTextFile(fileSettingsPath));
+		if (reader.has_key("cheatRoms"))
+		{
+			std::string const roms = reader.get_string("cheatRoms");
+			for (size_t start = 0; start < roms.size();)
+			{
+				size_t const end = std::min(roms.find(',', start), roms.size());
+				std::string const section = roms.substr(start, end - start);
+				std::vector<std::string>& lines = savedCheats[section];
+				aini::Int_t const count = reader.has_key("count", section.c_str()) ? reader.get_int("count", section.c_str()) : 0;
+				for (aini::Int_t i = 0; i < count; i++)
+				{
+					std::string const key = "cheat" + std::to_string(i);
+					if (reader.has_key(key.c_str(), section.c_str()))
+						lines.push_back(reader.get_string(key.c_str(), section.c_str()));
+				}
+				start = end + 1;
+			}
+		}
+		if (reader.has_key("gameIntegerScale"))
+			gameIntegerScale = reader.get_int("gameIntegerScale") != 0;
+		if (reader.has_key("gameFilter"))
+		{
+			int const filter = std::clamp(static_cast<int>(reader.get_int("gameFilter")), 0, static_cast<int>(upscale::Filter::count) - 1);
+			gameFilter = static_cast<upscale::Filter>(filter);
+		}
+		if (reader.has_key("frameskip"))
+		{
+			frameskip = std::clamp(static_cast<int>(reader.get_int("frameskip")), 0, 9);
+			gb.ppu.frameskip = frameskip;
+		}
 		if (reader.has_key("lastRomPath"))
 		{
 			try {
-				loadRom(reader.get_string("lastRomPath"));
+				lastRomPath = reader.get_string("lastRomPath");
+				loadRom(lastRomPath);
 			}
 			catch (std::exception const& e) {
 				fprintf(stderr, "%s", e.what());
@@ -180,7 +262,10 @@ void App::startFrame()
 void App::endFrame()
 {
 	glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-	ImGui::Render();
+	{
+		GB_TRACE_ZONE("ImGui::Render");
+		ImGui::Render();
+	}
 	
 	ImGuiIO& io = ImGui::GetIO();
 	if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
@@ -189,7 +274,11 @@ void App::endFrame()
 		ImGui::RenderPlatformWindowsDefault();
 	}
 
-	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+	{
+		GB_TRACE_ZONE("RenderDrawData");
+		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+	}
+	GB_TRACE_ZONE("SDL_GL_SwapWindow");
 	SDL_GL_SwapWindow(window);
 }
 
@@ -197,23 +286,82 @@ void App::run()
 {
 	while (!endApp)
 	{
-		startFrame();
-		update();
-		onGUI();
+#ifdef GB_TRACING
+		tracing::frameMark();
+#endif
+		GB_TRACE_ZONE("frame");
+		{
+			GB_TRACE_ZONE("startFrame");
+			startFrame();
+		}
+		{
+			GB_TRACE_ZONE("update");
+			update();
+		}
+		{
+			GB_TRACE_ZONE("onGUI");
+			onGUI();
+		}
+		GB_TRACE_ZONE("endFrame");
 		endFrame();
 	}
 }
 
 void App::update()
 {
+	if (codeAnalysis.valid() && codeAnalysis.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+	{
+		codeMap = codeAnalysis.get();
+		disassembly.setCodeMap(&codeMap);
+		disassembly.build(gb.mmu.memMap);
+		printf("code analysis: %u instructions, %u data bytes\n", codeMap.instructionCount, codeMap.dataBytes);
+	}
+
+	if (symbolLoad.valid() && symbolLoad.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+	{
+		symbols = symbolLoad.get();
+		printf("loaded %zu symbols\n", symbols.size());
+		routineEntries = findRoutineEntries(gb.mmu, &symbols);
+	}
+
 	if (gbStarted)
 	{
-		if ((stepDebug && nextStep) || !stepDebug)
+		if (!stepDebug)
+		{
+			// a whole emulated frame per host frame, so timed events like pc sampling run too
+			if (rewindEnabled)
+				rewind.capture(gb);
+			Gameboy::RunResult const result = gb.runFrame();
+			if (result == Gameboy::RunResult::Breakpoint || result == Gameboy::RunResult::Watchpoint)
+			{
+				// pauses into step debugging, the Disassembler jumps to the breakpoint
+				stepDebug = true;
+				scrollToPc = true;
+				debuggerOpen = true;
+			}
+		}
+		else if (nextStep)
 		{
-			gb.cpuStep();
+			// single steps log the joypad too, a change between two of them would be lost otherwise
+			if (rewindEnabled)
+				rewind.capture(gb);
+			gb.step();
 			nextStep = false;
 		}
 	}
+
+	if (mem_edit.Open && highlightChanges)
+	{
+		// any change of ticks counts, a step back or a loaded state shows what it changed too
+		GB_TRACE_ZONE("memory diff");
+		if (memoryHeatTicks == UINT64_MAX)
+			memoryHeat.reset(gb.mmu.memMap);
+		else if (gb.ticks != memoryHeatTicks)
+			memoryHeat.update(gb.mmu.memMap);
+		memoryHeatTicks = gb.ticks;
+	}
+	else
+		memoryHeatTicks = UINT64_MAX;
 }
 
 void App::onGUI()
@@ -233,6 +381,12 @@ void App::onGUI()
 			{
 				saveDialog.Open();
 			}
+
+			if (ImGui::MenuItem("Export disassembly", nullptr, false, romLoaded))
+			{
+				if (disassembly.writeListing(disassemblyExportPath, !symbols.empty() ? &symbols : nullptr))
+					printf("disassembly written to \"%s\"\n", disassemblyExportPath);
+			}
 			
 			ImGui::EndMenu();
 		}
@@ -242,17 +396,49 @@ void App::onGUI()
 			if (ImGui::MenuItem("Start Game"))
 			{
 				gb.start();
+				rewind.reset();
+				gameDrawnFrames = UINT64_MAX;
 				gbStarted = true;
 			}
+			ImGui::SetNextItemWidth(ImGui::GetFontSize() * 6);
+			if (ImGui::SliderInt("Frameskip", &frameskip, 0, 9))
+			{
+				gb.ppu.frameskip = frameskip;
+				saveSettings();
+			}
+			if (ImGui::BeginMenu("Upscale filter"))
+			{
+				for (int i = 0; i < static_cast<int>(upscale::Filter::count); i++)
+				{
+					upscale::Filter const filter = static_cast<upscale::Filter>(i);
+					if (ImGui::MenuItem(upscale::filterName(filter), nullptr, gameFilter == filter) && gameFilter != filter)
+					{
+						gameFilter = filter;
+						// the picture on screen is filtered again even while paused
+						gameDrawnFrames = UINT64_MAX;
+						saveSettings();
+					}
+				}
+				ImGui::EndMenu();
+			}
 			ImGui::EndMenu();
 		}
 		
 		if (ImGui::BeginMenu("Tools"))
 		{
+			if (ImGui::MenuItem("Game", nullptr, gameOpen))
+			{
+				gameOpen = !gameOpen;
+			}
 			if (ImGui::MenuItem("Memory editor"))
 			{
 				mem_edit.Open = !mem_edit.Open;
 			}
+			if (ImGui::MenuItem("Highlight memory changes", nullptr, highlightChanges))
+			{
+				highlightChanges = !highlightChanges;
+				mem_edit.BgColorFn = highlightChanges ? changeHeatColor : nullptr;
+			}
 			if (ImGui::MenuItem("Disassembler"))
 			{
 				disassemblerOpen = !disassemblerOpen;
@@ -261,10 +447,41 @@ void App::onGUI()
 			{
 				spriteViewerOpen = !spriteViewerOpen;
 			}
+			if (ImGui::MenuItem("Tile viewer"))
+			{
+				tileViewerOpen = !tileViewerOpen;
+			}
 			if (ImGui::MenuItem("Debbugger"))
 			{
 				debuggerOpen = !debuggerOpen;
 			}
+			if (ImGui::MenuItem("Frame timings"))
+			{
+				frameTimingsOpen = !frameTimingsOpen;
+			}
+			if (ImGui::MenuItem("RAM search"))
+			{
+				ramSearchOpen = !ramSearchOpen;
+			}
+			if (ImGui::MenuItem("Cheats"))
+			{
+				cheatsOpen = !cheatsOpen;
+			}
+			if (ImGui::MenuItem("Code/data logger", nullptr, gb.mmu.codeDataLog != nullptr))
+				gb.mmu.setCodeDataLog(gb.mmu.codeDataLog == nullptr ? &codeDataLog : nullptr);
+			if (ImGui::MenuItem("Export CDL", nullptr, false, gb.mmu.codeDataLog != nullptr))
+			{
+				CodeDataLog::Coverage const coverage = codeDataLog.coverage();
+				if (codeDataLog.save(cdlExportPath))
+					printf("code/data log written to \"%s\", %u code and %u data bytes\n", cdlExportPath, coverage.code, coverage.data);
+			}
+#ifdef GB_TRACING
+			if (ImGui::MenuItem("Export trace"))
+			{
+				if (tracing::exportChromeTrace(traceExportPath))
+					printf("trace written to \"%s\"\n", traceExportPath);
+			}
+#endif
 			if (ImGui::MenuItem("demo win"))
 			{
 				showDemo = !showDemo;
@@ -276,17 +493,28 @@ void App::onGUI()
 	}
 
 	if (mem_edit.Open)
+	{
+		// edits go straight to memMap, around the mmu, so the entries they changed are flagged
+		// the way writeSlow would and the sprite index only looks at those again
+		uint8_t oam[MMU::oamSize];
+		memcpy(oam, &gb.mmu.memMap[MMU::oamAddress], sizeof(oam));
 		mem_edit.DrawWindow("Memory Editor", gb.mmu.memMap, sizeof(gb.mmu.memMap));
+		for (uint16_t i = 0; i < MMU::oamSize; i++)
+		{
+			if (oam[i] != gb.mmu.memMap[MMU::oamAddress + i] && (i & 3) < 2)
+				gb.mmu.oamWrites |= uint64_t(1) << (i / 4);
+		}
+		// nothing else writes rom, the disassembler only compares ram
+		disassembly.refresh(gb.mmu.memMap, 0, MMU::romSize);
+	}
 
 	openDialog.Display();
 	if (openDialog.HasSelected())
 	{
 		std::string const filePathStr = openDialog.GetSelected().string();
 		printf("selected file \"%s\"\n", filePathStr.c_str());
-		aini::Writer writer;
-		writer.set_string("lastRomPath", filePathStr);
-		std::ofstream settings(fileSettingsPath);
-		settings << writer.write();
+		lastRomPath = filePathStr;
+		saveSettings();
 		
 		loadRom(openDialog.GetSelected());
 		openDialog.ClearSelected();
@@ -302,38 +530,7 @@ void App::onGUI()
 	}
 	
 	if (disassemblerOpen)
-	{
-		ImGui::Begin("Disassembler", &disassemblerOpen);
-		static int minAddress = 0, maxAddress = MMU::romSize / 16;
-		ImGui::DragIntRange2("address", &minAddress, &maxAddress, 1, 0, MMU::romSize, "0x%04X");
-		ImGuiTableFlags constexpr flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg;
-		if (ImGui::BeginTable("disassembler table", 3, flags))
-		{
-			ImGui::PushStyleColor(ImGuiCol_Text, IM_COL32(255, 0, 0, 255));
-			ImGui::TableSetupColumn("address");
-			ImGui::TableSetupColumn("byte");
-			ImGui::TableSetupColumn("code");
-			ImGui::PopStyleColor();
-			ImGui::TableHeadersRow();
-			
-			for (uint16_t i = minAddress; i < maxAddress;)
-			{
-				ImGui::TableNextColumn();
-				if (gb.registers.pc == i)
-					ImGui::PushStyleColor(ImGuiCol_Text, IM_COL32(255, 0, 0, 255));
-				ImGui::Text("0x%04X\n", i);
-				ImGui::TableNextColumn();
-				ImGui::Text("0x%02X\n", gb.mmu.rom()[i]);
-				ImGui::TableNextColumn();
-				ImGui::TextUnformatted(gb.disassembleInstruction(i).c_str());
-				if (gb.registers.pc == i)
-					ImGui::PopStyleColor();
-				i += instructions[gb.mmu.rom()[i]].len > 0 ? instructions[gb.mmu.rom()[i]].len : 1;
-			}
-			ImGui::EndTable();
-		}
-		ImGui::End();
-	}
+		drawDisassembler();
 
 	if (debuggerOpen)
 	{
@@ -342,6 +539,8 @@ void App::onGUI()
 		if (ImGui::Button("Start"))
 		{
 			gb.start();
+			rewind.reset();
+			gameDrawnFrames = UINT64_MAX;
 			gbStarted = true;
 		}
 
@@ -352,7 +551,33 @@ void App::onGUI()
 			if (ImGui::Button("STEP"))
 			{
 				nextStep = true;
+				rewindError.clear();
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Continue"))
+			{
+				stepDebug = false;
+				rewindError.clear();
 			}
+
+			ImGui::PushEnabled(rewindEnabled && rewind.keyframeCount() > 0);
+			if (ImGui::Button("Step back"))
+			{
+				rewindError = rewind.stepBack(gb) ? "" : "the recorded history doesn't reach further back";
+				scrollToPc = true;
+				// the replay drew lines again without necessarily finishing a frame
+				gameDrawnFrames = UINT64_MAX;
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Reverse continue"))
+			{
+				rewindError = rewind.reverseContinue(gb) ? "" : "no breakpoint hit in the recorded history";
+				scrollToPc = true;
+				gameDrawnFrames = UINT64_MAX;
+			}
+			ImGui::PopEnabled();
+			if (!rewindError.empty())
+				ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "%s", rewindError.c_str());
 		}
 		
 		ImGui::Separator();
@@ -380,22 +605,893 @@ void App::onGUI()
 		ImGui::Separator();
 
 		ImGui::Text("CPU cycles: %I64d", gb.ticks);
+
+		if (ImGui::CollapsingHeader("Breakpoints", ImGuiTreeNodeFlags_DefaultOpen))
+			drawBreakpoints();
+
+		if (ImGui::CollapsingHeader("Watchpoints", ImGuiTreeNodeFlags_DefaultOpen))
+			drawWatchpoints();
+
+		if (ImGui::CollapsingHeader("Call stack"))
+			drawCallStack();
+
+		if (ImGui::CollapsingHeader("Rewind"))
+			drawRewind();
+
+		if (ImGui::CollapsingHeader("Opcode profile"))
+			drawOpcodeProfile();
+
+		if (ImGui::CollapsingHeader("PC sampling"))
+			drawPcSampling();
 		
 		ImGui::End();
 	}
 	
+	if (gameOpen)
+		drawGame();
+
 	if (spriteViewerOpen)
-	{
-		ImGui::Begin("SpriteViewer", &spriteViewerOpen);
-		ImGui::End();
-	}
+		drawSpriteViewer();
+
+	if (tileViewerOpen)
+		drawTileViewer();
 	
+	if (frameTimingsOpen)
+		drawFrameTimings();
+
+	if (ramSearchOpen)
+		drawRamSearch();
+
+	if (cheatsOpen)
+		drawCheats();
+
 	if (showDemo)
 		ImGui::ShowDemoWindow(&showDemo);
 }
 
+void App::drawOpcodeProfile()
+{
+#ifdef GB_OPCODE_PROFILER
+	OpcodeProfile& profile = gb.opcodeProfile;
+	if (ImGui::Button("Reset"))
+		profile.reset();
+
+	uint64_t const totalCycles = profile.totalCycles();
+	ImGuiTableFlags constexpr flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Sortable | ImGuiTableFlags_ScrollY;
+	if (ImGui::BeginTable("opcode profile table", 5, flags, ImVec2(0.0f, ImGui::GetTextLineHeightWithSpacing() * 16)))
+	{
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::TableSetupColumn("opcode");
+		ImGui::TableSetupColumn("name", ImGuiTableColumnFlags_NoSort);
+		ImGui::TableSetupColumn("executions");
+		ImGui::TableSetupColumn("cycles", ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending);
+		ImGui::TableSetupColumn("share", ImGuiTableColumnFlags_NoSort);
+		ImGui::TableHeadersRow();
+
+		// the counters change every frame so the order is rebuilt every time, 512 entries at most
+		std::vector<uint16_t> order;
+		for (uint16_t i = 0; i < OpcodeProfile::opcodeCount; i++)
+		{
+			if (profile.executions[i] > 0)
+				order.push_back(i);
+		}
+
+		if (ImGuiTableSortSpecs const* sortSpecs = ImGui::TableGetSortSpecs(); sortSpecs && sortSpecs->SpecsCount > 0)
+		{
+			ImGuiTableColumnSortSpecs const spec = sortSpecs->Specs[0];
+			auto const key = [&](uint16_t i) -> uint64_t
+			{
+				switch (spec.ColumnIndex)
+				{
+					case 0: return i;
+					case 2: return profile.executions[i];
+					default: return profile.cycles[i];
+				}
+			};
+			std::sort(order.begin(), order.end(), [&](uint16_t lhs, uint16_t rhs)
+			{
+				return spec.SortDirection == ImGuiSortDirection_Ascending ? key(lhs) < key(rhs) : key(lhs) > key(rhs);
+			});
+		}
+
+		for (uint16_t const i : order)
+		{
+			ImGui::TableNextColumn();
+			ImGui::Text(i >= 256 ? "CB %02X" : "%02X", i & 0xFF);
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(OpcodeProfile::name(i).c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", profile.executions[i]);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", profile.cycles[i]);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.2f%%", totalCycles > 0 ? 100.0 * profile.cycles[i] / totalCycles : 0.0);
+		}
+		ImGui::EndTable();
+	}
+#else
+	ImGui::TextUnformatted("built without GB_OPCODE_PROFILER");
+#endif
+}
+
+void App::drawPcSampling()
+{
+	bool enabled = gb.pcSampler.interval > 0;
+	if (ImGui::Checkbox("Enabled", &enabled))
+		gb.setPcSampling(enabled ? pcSampleInterval : 0);
+	ImGui::SameLine();
+	if (ImGui::InputInt("interval (cycles)", &pcSampleInterval, 16, 256))
+	{
+		pcSampleInterval = std::max(pcSampleInterval, 4);
+		if (enabled)
+			gb.setPcSampling(pcSampleInterval);
+	}
+	if (ImGui::Button("Reset"))
+		gb.pcSampler.reset();
+	ImGui::SameLine();
+	ImGui::Text("%llu samples", gb.pcSampler.total);
+
+	ImGuiTableFlags constexpr flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY;
+	if (gb.pcSampler.total > 0 && ImGui::BeginTable("pc sampling table", 3, flags, ImVec2(0.0f, ImGui::GetTextLineHeightWithSpacing() * 12)))
+	{
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::TableSetupColumn("routine");
+		ImGui::TableSetupColumn("samples");
+		ImGui::TableSetupColumn("share");
+		ImGui::TableHeadersRow();
+
+		for (PcSampler::Routine const& routine : gb.pcSampler.routines(routineEntries))
+		{
+			ImGui::TableNextColumn();
+			char label[128];
+			symbols.format(MMU::bankOfBankedAddress(routine.entry), static_cast<uint16_t>(routine.entry), label, sizeof(label));
+			ImGui::TextUnformatted(label);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", routine.samples);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.2f%%", 100.0 * routine.samples / gb.pcSampler.total);
+		}
+		ImGui::EndTable();
+	}
+}
+
+void App::drawBreakpoints()
+{
+	ImGui::SetNextItemWidth(80.0f);
+	bool add = ImGui::InputTextWithHint("##address", "address", breakpointAddress, sizeof(breakpointAddress), ImGuiInputTextFlags_EnterReturnsTrue);
+	ImGui::SameLine();
+	ImGui::SetNextItemWidth(240.0f);
+	add |= ImGui::InputTextWithHint("##condition", "A == 0x3C && [HL] > 5", breakpointCondition, sizeof(breakpointCondition), ImGuiInputTextFlags_EnterReturnsTrue);
+	ImGui::SameLine();
+	add |= ImGui::Button("Add");
+	if (add)
+	{
+		uint16_t bank = 0, address = 0;
+		if (!parseBreakpointAddress(breakpointAddress, bank, address))
+			breakpointError = "address is hex, 0150, 0x0150 or bank:address";
+		else if (gb.breakpoints.add(bank, address, breakpointCondition, breakpointError))
+			breakpointAddress[0] = '\0';
+	}
+	if (!breakpointError.empty())
+		ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "%s", breakpointError.c_str());
+
+	ImGuiTableFlags constexpr flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY;
+	std::vector<Breakpoints::Breakpoint> const& breakpoints = gb.breakpoints.list();
+	if (!breakpoints.empty() && ImGui::BeginTable("breakpoints table", 5, flags, ImVec2(0.0f, ImGui::GetTextLineHeightWithSpacing() * 8)))
+	{
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::TableSetupColumn("on", ImGuiTableColumnFlags_WidthFixed);
+		ImGui::TableSetupColumn("address");
+		ImGui::TableSetupColumn("condition");
+		ImGui::TableSetupColumn("hits");
+		ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthFixed);
+		ImGui::TableHeadersRow();
+
+		int removed = -1;
+		for (size_t i = 0; i < breakpoints.size(); i++)
+		{
+			Breakpoints::Breakpoint const& breakpoint = breakpoints[i];
+			ImGui::PushID(static_cast<int>(i));
+			ImGui::TableNextColumn();
+			bool enabled = breakpoint.enabled;
+			if (ImGui::Checkbox("##enabled", &enabled))
+				gb.breakpoints.setEnabled(i, enabled);
+			ImGui::TableNextColumn();
+			char label[128];
+			symbols.format(breakpoint.bank, breakpoint.address, label, sizeof(label));
+			ImGui::Text("%02X:%04X %s", breakpoint.bank, breakpoint.address, symbols.empty() ? "" : label);
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(breakpoint.conditionText.c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", breakpoint.hits);
+			ImGui::TableNextColumn();
+			if (ImGui::SmallButton("x"))
+				removed = static_cast<int>(i);
+			ImGui::PopID();
+		}
+		ImGui::EndTable();
+
+		if (removed >= 0)
+			gb.breakpoints.remove(breakpoints[removed].bank, breakpoints[removed].address);
+	}
+}
+
+void App::drawCallStack()
+{
+	char name[128];
+	std::vector<CallStack::Frame> const& frames = gb.callStack.stack();
+	for (size_t i = frames.size(); i-- > 0;)
+	{
+		uint16_t const address = static_cast<uint16_t>(frames[i].entry);
+		symbols.format(MMU::bankOfBankedAddress(frames[i].entry), address, name, sizeof(name));
+		ImGui::Text("%2zu %04X %s", frames.size() - 1 - i, address, symbols.empty() ? "" : name);
+	}
+	if (frames.empty())
+		ImGui::TextDisabled("outside of any call");
+	if (gb.callStack.overflows > 0)
+		ImGui::TextDisabled("%llu calls past the depth limit", gb.callStack.overflows);
+
+	ImGui::Separator();
+	if (ImGui::Button("Reset profile"))
+		gb.callStack.resetProfile(gb.ticks);
+	ImGui::SameLine();
+	if (ImGui::Button("Export folded stacks"))
+	{
+		if (gb.callStack.writeFolded(callProfileExportPath, gb.ticks, !symbols.empty() ? &symbols : nullptr))
+			printf("call profile written to \"%s\"\n", callProfileExportPath);
+	}
+
+	std::vector<CallStack::Node> const tree = gb.callStack.profile(gb.ticks);
+	ImGuiTableFlags constexpr flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_Resizable;
+	if (ImGui::BeginTable("call profile table", 5, flags, ImVec2(0.0f, ImGui::GetTextLineHeightWithSpacing() * 16)))
+	{
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::TableSetupColumn("function", ImGuiTableColumnFlags_WidthStretch);
+		ImGui::TableSetupColumn("calls");
+		ImGui::TableSetupColumn("inclusive");
+		ImGui::TableSetupColumn("exclusive");
+		ImGui::TableSetupColumn("%");
+		ImGui::TableHeadersRow();
+		drawCallNode(tree, CallStack::root, std::max<uint64_t>(tree[CallStack::root].inclusive, 1));
+		ImGui::EndTable();
+	}
+}
+
+void App::drawCallNode(std::vector<CallStack::Node> const& tree, uint32_t node, uint64_t total)
+{
+	// heaviest callees first
+	std::vector<uint32_t> children;
+	for (uint32_t c = tree[node].firstChild; c != CallStack::none; c = tree[c].nextSibling)
+		children.push_back(c);
+	std::sort(children.begin(), children.end(), [&](uint32_t a, uint32_t b) { return tree[a].inclusive > tree[b].inclusive; });
+
+	char name[128];
+	if (node == CallStack::root)
+		snprintf(name, sizeof(name), "[top level]");
+	else if (symbols.empty())
+		snprintf(name, sizeof(name), "%04X", static_cast<uint16_t>(tree[node].entry));
+	else
+		symbols.format(MMU::bankOfBankedAddress(tree[node].entry), static_cast<uint16_t>(tree[node].entry), name, sizeof(name));
+
+	ImGui::TableNextRow();
+	ImGui::TableNextColumn();
+	ImGuiTreeNodeFlags const nodeFlags = (children.empty() ? ImGuiTreeNodeFlags_Leaf : 0) | (node == CallStack::root ? ImGuiTreeNodeFlags_DefaultOpen : 0) | ImGuiTreeNodeFlags_SpanFullWidth;
+	bool const open = ImGui::TreeNodeEx(reinterpret_cast<void*>(static_cast<uintptr_t>(node)), nodeFlags, "%s", name);
+	ImGui::TableNextColumn();
+	ImGui::Text("%llu", tree[node].calls);
+	ImGui::TableNextColumn();
+	ImGui::Text("%llu", tree[node].inclusive);
+	ImGui::TableNextColumn();
+	ImGui::Text("%llu", CallStack::exclusive(tree, node));
+	ImGui::TableNextColumn();
+	ImGui::Text("%.1f", 100.0 * tree[node].inclusive / total);
+	if (open)
+	{
+		for (uint32_t c : children)
+			drawCallNode(tree, c, total);
+		ImGui::TreePop();
+	}
+}
+
+void App::drawRewind()
+{
+	// a gap in the joypad log would make the replay diverge, the history starts over
+	if (ImGui::Checkbox("Record history", &rewindEnabled))
+		rewind.reset();
+	bool changed = ImGui::InputInt("Keyframe interval (frames)", &rewindIntervalFrames);
+	changed |= ImGui::InputInt("Memory budget (MB)", &rewindBudgetMB);
+	if (changed)
+	{
+		rewindIntervalFrames = std::max(rewindIntervalFrames, 1);
+		rewindBudgetMB = std::max(rewindBudgetMB, 1);
+		rewind.configure(static_cast<uint64_t>(rewindIntervalFrames) * Gameboy::cyclesPerFrame, static_cast<size_t>(rewindBudgetMB) << 20);
+	}
+
+	double const seconds = static_cast<double>(gb.ticks - rewind.oldestTick()) / (Gameboy::cyclesPerFrame * 60.0);
+	ImGui::Text("%zu keyframes, %.1f MB, %.1f s of history", rewind.keyframeCount(), rewind.memoryUsed() / (1024.0 * 1024.0), rewind.keyframeCount() > 0 ? seconds : 0.0);
+	ImGui::Text("keyframe every %.1f frames", static_cast<double>(rewind.interval()) / Gameboy::cyclesPerFrame);
+}
+
+void App::drawWatchpoints()
+{
+	ImGui::SetNextItemWidth(120.0f);
+	bool add = ImGui::InputTextWithHint("##range", "C000-C0FF", watchpointRange, sizeof(watchpointRange), ImGuiInputTextFlags_EnterReturnsTrue);
+	ImGui::SameLine();
+	ImGui::Checkbox("r", &watchRead);
+	ImGui::SameLine();
+	ImGui::Checkbox("w", &watchWrite);
+	ImGui::SameLine();
+	ImGui::Checkbox("change", &watchChange);
+	ImGui::SameLine();
+	add |= ImGui::Button("Add##watchpoint");
+	if (add)
+	{
+		uint16_t first = 0, last = 0;
+		uint8_t kinds = 0;
+		uint8_t const selected = (watchRead ? Watchpoints::read : 0) | (watchWrite ? Watchpoints::write : 0) | (watchChange ? Watchpoints::change : 0);
+		if (!parseWatchpoint(watchpointRange, first, last, kinds))
+			watchpointError = "range is hex, C000 or C000-C0FF";
+		else if (selected == 0)
+			watchpointError = "pick read, write or change";
+		else
+		{
+			gb.mmu.watchpoints.add(first, last, selected);
+			watchpointRange[0] = '\0';
+			watchpointError.clear();
+		}
+	}
+	if (!watchpointError.empty())
+		ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "%s", watchpointError.c_str());
+
+	Watchpoints::Hit const& hit = gb.lastWatchHit;
+	if (hit.kind != 0)
+	{
+		char pc[128];
+		symbols.format(gb.mmu.bankOf(hit.pc), hit.pc, pc, sizeof(pc));
+		if (hit.kind == Watchpoints::read)
+			ImGui::Text("last hit: read 0x%04X at pc %s, 0x%02X", hit.address, pc, hit.oldValue);
+		else
+			ImGui::Text("last hit: %s 0x%04X at pc %s, 0x%02X -> 0x%02X", watchKindName(hit.kind), hit.address, pc, hit.oldValue, hit.newValue);
+	}
+
+	ImGuiTableFlags constexpr flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY;
+	std::vector<Watchpoints::Watchpoint> const& watchpoints = gb.mmu.watchpoints.list();
+	if (!watchpoints.empty() && ImGui::BeginTable("watchpoints table", 5, flags, ImVec2(0.0f, ImGui::GetTextLineHeightWithSpacing() * 8)))
+	{
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::TableSetupColumn("on", ImGuiTableColumnFlags_WidthFixed);
+		ImGui::TableSetupColumn("range");
+		ImGui::TableSetupColumn("kinds");
+		ImGui::TableSetupColumn("hits");
+		ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthFixed);
+		ImGui::TableHeadersRow();
+
+		int removed = -1;
+		for (size_t i = 0; i < watchpoints.size(); i++)
+		{
+			Watchpoints::Watchpoint const& watchpoint = watchpoints[i];
+			ImGui::PushID(static_cast<int>(i));
+			ImGui::TableNextColumn();
+			bool enabled = watchpoint.enabled;
+			if (ImGui::Checkbox("##enabled", &enabled))
+				gb.mmu.watchpoints.setEnabled(i, enabled);
+			ImGui::TableNextColumn();
+			if (watchpoint.first == watchpoint.last)
+				ImGui::Text("%04X", watchpoint.first);
+			else
+				ImGui::Text("%04X-%04X", watchpoint.first, watchpoint.last);
+			ImGui::TableNextColumn();
+			ImGui::Text("%s%s%s", watchpoint.kinds & Watchpoints::read ? "r" : "", watchpoint.kinds & Watchpoints::write ? "w" : "", watchpoint.kinds & Watchpoints::change ? "c" : "");
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", watchpoint.hits);
+			ImGui::TableNextColumn();
+			if (ImGui::SmallButton("x"))
+				removed = static_cast<int>(i);
+			ImGui::PopID();
+		}
+		ImGui::EndTable();
+
+		if (removed >= 0)
+			gb.mmu.watchpoints.remove(removed);
+	}
+}
+
+void App::drawRamSearch()
+{
+	ImGui::Begin("RAM search", &ramSearchOpen);
+
+	ImGui::SetNextItemWidth(100.0f);
+	ImGui::Combo("##width", &ramSearchWidth, "8 bit\0" "16 bit\0");
+	ImGui::SameLine();
+	ImGui::SetNextItemWidth(100.0f);
+	ImGui::Combo("##format", &ramSearchFormat, "unsigned\0" "signed\0" "BCD\0");
+	ImGui::SameLine();
+	if (ImGui::Button("New search"))
+	{
+		ramSearch.start(gb.mmu.memMap, static_cast<RamSearch::Width>(ramSearchWidth), static_cast<RamSearch::Format>(ramSearchFormat));
+		ramSearchCount = ramSearch.count();
+	}
+
+	ImGui::PushEnabled(ramSearch.started());
+	ImGui::SetNextItemWidth(120.0f);
+	ImGui::Combo("##compare", &ramSearchCompare, "equal to\0" "not equal to\0" "greater than\0" "less than\0");
+	ImGui::SameLine();
+	ImGui::Checkbox("value", &ramSearchAgainstValue);
+	ImGui::SameLine();
+	if (ramSearchAgainstValue)
+	{
+		ImGui::SetNextItemWidth(100.0f);
+		ImGui::InputInt("##value", &ramSearchValue);
+	}
+	else
+		ImGui::TextUnformatted("previous");
+	ImGui::SameLine();
+	if (ImGui::Button("Filter"))
+	{
+		auto const start = std::chrono::steady_clock::now();
+		RamSearch::Compare const compare = static_cast<RamSearch::Compare>(ramSearchCompare);
+		ramSearchCount = ramSearchAgainstValue ? ramSearch.filter(gb.mmu.memMap, compare, ramSearchValue) : ramSearch.filter(gb.mmu.memMap, compare);
+		ramSearchMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	}
+	ImGui::PopEnabled();
+
+	if (!ramSearch.started())
+	{
+		ImGui::TextUnformatted("searches cart ram, wram and hram, start with a new search");
+		ImGui::End();
+		return;
+	}
+	ImGui::Text("%u candidates, last filter %.1f us", ramSearchCount, ramSearchMicroseconds);
+
+	// a long list is useless anyway, a few more filters bring it down
+	size_t constexpr shownResults = 512;
+	std::vector<uint16_t> const results = ramSearch.results(shownResults);
+	ImGuiTableFlags constexpr flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY;
+	if (!results.empty() && ImGui::BeginTable("ram search table", 4, flags))
+	{
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::TableSetupColumn("address");
+		ImGui::TableSetupColumn("value");
+		ImGui::TableSetupColumn("previous");
+		ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthFixed);
+		ImGui::TableHeadersRow();
+
+		uint16_t const length = ramSearch.width() == RamSearch::Width::word ? 2 : 1;
+		ImGuiListClipper clipper;
+		clipper.Begin(static_cast<int>(results.size()));
+		while (clipper.Step())
+		{
+			for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
+			{
+				uint16_t const address = results[row];
+				ImGui::PushID(row);
+				ImGui::TableNextColumn();
+				ImGui::Text("%04X", address);
+				ImGui::TableNextColumn();
+				ImGui::Text("%d", ramSearch.value(gb.mmu.memMap, address));
+				ImGui::TableNextColumn();
+				ImGui::Text("%d", ramSearch.previousValue(address));
+				ImGui::TableNextColumn();
+				if (ImGui::SmallButton("Show"))
+				{
+					mem_edit.Open = true;
+					mem_edit.GotoAddrAndHighlight(address, address + length);
+				}
+				ImGui::SameLine();
+				if (ImGui::SmallButton("Watch"))
+				{
+					gb.mmu.watchpoints.add(address, static_cast<uint16_t>(address + length - 1), Watchpoints::change);
+					debuggerOpen = true;
+				}
+				ImGui::PopID();
+			}
+		}
+		ImGui::EndTable();
+	}
+
+	ImGui::End();
+}
+
+void App::drawCheats()
+{
+	ImGui::Begin("Cheats", &cheatsOpen);
+
+	ImGui::SetNextItemWidth(120.0f);
+	bool add = ImGui::InputTextWithHint("##code", "01FF16D0", cheatCode, sizeof(cheatCode), ImGuiInputTextFlags_EnterReturnsTrue | ImGuiInputTextFlags_CharsUppercase);
+	ImGui::SameLine();
+	ImGui::SetNextItemWidth(160.0f);
+	add |= ImGui::InputTextWithHint("##name", "name", cheatName, sizeof(cheatName), ImGuiInputTextFlags_EnterReturnsTrue);
+	ImGui::SameLine();
+	add |= ImGui::Button("Add##cheat");
+	if (add)
+	{
+		Cheats::Cheat cheat;
+		if (!parseCheat(cheatCode, cheat))
+			cheatError = "GameShark is ttvvaaaa on ram, Game Genie vva-aaa-ccc on rom";
+		else
+		{
+			cheat.name = cheatName;
+			cheats.add(cheat);
+			applyCheats();
+			cheatCode[0] = '\0';
+			cheatName[0] = '\0';
+			cheatError.clear();
+		}
+	}
+	if (!cheatError.empty())
+		ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "%s", cheatError.c_str());
+
+	ImGuiTableFlags constexpr flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY;
+	std::vector<Cheats::Cheat> const& list = cheats.list();
+	if (!list.empty() && ImGui::BeginTable("cheats table", 5, flags))
+	{
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::TableSetupColumn("on", ImGuiTableColumnFlags_WidthFixed);
+		ImGui::TableSetupColumn("code");
+		ImGui::TableSetupColumn("effect");
+		ImGui::TableSetupColumn("name");
+		ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthFixed);
+		ImGui::TableHeadersRow();
+
+		int removed = -1;
+		for (size_t i = 0; i < list.size(); i++)
+		{
+			Cheats::Cheat const& cheat = list[i];
+			ImGui::PushID(static_cast<int>(i));
+			ImGui::TableNextColumn();
+			bool enabled = cheat.enabled;
+			if (ImGui::Checkbox("##enabled", &enabled))
+			{
+				cheats.setEnabled(i, enabled);
+				applyCheats();
+			}
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(cheat.code.c_str());
+			ImGui::TableNextColumn();
+			if (cheat.kind == Cheats::Kind::gameShark)
+				ImGui::Text("[%04X] = %02X every frame", cheat.address, cheat.value);
+			else if (cheat.compare >= 0)
+				ImGui::Text("rom %04X: %02X -> %02X", cheat.address, cheat.compare, cheat.value);
+			else
+				ImGui::Text("rom %04X -> %02X", cheat.address, cheat.value);
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(cheat.name.c_str());
+			ImGui::TableNextColumn();
+			if (ImGui::SmallButton("x"))
+				removed = static_cast<int>(i);
+			ImGui::PopID();
+		}
+		ImGui::EndTable();
+
+		if (removed >= 0)
+		{
+			cheats.remove(removed);
+			applyCheats();
+		}
+	}
+
+	ImGui::End();
+}
+
+void App::applyCheats()
+{
+	gb.setCheats(cheats.active() ? &cheats : nullptr);
+	if (!romLoaded)
+		return;
+	savedCheats[cheatSettingsKey] = cheats.serialize();
+	saveSettings();
+}
+
+void App::saveSettings()
+{
+	aini::Writer writer;
+	writer.set_string("lastRomPath", lastRomPath);
+	writer.set_int("frameskip", frameskip);
+	writer.set_int("gameIntegerScale", gameIntegerScale ? 1 : 0);
+	writer.set_int("gameFilter", static_cast<aini::Int_t>(gameFilter));
+
+	std::string roms;
+	for (auto const& [section, lines] : savedCheats)
+	{
+		if (lines.empty())
+			continue;
+		roms += (roms.empty() ? "" : ",") + section;
+		writer.set_int("count", static_cast<aini::Int_t>(lines.size()), section.c_str());
+		for (size_t i = 0; i < lines.size(); i++)
+			writer.set_string(("cheat" + std::to_string(i)).c_str(), lines[i], section.c_str());
+	}
+	if (!roms.empty())
+		writer.set_string("cheatRoms", roms);
+
+	std::ofstream settings(fileSettingsPath);
+	settings << writer.write();
+}
+
+void App::uploadGameScreen()
+{
+	GB_TRACE_ZONE("game upload");
+	uint32_t const factor = upscale::factor(gameFilter);
+	uint32_t const width = Ppu::screenWidth * factor;
+	uint32_t const height = Ppu::screenHeight * factor;
+	size_t const size = static_cast<size_t>(width) * height * sizeof(uint32_t);
+	if (gameTexture == 0)
+	{
+		glGenTextures(1, &gameTexture);
+		glGenBuffers(1, &gamePixelBuffer);
+	}
+	if (width != gameTextureWidth || height != gameTextureHeight)
+	{
+		// an upscaled picture is usually shown smaller than it is, nearest would drop whole rows of it
+		glBindTexture(GL_TEXTURE_2D, gameTexture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, factor > 1 ? GL_LINEAR : GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		gameTextureWidth = width;
+		gameTextureHeight = height;
+	}
+
+	uint32_t const* pixels = gb.ppu.framebuffer.data();
+	if (gameFilter != upscale::Filter::none)
+	{
+		// into memory of our own, the filters read back what they write and the mapped buffer is slow to read
+		GB_TRACE_ZONE("game upscale");
+		gameUpscaled.resize(size / sizeof(uint32_t));
+		upscaler.run(gameFilter, pixels, Ppu::screenWidth, Ppu::screenHeight, gameUpscaled.data());
+		pixels = gameUpscaled.data();
+	}
+
+	// a new store for every frame, the driver keeps the old one until the copy that reads it is done
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, gamePixelBuffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	void* const mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (mapped != nullptr)
+	{
+		memcpy(mapped, pixels, size);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindTexture(GL_TEXTURE_2D, gameTexture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	gameDrawnFrames = gb.ppu.drawnFrames;
+}
+
+void App::drawGame()
+{
+	ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0.0f, 0.0f));
+	bool const visible = ImGui::Begin("Game", &gameOpen, ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse);
+	ImGui::PopStyleVar();
+	if (!visible)
+	{
+		ImGui::End();
+		return;
+	}
+
+	if (gameTexture == 0 || gb.ppu.drawnFrames != gameDrawnFrames)
+		uploadGameScreen();
+
+	// the biggest size with the screen's aspect that fits, black bars on the sides left over
+	ImVec2 const origin = ImGui::GetCursorScreenPos();
+	ImVec2 const available = ImGui::GetContentRegionAvail();
+	float scale = std::min(available.x / Ppu::screenWidth, available.y / Ppu::screenHeight);
+	if (gameIntegerScale && scale >= 1.0f)
+		scale = std::floor(scale);
+	ImVec2 const size(Ppu::screenWidth * scale, Ppu::screenHeight * scale);
+	ImVec2 const offset(std::floor((available.x - size.x) * 0.5f), std::floor((available.y - size.y) * 0.5f));
+
+	ImGui::GetWindowDrawList()->AddRectFilled(origin, ImVec2(origin.x + available.x, origin.y + available.y), IM_COL32_BLACK);
+	ImGui::SetCursorScreenPos(ImVec2(origin.x + offset.x, origin.y + offset.y));
+	ImGui::Image((ImTextureID)(intptr_t)gameTexture, size);
+
+	if (ImGui::BeginPopupContextWindow())
+	{
+		if (ImGui::MenuItem("Integer scaling", nullptr, gameIntegerScale))
+		{
+			gameIntegerScale = !gameIntegerScale;
+			saveSettings();
+		}
+		ImGui::EndPopup();
+	}
+	ImGui::End();
+}
+
+void App::drawTileViewer()
+{
+	ImGui::Begin("Tile viewer", &tileViewerOpen);
+	ImGui::Combo("Palette", &tileViewerPalette, "BGP\0OBP0\0OBP1\0");
+	{
+		GB_TRACE_ZONE("tile sheet");
+		uint16_t const palettes[] = { Ppu::bgpAddress, Ppu::obp0Address, Ppu::obp1Address };
+		viewerPixels.resize(Ppu::tileSheetWidth * Ppu::tileSheetHeight);
+		Ppu::drawTileSheet(gb.mmu, gb.mmu.memMap[palettes[tileViewerPalette]], viewerPixels.data());
+		uploadTexture(tileTexture, Ppu::tileSheetWidth, Ppu::tileSheetHeight, viewerPixels.data());
+	}
+	ImVec2 const origin = ImGui::GetCursorScreenPos();
+	float constexpr zoom = 3.0f;
+	ImGui::Image((ImTextureID)(intptr_t)tileTexture, ImVec2(Ppu::tileSheetWidth * zoom, Ppu::tileSheetHeight * zoom));
+	if (ImGui::IsItemHovered())
+	{
+		uint32_t const x = static_cast<uint32_t>((ImGui::GetMousePos().x - origin.x) / zoom) / 8;
+		uint32_t const y = static_cast<uint32_t>((ImGui::GetMousePos().y - origin.y) / zoom) / 8;
+		uint32_t const tile = std::min(y * (Ppu::tileSheetWidth / 8) + x, 383u);
+		ImGui::SetTooltip("tile %u at %04X", tile, 0x8000 + tile * 16);
+	}
+	ImGui::End();
+}
+
+void App::drawSpriteViewer()
+{
+	ImGui::Begin("SpriteViewer", &spriteViewerOpen);
+	{
+		GB_TRACE_ZONE("sprite sheet");
+		viewerPixels.resize(Ppu::spriteSheetWidth * Ppu::spriteSheetHeight);
+		Ppu::drawSpriteSheet(gb.mmu, viewerPixels.data());
+		uploadTexture(spriteTexture, Ppu::spriteSheetWidth, Ppu::spriteSheetHeight, viewerPixels.data());
+	}
+	ImVec2 const origin = ImGui::GetCursorScreenPos();
+	float constexpr zoom = 4.0f;
+	ImGui::Image((ImTextureID)(intptr_t)spriteTexture, ImVec2(Ppu::spriteSheetWidth * zoom, Ppu::spriteSheetHeight * zoom));
+	if (ImGui::IsItemHovered())
+	{
+		uint32_t const x = static_cast<uint32_t>((ImGui::GetMousePos().x - origin.x) / zoom) / 8;
+		uint32_t const y = static_cast<uint32_t>((ImGui::GetMousePos().y - origin.y) / zoom) / 16;
+		uint32_t const sprite = std::min(y * 8 + x, Ppu::spriteCount - 1);
+		uint8_t const* const entry = &gb.mmu.memMap[MMU::oamAddress + sprite * 4];
+		ImGui::SetTooltip("sprite %u\nx %d y %d\ntile %02X flags %02X", sprite, entry[1] - 8, entry[0] - 16, entry[2], entry[3]);
+	}
+	ImGui::End();
+}
+
+void App::drawDisassembler()
+{
+	GB_TRACE_ZONE("Disassembler");
+	ImGui::Begin("Disassembler", &disassemblerOpen);
+
+	// only the code written to ram since the last frame is decoded again
+	disassembly.refresh(gb.mmu.memMap);
+
+	if (ImGui::Button("Go to PC"))
+		scrollToPc = true;
+	ImGui::SameLine();
+	ImGui::Checkbox("Follow PC", &followPc);
+	if (followPc && gb.registers.pc != lastDrawnPc)
+		scrollToPc = true;
+	lastDrawnPc = gb.registers.pc;
+
+	ImGuiTableFlags constexpr flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY;
+	bool const showHeat = gb.pcSampler.total > 0;
+	bool const showSymbols = !symbols.empty();
+	if (ImGui::BeginTable("disassembler table", 3 + showHeat + showSymbols, flags))
+	{
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::PushStyleColor(ImGuiCol_Text, IM_COL32(255, 0, 0, 255));
+		if (showSymbols)
+			ImGui::TableSetupColumn("symbol");
+		ImGui::TableSetupColumn("address");
+		ImGui::TableSetupColumn("byte");
+		ImGui::TableSetupColumn("code");
+		if (showHeat)
+			ImGui::TableSetupColumn("heat");
+		ImGui::PopStyleColor();
+		ImGui::TableHeadersRow();
+
+		uint32_t const pcLine = disassembly.lineOf(gb.registers.pc);
+		ImGuiListClipper clipper;
+		clipper.Begin(static_cast<int>(disassembly.lineCount()));
+		while (clipper.Step())
+		{
+			// the first step measures a row, the pc line is centered once the height is known
+			if (scrollToPc && clipper.ItemsHeight > 0.0f)
+			{
+				ImGui::SetScrollY(clipper.ItemsHeight * pcLine - ImGui::GetWindowHeight() * 0.5f);
+				scrollToPc = false;
+			}
+
+			for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
+			{
+				Disassembly::Line const& line = disassembly.line(row);
+				bool const isPc = static_cast<uint32_t>(row) == pcLine;
+				ImGui::TableNextRow();
+				if (isPc)
+					ImGui::PushStyleColor(ImGuiCol_Text, IM_COL32(255, 0, 0, 255));
+				if (showSymbols)
+				{
+					// labels stand out, label+offset of the lines below them is dimmed
+					ImGui::TableNextColumn();
+					SymbolTable::Match const match = symbols.find(gb.mmu.bankOf(line.address), line.address);
+					if (match.name.empty())
+						;
+					else if (match.offset != 0)
+						ImGui::TextDisabled("%.*s+0x%X", static_cast<int>(match.name.size()), match.name.data(), match.offset);
+					else
+						ImGui::TextUnformatted(match.name.data(), match.name.data() + match.name.size());
+				}
+				ImGui::TableNextColumn();
+				// clicking an address toggles its breakpoint
+				uint16_t const bank = gb.mmu.bankOf(line.address);
+				bool const hasBreakpoint = gb.breakpoints.has(bank, line.address);
+				if (hasBreakpoint)
+					ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, IM_COL32(160, 30, 30, 200));
+				char address[8];
+				snprintf(address, sizeof(address), "0x%04X", line.address);
+				if (ImGui::Selectable(address, false))
+					gb.breakpoints.toggle(bank, line.address);
+				ImGui::TableNextColumn();
+				if (gb.mmu.codeDataLog != nullptr)
+				{
+					// green ran, blue was read, purple was copied to oam, any of the line's bytes counts
+					uint8_t logged = 0;
+					for (uint32_t address = line.address; address < line.address + line.length; address++)
+						logged |= codeDataLog.at(static_cast<uint16_t>(address));
+					if (logged & CodeDataLog::codeFlag)
+						ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, IM_COL32(30, 120, 40, 160));
+					else if (logged & CodeDataLog::dataFlag)
+						ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, IM_COL32(30, 60, 150, 160));
+					else if (logged & CodeDataLog::dmaFlag)
+						ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, IM_COL32(110, 40, 130, 160));
+				}
+				ImGui::Text("0x%02X", gb.mmu.memMap[line.address]);
+				ImGui::TableNextColumn();
+				std::string_view const code = disassembly.text(line);
+				bool const isData = disassembly.isData(line);
+				if (isData)
+					ImGui::PushStyleColor(ImGuiCol_Text, ImGui::GetStyleColorVec4(ImGuiCol_TextDisabled));
+				ImGui::TextUnformatted(code.data(), code.data() + code.size());
+				if (isData)
+					ImGui::PopStyleColor();
+				if (showHeat)
+				{
+					ImGui::TableNextColumn();
+					float const share = gb.pcSampler.share(gb.mmu.bankedAddress(line.address));
+					if (share > 0.0f)
+					{
+						// saturates at 10% of the samples, a hot loop rarely spans more than a few rows
+						float const heat = std::min(share * 10.0f, 1.0f);
+						ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, ImGui::GetColorU32(ImVec4(heat, 0.2f * (1.0f - heat), 0.0f, 0.35f + 0.5f * heat)));
+						ImGui::Text("%.2f%%", share * 100.0f);
+					}
+				}
+				if (isPc)
+					ImGui::PopStyleColor();
+			}
+		}
+		ImGui::EndTable();
+	}
+	ImGui::End();
+}
+
+void App::drawFrameTimings()
+{
+	ImGui::SetNextWindowBgAlpha(0.6f);
+	ImGui::Begin("Frame timings", &frameTimingsOpen, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoFocusOnAppearing);
+	ImGui::Text("%.2f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+
+#ifdef GB_TRACING
+	std::vector<tracing::ZoneStat> const stats = tracing::frameStats();
+	double const frameMs = !stats.empty() ? stats.front().milliseconds : 0.0;
+	for (tracing::ZoneStat const& stat : stats)
+	{
+		char overlay[64];
+		snprintf(overlay, sizeof(overlay), "%s %.3f ms", stat.name, stat.milliseconds);
+		ImGui::ProgressBar(frameMs > 0.0 ? static_cast<float>(stat.milliseconds / frameMs) : 0.0f, ImVec2(320.0f, 0.0f), overlay);
+		if (stat.count > 1)
+		{
+			ImGui::SameLine();
+			ImGui::Text("x%u", stat.count);
+		}
+	}
+#else
+	ImGui::TextUnformatted("built without GB_TRACING, no zones");
+#endif
+
+	ImGui::End();
+}
+
 App::~App()
 {
+	glDeleteBuffers(1, &gamePixelBuffer);
+	glDeleteTextures(1, &gameTexture);
+	glDeleteTextures(1, &tileTexture);
+	glDeleteTextures(1, &spriteTexture);
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplSDL2_Shutdown();
     ImGui::DestroyContext();
@@ -416,6 +1512,28 @@ void App::loadRom(std::filesystem::path const& romPath)
 	file.seekg(0, std::ios::beg);
 	file.read(reinterpret_cast<char*>(gb.mmu.rom()), size);
 	romLoaded = true;
+	rewind.reset();
+	codeDataLog.clear();
+	memoryHeatTicks = UINT64_MAX;
+	gameDrawnFrames = UINT64_MAX;
+	cheatSettingsKey = cheatSettingsKeyFor(gb.mmu);
+	cheats.deserialize(savedCheats[cheatSettingsKey]);
+	gb.setCheats(cheats.active() ? &cheats : nullptr);
+	routineEntries = findRoutineEntries(gb.mmu);
+	disassembly.setCodeMap(nullptr);
+	disassembly.build(gb.mmu.memMap);
+	codeAnalysis = std::async(std::launch::async, analyzeCode, std::vector<uint8_t>(gb.mmu.rom(), gb.mmu.rom() + MMU::romSize));
+
+	symbols = {};
+	if (std::filesystem::path const symbolPath = symbolPathFor(romPath); std::filesystem::exists(symbolPath))
+	{
+		symbolLoad = std::async(std::launch::async, [symbolPath]()
+		{
+			SymbolTable table;
+			table.load(symbolPath);
+			return table;
+		});
+	}
 	
 	char buffer[30];
 	snprintf(buffer, sizeof(buffer), "gb-emulator - %s", gb.mmu.romName());
@@ -1,17 +1,31 @@
 #pragma once
 
 #include <filesystem>
+#include <future>
+#include <map>
+#include <vector>
 #include <SDL.h>
 #include <imgui/imgui.h>
 #include <imfilebrowser.h>
 #include <imgui_memory_editor.h>
 #include "gameboy.hpp"
+#include "disassembly.hpp"
+#include "codemap.hpp"
+#include "symbols.hpp"
+#include "rewind.hpp"
+#include "changeheat.hpp"
+#include "ramsearch.hpp"
+#include "upscale.hpp"
 
 class App
 {
 	public:
 
 	static auto constexpr fileSettingsPath = "settings.ini";
+	static auto constexpr traceExportPath = "trace.json";
+	static auto constexpr disassemblyExportPath = "disassembly.asm";
+	static auto constexpr callProfileExportPath = "callstack.folded";
+	static auto constexpr cdlExportPath = "coverage.cdl";
 	App();
 	void init();
 	void run();
@@ -23,17 +37,111 @@ class App
 	protected:
 
 	void loadRom(std::filesystem::path const& romPath);
+	void saveSettings();
+	// after the cheat list changed, hands it to the Gameboy and saves it
+	void applyCheats();
+	void drawOpcodeProfile();
+	void drawPcSampling();
+	void drawFrameTimings();
+	void drawDisassembler();
+	void drawBreakpoints();
+	void drawWatchpoints();
+	void drawRamSearch();
+	void drawCheats();
+	void drawGame();
+	// streams the framebuffer to gameTexture when the PPU drew a new one
+	void uploadGameScreen();
+	void drawTileViewer();
+	void drawSpriteViewer();
+	void drawRewind();
+	void drawCallStack();
+	void drawCallNode(std::vector<CallStack::Node> const& tree, uint32_t node, uint64_t total);
 	
 	Gameboy gb;
 	bool gbStarted = false;
 	ImGui::FileBrowser openDialog;
 	ImGui::FileBrowser saveDialog;
 	MemoryEditor mem_edit;
+	// bytes the last steps or frames changed, drawn as fading background in the memory editor
+	ChangeHeat memoryHeat;
+	bool highlightChanges = true;
+	// ticks of the last diff, UINT64_MAX when the snapshot is stale
+	uint64_t memoryHeatTicks = UINT64_MAX;
 	bool disassemblerOpen = false;
+	Disassembly disassembly;
+	CodeMap codeMap;
+	// runs on a worker thread from loadRom, the listing shows everything as code until it's done
+	std::future<CodeMap> codeAnalysis;
+	SymbolTable symbols;
+	// the .sym next to the rom, parsed on a worker thread
+	std::future<SymbolTable> symbolLoad;
+	bool followPc = true;
+	bool scrollToPc = false;
+	uint16_t lastDrawnPc = 0;
+	char breakpointAddress[16] = "";
+	char breakpointCondition[128] = "";
+	std::string breakpointError;
+	char watchpointRange[16] = "";
+	bool watchRead = false;
+	bool watchWrite = true;
+	bool watchChange = false;
+	std::string watchpointError;
+	RamSearch ramSearch;
+	bool ramSearchOpen = false;
+	int ramSearchWidth = 0;
+	int ramSearchFormat = 0;
+	int ramSearchCompare = 0;
+	bool ramSearchAgainstValue = false;
+	int ramSearchValue = 0;
+	uint32_t ramSearchCount = 0;
+	double ramSearchMicroseconds = 0.0;
+	Cheats cheats;
+	bool cheatsOpen = false;
+	char cheatCode[16] = "";
+	char cheatName[64] = "";
+	std::string cheatError;
+	// cheat lines of every rom in the settings, by cheatSettingsKey
+	std::map<std::string, std::vector<std::string>> savedCheats;
+	std::string cheatSettingsKey;
+	std::string lastRomPath;
+	Rewind rewind;
+	// why the last step back or reverse continue didn't move, shown under the buttons
+	std::string rewindError;
+	CodeDataLog codeDataLog{ MMU::romSize };
+	bool rewindEnabled = true;
+	int rewindIntervalFrames = 1;
+	int rewindBudgetMB = static_cast<int>(Rewind::defaultBudget >> 20);
+	// frames left undrawn after each drawn one, the emulation still runs them all
+	int frameskip = 0;
+	bool gameOpen = true;
+	// whole multiples of 160x144 only, the rest is letterboxed either way
+	bool gameIntegerScale = true;
+	// pixel art upscaling on the cpu before the upload, none sends the framebuffer as it is
+	upscale::Filter gameFilter = upscale::Filter::none;
+	Upscaler upscaler;
+	std::vector<uint32_t> gameUpscaled;
+	unsigned int gameTexture = 0;
+	// what gameTexture was made for, it's made again when the filter scales differently
+	uint32_t gameTextureWidth = 0;
+	uint32_t gameTextureHeight = 0;
+	// orphaned every upload so glTexSubImage2D never waits on the previous frame
+	unsigned int gamePixelBuffer = 0;
+	// Ppu::drawnFrames of the picture in gameTexture
+	uint64_t gameDrawnFrames = UINT64_MAX;
 	bool spriteViewerOpen = false;
+	bool tileViewerOpen = false;
+	// 0 BGP, 1 OBP0, 2 OBP1
+	int tileViewerPalette = 0;
+	// GL texture names, 0 until the viewer is first drawn
+	unsigned int tileTexture = 0;
+	unsigned int spriteTexture = 0;
+	std::vector<uint32_t> viewerPixels;
 	bool debuggerOpen = false;
+	bool frameTimingsOpen = false;
 	bool stepDebug = false;
 	bool nextStep = false;
+	int pcSampleInterval = 64;
+	std::vector<uint32_t> routineEntries;
 	
 	void startFrame();
 	void endFrame();
@@ -0,0 +1,421 @@
+#include "breakpoints.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+
+#include "memory.hpp"
+
+static bool parseNumber(std::string_view text, size_t& pos, uint32_t& value)
+{
+	int base = 10;
+	if (text.substr(pos, 2) == "0x" || text.substr(pos, 2) == "0X")
+	{
+		base = 16;
+		pos += 2;
+	}
+	else if (pos < text.size() && text[pos] == '$')
+	{
+		base = 16;
+		pos++;
+	}
+
+	size_t const start = pos;
+	value = 0;
+	while (pos < text.size() && isxdigit(static_cast<unsigned char>(text[pos])))
+	{
+		int const digit = isdigit(static_cast<unsigned char>(text[pos])) ? text[pos] - '0' : tolower(text[pos]) - 'a' + 10;
+		if (digit >= base)
+			break;
+		value = value * base + digit;
+		pos++;
+	}
+	return pos > start;
+}
+
+class ConditionParser
+{
+	public:
+
+	ConditionParser(std::string_view text, Condition& condition) : text(text), code(condition.code) {}
+
+	bool parse(std::string& error)
+	{
+		parseOr();
+		skipSpaces();
+		if (failure.empty() && pos < text.size())
+			fail("unexpected character");
+		if (failure.empty() && maxDepth > Condition::maxStack)
+			fail("expression too deep");
+		error = failure;
+		return failure.empty();
+	}
+
+	private:
+
+	using Op = Condition::Op;
+
+	void fail(char const* message)
+	{
+		if (failure.empty())
+			failure = std::string(message) + " at column " + std::to_string(pos + 1);
+	}
+
+	void skipSpaces()
+	{
+		while (pos < text.size() && isspace(static_cast<unsigned char>(text[pos])))
+			pos++;
+	}
+
+	bool accept(std::string_view token)
+	{
+		skipSpaces();
+		if (text.substr(pos, token.size()) != token)
+			return false;
+		pos += token.size();
+		return true;
+	}
+
+	void emit(Op op, uint16_t value = 0)
+	{
+		code.push_back({ op, value });
+		// operands push one value, binary operators pop two and push one
+		if (op == Op::Push || op == Op::Register)
+			depth++;
+		else if (op != Op::Load && op != Op::Not)
+			depth--;
+		maxDepth = std::max(maxDepth, depth);
+	}
+
+	void parseOr()
+	{
+		parseAnd();
+		while (accept("||"))
+		{
+			parseAnd();
+			emit(Op::Or);
+		}
+	}
+
+	void parseAnd()
+	{
+		parseComparison();
+		while (accept("&&"))
+		{
+			parseComparison();
+			emit(Op::And);
+		}
+	}
+
+	void parseComparison()
+	{
+		parseSum();
+		static std::pair<std::string_view, Op> constexpr comparisons[] = {
+			{ "==", Op::Equal }, { "!=", Op::NotEqual }, { "<=", Op::LessEqual },
+			{ ">=", Op::GreaterEqual }, { "<", Op::Less }, { ">", Op::Greater },
+		};
+		for (auto const& [token, op] : comparisons)
+		{
+			if (accept(token))
+			{
+				parseSum();
+				emit(op);
+				return;
+			}
+		}
+	}
+
+	void parseSum()
+	{
+		parseUnary();
+		for (;;)
+		{
+			skipSpaces();
+			// a single & is a mask, && belongs to parseAnd
+			if (text.substr(pos, 2) == "&&")
+				return;
+			if (accept("+"))
+			{
+				parseUnary();
+				emit(Op::Add);
+			}
+			else if (accept("-"))
+			{
+				parseUnary();
+				emit(Op::Sub);
+			}
+			else if (accept("&"))
+			{
+				parseUnary();
+				emit(Op::BitAnd);
+			}
+			else
+				return;
+		}
+	}
+
+	void parseUnary()
+	{
+		if (accept("!"))
+		{
+			parseUnary();
+			emit(Op::Not);
+			return;
+		}
+		parsePrimary();
+	}
+
+	void parsePrimary()
+	{
+		skipSpaces();
+		if (pos >= text.size())
+			return fail("expected a value");
+
+		if (accept("("))
+		{
+			parseOr();
+			if (!accept(")"))
+				fail("expected )");
+			return;
+		}
+		if (accept("["))
+		{
+			parseOr();
+			if (!accept("]"))
+				fail("expected ]");
+			emit(Op::Load);
+			return;
+		}
+
+		// register names first, "b" would otherwise never be read as a register
+		static std::string_view constexpr registerNames[] = { "af", "bc", "de", "hl", "sp", "pc", "a", "f", "b", "c", "d", "e", "h", "l" };
+		for (uint16_t i = 0; i < std::size(registerNames); i++)
+		{
+			std::string_view const name = registerNames[i];
+			if (pos + name.size() > text.size())
+				continue;
+			bool matches = true;
+			for (size_t c = 0; c < name.size(); c++)
+				matches &= tolower(static_cast<unsigned char>(text[pos + c])) == name[c];
+			size_t const end = pos + name.size();
+			if (matches && (end == text.size() || !isalnum(static_cast<unsigned char>(text[end]))))
+			{
+				pos = end;
+				emit(Op::Register, i);
+				return;
+			}
+		}
+
+		uint32_t value = 0;
+		if (!parseNumber(text, pos, value) || value > 0xFFFF)
+			return fail("expected a register, a number or [address]");
+		emit(Op::Push, static_cast<uint16_t>(value));
+	}
+
+	std::string_view text;
+	std::vector<Condition::Instr>& code;
+	size_t pos = 0;
+	int depth = 0;
+	int maxDepth = 0;
+	std::string failure;
+};
+
+bool Condition::compile(std::string_view text, std::string& error)
+{
+	code.clear();
+	error.clear();
+	size_t const first = text.find_first_not_of(" \t");
+	if (first == std::string_view::npos)
+		return true;
+
+	if (!ConditionParser(text, *this).parse(error))
+	{
+		code.clear();
+		return false;
+	}
+	return true;
+}
+
+// same order as the names in parsePrimary
+static uint16_t registerValue(Registers const& r, uint16_t index)
+{
+	switch (index)
+	{
+		case 0: return r.a << 8 | r.f;
+		case 1: return r.b << 8 | r.c;
+		case 2: return r.d << 8 | r.e;
+		case 3: return r.h << 8 | r.l;
+		case 4: return r.sp;
+		case 5: return r.pc;
+		case 6: return r.a;
+		case 7: return r.f;
+		case 8: return r.b;
+		case 9: return r.c;
+		case 10: return r.d;
+		case 11: return r.e;
+		case 12: return r.h;
+		default: return r.l;
+	}
+}
+
+bool Condition::evaluate(Registers const& registers, MMU const& mmu) const
+{
+	if (code.empty())
+		return true;
+
+	int32_t stack[maxStack];
+	int top = -1;
+	for (Instr const& instr : code)
+	{
+		switch (instr.op)
+		{
+			case Op::Push:
+				stack[++top] = instr.value;
+				break;
+			case Op::Register:
+				stack[++top] = registerValue(registers, instr.value);
+				break;
+			case Op::Load: stack[top] = mmu.peekByte(static_cast<uint16_t>(stack[top])); break;
+			case Op::Not: stack[top] = !stack[top]; break;
+			case Op::Add: top--; stack[top] = stack[top] + stack[top + 1]; break;
+			case Op::Sub: top--; stack[top] = stack[top] - stack[top + 1]; break;
+			case Op::BitAnd: top--; stack[top] = stack[top] & stack[top + 1]; break;
+			case Op::Equal: top--; stack[top] = stack[top] == stack[top + 1]; break;
+			case Op::NotEqual: top--; stack[top] = stack[top] != stack[top + 1]; break;
+			case Op::Less: top--; stack[top] = stack[top] < stack[top + 1]; break;
+			case Op::LessEqual: top--; stack[top] = stack[top] <= stack[top + 1]; break;
+			case Op::Greater: top--; stack[top] = stack[top] > stack[top + 1]; break;
+			case Op::GreaterEqual: top--; stack[top] = stack[top] >= stack[top + 1]; break;
+			case Op::And: top--; stack[top] = stack[top] && stack[top + 1]; break;
+			case Op::Or: top--; stack[top] = stack[top] || stack[top + 1]; break;
+		}
+	}
+	return stack[top] != 0;
+}
+
+static bool lessThan(Breakpoints::Breakpoint const& breakpoint, uint32_t key)
+{
+	return (static_cast<uint32_t>(breakpoint.bank) << 16 | breakpoint.address) < key;
+}
+
+Breakpoints::Breakpoint* Breakpoints::find(uint16_t bank, uint16_t address)
+{
+	uint32_t const key = static_cast<uint32_t>(bank) << 16 | address;
+	auto const it = std::lower_bound(breakpoints.begin(), breakpoints.end(), key, lessThan);
+	return it != breakpoints.end() && it->bank == bank && it->address == address ? &*it : nullptr;
+}
+
+void Breakpoints::setBit(Breakpoint const& breakpoint, bool armed)
+{
+	uint32_t const bit = (breakpoint.bank % bankCount) << 16 | breakpoint.address;
+	if (armed)
+		bits[bit >> 6] |= uint64_t(1) << (bit & 63);
+	else
+		bits[bit >> 6] &= ~(uint64_t(1) << (bit & 63));
+}
+
+bool Breakpoints::add(uint16_t bank, uint16_t address, std::string_view condition, std::string& error)
+{
+	Condition compiled;
+	if (!compiled.compile(condition, error))
+		return false;
+
+	bank %= bankCount;
+	Breakpoint* breakpoint = find(bank, address);
+	if (breakpoint == nullptr)
+	{
+		uint32_t const key = static_cast<uint32_t>(bank) << 16 | address;
+		auto const it = std::lower_bound(breakpoints.begin(), breakpoints.end(), key, lessThan);
+		breakpoint = &*breakpoints.insert(it, Breakpoint{});
+		breakpoint->bank = bank;
+		breakpoint->address = address;
+		setBit(*breakpoint, true);
+		armedCount++;
+	}
+	breakpoint->conditionText = condition;
+	breakpoint->condition = std::move(compiled);
+	return true;
+}
+
+void Breakpoints::remove(uint16_t bank, uint16_t address)
+{
+	bank %= bankCount;
+	if (Breakpoint* breakpoint = find(bank, address))
+	{
+		if (breakpoint->enabled)
+		{
+			setBit(*breakpoint, false);
+			armedCount--;
+		}
+		breakpoints.erase(breakpoints.begin() + (breakpoint - breakpoints.data()));
+	}
+}
+
+void Breakpoints::toggle(uint16_t bank, uint16_t address)
+{
+	if (find(bank % bankCount, address) != nullptr)
+	{
+		remove(bank, address);
+		return;
+	}
+	std::string error;
+	add(bank, address, {}, error);
+}
+
+void Breakpoints::setEnabled(size_t index, bool enabled)
+{
+	Breakpoint& breakpoint = breakpoints[index];
+	if (breakpoint.enabled == enabled)
+		return;
+	breakpoint.enabled = enabled;
+	setBit(breakpoint, enabled);
+	armedCount += enabled ? 1 : -1;
+}
+
+void Breakpoints::clear()
+{
+	breakpoints.clear();
+	std::fill(bits.begin(), bits.end(), 0);
+	armedCount = 0;
+}
+
+bool Breakpoints::checkCondition(uint16_t bank, uint16_t address, Registers const& registers, MMU const& mmu)
+{
+	Breakpoint* breakpoint = find(bank % bankCount, address);
+	if (breakpoint == nullptr || !breakpoint->condition.evaluate(registers, mmu))
+		return false;
+	if (countHits)
+		breakpoint->hits++;
+	return true;
+}
+
+bool parseBreakpointAddress(std::string_view text, uint16_t& bank, uint16_t& address)
+{
+	// addresses are hex even without a prefix, like everywhere else in the debugger
+	auto const parseHex = [&](size_t& pos, uint32_t& value) -> bool
+	{
+		if (text.substr(pos, 2) == "0x" || text.substr(pos, 2) == "0X")
+			pos += 2;
+		else if (pos < text.size() && text[pos] == '$')
+			pos++;
+		size_t const start = pos;
+		value = 0;
+		for (; pos < text.size() && isxdigit(static_cast<unsigned char>(text[pos])) && value <= 0xFFFF; pos++)
+			value = value << 4 | (isdigit(static_cast<unsigned char>(text[pos])) ? text[pos] - '0' : tolower(text[pos]) - 'a' + 10);
+		return pos > start && value <= 0xFFFF;
+	};
+
+	size_t pos = text.find_first_not_of(" \t");
+	uint32_t value = 0;
+	if (pos == std::string_view::npos || !parseHex(pos, value))
+		return false;
+	bank = 0;
+	if (pos < text.size() && text[pos] == ':')
+	{
+		bank = static_cast<uint16_t>(value);
+		if (!parseHex(++pos, value))
+			return false;
+	}
+	address = static_cast<uint16_t>(value);
+	return text.find_first_not_of(" \t", pos) == std::string_view::npos;
+}
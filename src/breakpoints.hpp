@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cpu.hpp"
+
+struct MMU;
+
+// Breakpoint condition like "A == 0x3C && [HL] > 5" compiled once to a small stack bytecode.
+// Operands are numbers (0x3C, $3C, 60), registers (a..l, af, bc, de, hl, sp, pc) and [address] byte reads,
+// which see what the cpu would read without setting off watchpoints.
+class Condition
+{
+	public:
+
+	// returns false and fills error when the text doesn't parse, an empty text always passes
+	bool compile(std::string_view text, std::string& error);
+	bool evaluate(Registers const& registers, MMU const& mmu) const;
+
+	bool empty() const { return code.empty(); }
+
+	private:
+
+	enum class Op : uint8_t
+	{
+		Push, Register, Load,
+		Not, Add, Sub, BitAnd,
+		Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual,
+		And, Or,
+	};
+
+	struct Instr
+	{
+		Op op;
+		uint16_t value; // constant of Push, register index of Register
+	};
+
+	static int constexpr maxStack = 16;
+
+	friend class ConditionParser;
+	std::vector<Instr> code;
+};
+
+// Execution breakpoints as one bit per address and rom bank, the run loop only looks at them when some are armed.
+class Breakpoints
+{
+	public:
+
+	// no mbc yet, bank 0 covers everything but the 0x4000 window
+	static uint32_t constexpr bankCount = 2;
+
+	struct Breakpoint
+	{
+		uint16_t bank = 0;
+		uint16_t address = 0;
+		bool enabled = true;
+		std::string conditionText;
+		Condition condition;
+		uint64_t hits = 0;
+	};
+
+	// replaces the condition when the breakpoint exists, returns false when it doesn't compile
+	bool add(uint16_t bank, uint16_t address, std::string_view condition, std::string& error);
+	void remove(uint16_t bank, uint16_t address);
+	void toggle(uint16_t bank, uint16_t address);
+	void setEnabled(size_t index, bool enabled);
+	void clear();
+
+	bool armed() const { return armedCount > 0; }
+
+	bool has(uint16_t bank, uint16_t address) const
+	{
+		uint32_t const bit = (bank % bankCount) << 16 | address;
+		return bits[bit >> 6] >> (bit & 63) & 1;
+	}
+
+	// the bitmap test is all the run loop pays until an armed address is reached
+	bool hit(uint16_t bank, uint16_t address, Registers const& registers, MMU const& mmu)
+	{
+		if (!has(bank, address)) [[likely]]
+			return false;
+		return checkCondition(bank, address, registers, mmu);
+	}
+
+	std::vector<Breakpoint> const& list() const { return breakpoints; }
+
+	// replays turn this off so the hit counters only count the first run
+	bool countHits = true;
+
+	private:
+
+	bool checkCondition(uint16_t bank, uint16_t address, Registers const& registers, MMU const& mmu);
+	Breakpoint* find(uint16_t bank, uint16_t address);
+	void setBit(Breakpoint const& breakpoint, bool armed);
+
+	std::vector<uint64_t> bits = std::vector<uint64_t>(bankCount * 0x10000 / 64);
+	// sorted on (bank, address)
+	std::vector<Breakpoint> breakpoints;
+	uint32_t armedCount = 0;
+};
+
+// "0150", "0x0150", "$0150" or "01:4150" with the bank first
+bool parseBreakpointAddress(std::string_view text, uint16_t& bank, uint16_t& address);
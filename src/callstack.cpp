@@ -0,0 +1,118 @@
+#include "callstack.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <utility>
+
+#include "memory.hpp"
+#include "symbols.hpp"
+
+void CallStack::reset(uint64_t ticks)
+{
+	frames.clear();
+	overflows = 0;
+	resetProfile(ticks);
+}
+
+void CallStack::resetProfile(uint64_t ticks)
+{
+	nodes.clear();
+	nodes.push_back({ 0, none });
+	startTick = ticks;
+	std::vector<Frame> open = frames;
+	for (Frame& frame : open)
+		frame.startTick = ticks;
+	restore(open);
+}
+
+uint32_t CallStack::child(uint32_t parent, uint32_t entry)
+{
+	uint32_t last = none;
+	for (uint32_t node = nodes[parent].firstChild; node != none; node = nodes[node].nextSibling)
+	{
+		if (nodes[node].entry == entry)
+			return node;
+		last = node;
+	}
+
+	uint32_t const node = static_cast<uint32_t>(nodes.size());
+	nodes.push_back({ entry, parent });
+	if (last == none)
+		nodes[parent].firstChild = node;
+	else
+		nodes[last].nextSibling = node;
+	return node;
+}
+
+void CallStack::restore(std::vector<Frame> const& saved)
+{
+	frames = saved;
+	uint32_t parent = root;
+	for (Frame& frame : frames)
+	{
+		frame.node = child(parent, frame.entry);
+		parent = frame.node;
+	}
+}
+
+std::vector<CallStack::Node> CallStack::profile(uint64_t ticks) const
+{
+	std::vector<Node> tree = nodes;
+	tree[root].inclusive = ticks - startTick;
+	for (Frame const& frame : frames)
+		tree[frame.node].inclusive += ticks - std::max(frame.startTick, startTick);
+	return tree;
+}
+
+uint64_t CallStack::exclusive(std::vector<Node> const& tree, uint32_t node)
+{
+	uint64_t children = 0;
+	for (uint32_t c = tree[node].firstChild; c != none; c = tree[c].nextSibling)
+		children += tree[c].inclusive;
+	return tree[node].inclusive > children ? tree[node].inclusive - children : 0;
+}
+
+bool CallStack::writeFolded(std::filesystem::path const& path, uint64_t ticks, SymbolTable const* symbols) const
+{
+	FILE* file = fopen(path.string().c_str(), "w");
+	if (file == nullptr)
+	{
+		fprintf(stderr, "error : failed to open \"%s\"\n", path.string().c_str());
+		return false;
+	}
+
+	std::vector<Node> const tree = profile(ticks);
+	if (uint64_t const self = exclusive(tree, root); self > 0)
+		fprintf(file, "[top level] %llu\n", static_cast<unsigned long long>(self));
+
+	// depth first, the path of a node is its parent's with its own name appended
+	std::string stackPath;
+	std::vector<std::pair<uint32_t, size_t>> pending;
+	for (uint32_t c = tree[root].firstChild; c != none; c = tree[c].nextSibling)
+		pending.push_back({ c, 0 });
+	while (!pending.empty())
+	{
+		auto const [node, parentLength] = pending.back();
+		pending.pop_back();
+
+		char name[128];
+		uint16_t const address = static_cast<uint16_t>(tree[node].entry);
+		if (symbols != nullptr)
+			symbols->format(MMU::bankOfBankedAddress(tree[node].entry), address, name, sizeof(name));
+		else
+			snprintf(name, sizeof(name), "0x%04X", address);
+		stackPath.resize(parentLength);
+		if (parentLength > 0)
+			stackPath += ';';
+		stackPath += name;
+
+		if (uint64_t const self = exclusive(tree, node); self > 0)
+			fprintf(file, "%s %llu\n", stackPath.c_str(), static_cast<unsigned long long>(self));
+		for (uint32_t c = tree[node].firstChild; c != none; c = tree[c].nextSibling)
+			pending.push_back({ c, stackPath.size() });
+	}
+
+	fclose(file);
+	return true;
+}
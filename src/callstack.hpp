@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+class SymbolTable;
+
+// Shadow call stack kept from CALL/RST entries and RET/RETI exits, and the calling context tree
+// of cycles it feeds. Frames are matched on the stack slot of their return address so code that
+// moves SP by hand doesn't derail it: a RET from a deeper slot unwinds the frames it skipped,
+// a RET from a slot no frame pushed is a computed jump and leaves the stack alone.
+class CallStack
+{
+	public:
+
+	static size_t constexpr maxDepth = 256;
+	static uint32_t constexpr none = UINT32_MAX;
+	// node of the code that runs outside of any call
+	static uint32_t constexpr root = 0;
+
+	struct Frame
+	{
+		uint32_t entry; // banked address of the called routine
+		uint16_t returnSlot; // sp right after the return address was pushed
+		uint32_t node;
+		uint64_t startTick;
+	};
+
+	struct Node
+	{
+		uint32_t entry;
+		uint32_t parent;
+		uint32_t firstChild = none;
+		uint32_t nextSibling = none;
+		uint64_t calls = 0;
+		uint64_t inclusive = 0; // cycles, exclusive ones are what the children don't cover
+	};
+
+	CallStack() { reset(0); }
+
+	// drops the frames and the profile, the profile starts counting at ticks
+	void reset(uint64_t ticks);
+	// clears the profile only, the frames stay
+	void resetProfile(uint64_t ticks);
+
+	void enter(uint32_t entry, uint16_t sp, uint64_t ticks)
+	{
+		// a frame whose return slot is at or below the new one already returned through sp tricks
+		while (!frames.empty() && frames.back().returnSlot <= sp)
+			pop(ticks);
+		if (frames.size() >= maxDepth) [[unlikely]]
+		{
+			overflows++;
+			return;
+		}
+		uint32_t const node = child(frames.empty() ? root : frames.back().node, entry);
+		if (recording)
+			nodes[node].calls++;
+		frames.push_back({ entry, sp, node, ticks });
+	}
+
+	void leave(uint16_t sp, uint64_t ticks)
+	{
+		// frames go up the stack from the top, a frame below sp was skipped, one above it can't match
+		for (size_t i = frames.size(); i-- > 0;)
+		{
+			if (frames[i].returnSlot > sp)
+				return;
+			if (frames[i].returnSlot == sp)
+			{
+				while (frames.size() > i)
+					pop(ticks);
+				return;
+			}
+		}
+	}
+
+	std::vector<Frame> const& stack() const { return frames; }
+	// takes saved frames back, their nodes are looked up again since the profile may have been reset
+	void restore(std::vector<Frame> const& saved);
+
+	// the tree with the time of the frames still open added, indices as in the live tree
+	std::vector<Node> profile(uint64_t ticks) const;
+	static uint64_t exclusive(std::vector<Node> const& tree, uint32_t node);
+
+	// one "outer;inner cycles" line per call path, what flamegraph.pl and speedscope read
+	bool writeFolded(std::filesystem::path const& path, uint64_t ticks, SymbolTable const* symbols = nullptr) const;
+
+	// replays turn this off so the cycles aren't counted twice, frames are still kept
+	bool recording = true;
+	// calls deeper than maxDepth that weren't tracked
+	uint64_t overflows = 0;
+
+	private:
+
+	uint32_t child(uint32_t parent, uint32_t entry);
+
+	void pop(uint64_t ticks)
+	{
+		Frame const& frame = frames.back();
+		if (recording)
+			nodes[frame.node].inclusive += ticks - frame.startTick;
+		frames.pop_back();
+	}
+
+	std::vector<Frame> frames;
+	std::vector<Node> nodes;
+	uint64_t startTick = 0;
+};
@@ -0,0 +1,53 @@
+#include "cdl.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+void CodeDataLog::clear()
+{
+	std::fill(flags.begin(), flags.end(), 0);
+}
+
+CodeDataLog::Coverage CodeDataLog::coverage() const
+{
+	Coverage result = {};
+	for (uint8_t const f : flags)
+	{
+		result.code += (f & codeFlag) != 0;
+		result.data += (f & dataFlag) != 0;
+		result.dma += (f & dmaFlag) != 0;
+		result.touched += f != 0;
+	}
+	return result;
+}
+
+bool CodeDataLog::load(std::filesystem::path const& path)
+{
+	FILE* file = fopen(path.string().c_str(), "rb");
+	if (file == nullptr)
+	{
+		fprintf(stderr, "error : failed to open \"%s\"\n", path.string().c_str());
+		return false;
+	}
+	std::vector<uint8_t> saved(flags.size());
+	size_t const size = fread(saved.data(), 1, saved.size(), file);
+	fclose(file);
+	for (size_t i = 0; i < size; i++)
+		flags[i] |= saved[i];
+	return true;
+}
+
+bool CodeDataLog::save(std::filesystem::path const& path) const
+{
+	FILE* file = fopen(path.string().c_str(), "wb");
+	if (file == nullptr)
+	{
+		fprintf(stderr, "error : failed to open \"%s\"\n", path.string().c_str());
+		return false;
+	}
+	bool const written = fwrite(flags.data(), 1, flags.size(), file) == flags.size();
+	fclose(file);
+	if (!written)
+		fprintf(stderr, "error : failed to write \"%s\"\n", path.string().c_str());
+	return written;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// Code/data log, one byte of flags per rom byte set while the game runs. Executions come from
+// the cpu fetch, data reads from the MMU read path of flagged rom pages, so a run that doesn't
+// log pays nothing. Saved as a raw .cdl, the flags of rom byte n at offset n.
+class CodeDataLog
+{
+	public:
+
+	// bit 0 executed, opcode or operand
+	// bit 1 read as data by an instruction
+	// bits 2-5 never set
+	// bit 6 executed as the first byte of an instruction
+	// bit 7 copied to oam by a DMA
+	// bits 0 and 1 mean the same as in the FCEUX and Mesen logs, so their tools read the coverage
+	static uint8_t constexpr codeFlag = 1 << 0;
+	static uint8_t constexpr dataFlag = 1 << 1;
+	static uint8_t constexpr opcodeFlag = 1 << 6;
+	static uint8_t constexpr dmaFlag = 1 << 7;
+
+	struct Coverage
+	{
+		uint32_t code;
+		uint32_t data;
+		uint32_t dma;
+		uint32_t touched; // bytes with any flag
+	};
+
+	explicit CodeDataLog(uint32_t romSize) : flags(romSize) {}
+
+	void logExecution(uint16_t pc, uint8_t length)
+	{
+		if (pc + length > flags.size()) [[unlikely]]
+			return;
+		flags[pc] |= codeFlag | opcodeFlag;
+		for (uint8_t i = 1; i < length; i++)
+			flags[pc + i] |= codeFlag;
+	}
+
+	void logRead(uint16_t address)
+	{
+		if (address < flags.size())
+			flags[address] |= dataFlag;
+	}
+
+	void logDma(uint16_t source, uint16_t length)
+	{
+		for (uint32_t address = source; address < source + length && address < flags.size(); address++)
+			flags[address] |= dmaFlag;
+	}
+
+	uint8_t at(uint16_t address) const { return address < flags.size() ? flags[address] : 0; }
+	uint32_t size() const { return static_cast<uint32_t>(flags.size()); }
+
+	void clear();
+	Coverage coverage() const;
+
+	// merges into what was logged so far, so coverage accumulates over several runs
+	bool load(std::filesystem::path const& path);
+	bool save(std::filesystem::path const& path) const;
+
+	private:
+
+	std::vector<uint8_t> flags;
+};
@@ -0,0 +1,81 @@
+#include "changeheat.hpp"
+
+#include <bit>
+#include <cstring>
+
+#include "simd.hpp"
+
+namespace
+{
+	[[maybe_unused]] uint32_t updateScalar(uint8_t const* memory, uint8_t* snapshot, uint8_t* heat)
+	{
+		uint32_t changed = 0;
+		for (size_t i = 0; i < ChangeHeat::size; i++)
+		{
+			if (memory[i] != snapshot[i])
+			{
+				heat[i] = ChangeHeat::hot;
+				snapshot[i] = memory[i];
+				changed++;
+			}
+			else
+				heat[i] = heat[i] > ChangeHeat::fade ? heat[i] - ChangeHeat::fade : 0;
+		}
+		return changed;
+	}
+
+#if GB_SIMD_X86
+	uint32_t updateSse2(uint8_t const* memory, uint8_t* snapshot, uint8_t* heat)
+	{
+		__m128i const fade = _mm_set1_epi8(static_cast<char>(ChangeHeat::fade));
+		uint32_t changed = 0;
+		for (size_t i = 0; i < ChangeHeat::size; i += 16)
+		{
+			__m128i const current = _mm_loadu_si128(reinterpret_cast<__m128i const*>(memory + i));
+			__m128i const previous = _mm_load_si128(reinterpret_cast<__m128i const*>(snapshot + i));
+			__m128i const same = _mm_cmpeq_epi8(current, previous);
+			// changed bytes are all ones in the complement, which is the hot value
+			__m128i const faded = _mm_subs_epu8(_mm_load_si128(reinterpret_cast<__m128i const*>(heat + i)), fade);
+			_mm_store_si128(reinterpret_cast<__m128i*>(heat + i), _mm_or_si128(faded, _mm_andnot_si128(same, _mm_set1_epi8(-1))));
+			_mm_store_si128(reinterpret_cast<__m128i*>(snapshot + i), current);
+			changed += 16 - std::popcount(static_cast<uint32_t>(_mm_movemask_epi8(same)));
+		}
+		return changed;
+	}
+
+	GB_TARGET_AVX2 uint32_t updateAvx2(uint8_t const* memory, uint8_t* snapshot, uint8_t* heat)
+	{
+		__m256i const fade = _mm256_set1_epi8(static_cast<char>(ChangeHeat::fade));
+		__m256i const ones = _mm256_set1_epi8(-1);
+		uint32_t changed = 0;
+		for (size_t i = 0; i < ChangeHeat::size; i += 32)
+		{
+			__m256i const current = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(memory + i));
+			__m256i const previous = _mm256_load_si256(reinterpret_cast<__m256i const*>(snapshot + i));
+			__m256i const same = _mm256_cmpeq_epi8(current, previous);
+			__m256i const faded = _mm256_subs_epu8(_mm256_load_si256(reinterpret_cast<__m256i const*>(heat + i)), fade);
+			_mm256_store_si256(reinterpret_cast<__m256i*>(heat + i), _mm256_or_si256(faded, _mm256_andnot_si256(same, ones)));
+			_mm256_store_si256(reinterpret_cast<__m256i*>(snapshot + i), current);
+			changed += 32 - std::popcount(static_cast<uint32_t>(_mm256_movemask_epi8(same)));
+		}
+		return changed;
+	}
+#endif
+}
+
+void ChangeHeat::reset(uint8_t const* memory)
+{
+	memcpy(snapshot.data(), memory, size);
+	heat.fill(0);
+}
+
+uint32_t ChangeHeat::update(uint8_t const* memory)
+{
+#if GB_SIMD_X86
+	if (simd::hasAvx2())
+		return updateAvx2(memory, snapshot.data(), heat.data());
+	return updateSse2(memory, snapshot.data(), heat.data());
+#else
+	return updateScalar(memory, snapshot.data(), heat.data());
+#endif
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// How recently every byte of the address space changed. Each update diffs memory against the
+// snapshot of the update before, 32 or 16 bytes at a time, sets the heat of changed bytes to the
+// maximum and fades the others, so a whole 64 KB pass costs a few microseconds.
+class ChangeHeat
+{
+	public:
+
+	static size_t constexpr size = 0x10000;
+	static uint8_t constexpr hot = 0xFF;
+	// heat lost per update, a change stays visible for 32 steps or frames
+	static uint8_t constexpr fade = 8;
+
+	ChangeHeat() { snapshot.fill(0); heat.fill(0); }
+
+	// takes memory as the new snapshot without marking anything
+	void reset(uint8_t const* memory);
+	// returns how many bytes changed since the last update
+	uint32_t update(uint8_t const* memory);
+
+	uint8_t at(uint16_t address) const { return heat[address]; }
+
+	private:
+
+	alignas(32) std::array<uint8_t, size> snapshot;
+	alignas(32) std::array<uint8_t, size> heat;
+};
@@ -0,0 +1,129 @@
+#include "cheats.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <iterator>
+
+#include "memory.hpp"
+
+void Cheats::add(Cheat const& cheat)
+{
+	cheats.push_back(cheat);
+	rebuild();
+}
+
+void Cheats::remove(size_t index)
+{
+	cheats.erase(cheats.begin() + index);
+	rebuild();
+}
+
+void Cheats::setEnabled(size_t index, bool enabled)
+{
+	cheats[index].enabled = enabled;
+	rebuild();
+}
+
+void Cheats::clear()
+{
+	cheats.clear();
+	rebuild();
+}
+
+void Cheats::rebuild()
+{
+	ramWrites.clear();
+	romPatches.clear();
+	std::fill(std::begin(pages), std::end(pages), false);
+	for (Cheat const& cheat : cheats)
+	{
+		if (!cheat.enabled)
+			continue;
+		if (cheat.kind == Kind::gameShark)
+			ramWrites.push_back({ cheat.address, cheat.value, cheat.compare });
+		else
+		{
+			romPatches.push_back({ cheat.address, cheat.value, cheat.compare });
+			pages[cheat.address >> 8] = true;
+		}
+	}
+}
+
+std::vector<std::string> Cheats::serialize() const
+{
+	std::vector<std::string> lines;
+	for (Cheat const& cheat : cheats)
+		lines.push_back(cheat.code + (cheat.enabled ? ",1," : ",0,") + cheat.name);
+	return lines;
+}
+
+void Cheats::deserialize(std::vector<std::string> const& lines)
+{
+	cheats.clear();
+	for (std::string const& line : lines)
+	{
+		// the name is last so it can hold commas
+		size_t const codeEnd = line.find(',');
+		size_t const enabledEnd = codeEnd != std::string::npos ? line.find(',', codeEnd + 1) : std::string::npos;
+		Cheat cheat;
+		if (enabledEnd == std::string::npos || !parseCheat(std::string_view(line).substr(0, codeEnd), cheat))
+		{
+			fprintf(stderr, "error : invalid cheat \"%s\"\n", line.c_str());
+			continue;
+		}
+		cheat.enabled = line.compare(codeEnd + 1, enabledEnd - codeEnd - 1, "1") == 0;
+		cheat.name = line.substr(enabledEnd + 1);
+		cheats.push_back(cheat);
+	}
+	rebuild();
+}
+
+bool parseCheat(std::string_view code, Cheats::Cheat& cheat)
+{
+	uint8_t digits[9];
+	size_t count = 0;
+	for (char const c : code)
+	{
+		if (c == '-' || isspace(static_cast<unsigned char>(c)))
+			continue;
+		if (!isxdigit(static_cast<unsigned char>(c)) || count == std::size(digits))
+			return false;
+		digits[count++] = static_cast<uint8_t>(isdigit(static_cast<unsigned char>(c)) ? c - '0' : toupper(c) - 'A' + 10);
+	}
+
+	cheat.code.clear();
+	for (size_t i = 0; i < count; i++)
+	{
+		// Game Genie codes are shown in their usual 3-3-3 groups
+		if (count != 8 && i > 0 && i % 3 == 0)
+			cheat.code += '-';
+		cheat.code += "0123456789ABCDEF"[digits[i]];
+	}
+
+	if (count == 8)
+	{
+		// the type byte selects a ram bank on the cgb, there's only one here
+		cheat.kind = Cheats::Kind::gameShark;
+		cheat.value = static_cast<uint8_t>(digits[2] << 4 | digits[3]);
+		cheat.address = static_cast<uint16_t>(digits[6] << 12 | digits[7] << 8 | digits[4] << 4 | digits[5]);
+		cheat.compare = -1;
+		return cheat.address >= MMU::romSize;
+	}
+
+	if (count == 6 || count == 9)
+	{
+		cheat.kind = Cheats::Kind::gameGenie;
+		cheat.value = static_cast<uint8_t>(digits[0] << 4 | digits[1]);
+		cheat.address = static_cast<uint16_t>((digits[5] ^ 0xF) << 12 | digits[2] << 8 | digits[3] << 4 | digits[4]);
+		cheat.compare = -1;
+		if (count == 9)
+		{
+			// digits 7 and 9 hold it rotated right by 2 and xored, digit 8 isn't used
+			uint8_t const scrambled = static_cast<uint8_t>(digits[6] << 4 | digits[8]);
+			cheat.compare = static_cast<uint8_t>((scrambled >> 2 | scrambled << 6) ^ 0xBA);
+		}
+		return cheat.address < MMU::romSize;
+	}
+	return false;
+}
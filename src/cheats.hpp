@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// GameShark and Game Genie codes. GameShark codes store a value to ram once per frame, the
+// Gameboy applies them on frame boundaries. Game Genie codes swap a rom byte as it's read, the
+// MMU only asks for the pages one patches so every other page keeps the direct path.
+class Cheats
+{
+	public:
+
+	enum class Kind : uint8_t
+	{
+		gameShark, // ttvvaaaa, type, value and little endian address
+		gameGenie, // vva-aaa-cxc or vva-aaa, new value, scrambled address and compare value
+	};
+
+	struct Cheat
+	{
+		std::string code;
+		std::string name;
+		Kind kind;
+		bool enabled = true;
+		uint16_t address;
+		uint8_t value;
+		int16_t compare = -1; // the rom byte a Game Genie code replaces, -1 replaces any
+	};
+
+	void add(Cheat const& cheat);
+	void remove(size_t index);
+	void setEnabled(size_t index, bool enabled);
+	void clear();
+
+	std::vector<Cheat> const& list() const { return cheats; }
+	bool active() const { return !ramWrites.empty() || !romPatches.empty(); }
+	bool hasRamWrites() const { return !ramWrites.empty(); }
+	bool patchesPage(uint8_t page) const { return pages[page]; }
+
+	// called from the MMU for reads and fetches of patched pages
+	uint8_t patch(uint16_t address, uint8_t value) const
+	{
+		for (Substitution const& substitution : romPatches)
+		{
+			if (substitution.address == address && (substitution.compare < 0 || substitution.compare == value))
+				return substitution.value;
+		}
+		return value;
+	}
+
+	void applyRamWrites(uint8_t* memory) const
+	{
+		for (Substitution const& write : ramWrites)
+			memory[write.address] = write.value;
+	}
+
+	// one "code,enabled,name" line per cheat, what the settings keep per rom
+	std::vector<std::string> serialize() const;
+	void deserialize(std::vector<std::string> const& lines);
+
+	private:
+
+	struct Substitution
+	{
+		uint16_t address;
+		uint8_t value;
+		int16_t compare;
+	};
+
+	void rebuild();
+
+	std::vector<Cheat> cheats;
+	// what the enabled cheats of each kind do, kept apart from the names and codes
+	std::vector<Substitution> ramWrites;
+	std::vector<Substitution> romPatches;
+	bool pages[0x100] = {};
+};
+
+// accepts both formats with or without dashes, false when it's neither or targets the wrong memory
+bool parseCheat(std::string_view code, Cheats::Cheat& cheat);
@@ -0,0 +1,95 @@
+#include "codemap.hpp"
+
+#include <iterator>
+
+#include "disassembly.hpp"
+#include "memory.hpp"
+
+static uint16_t constexpr entryPoint = 0x0100;
+static uint16_t constexpr interruptVectors[] = { 0x40, 0x48, 0x50, 0x58, 0x60 };
+
+CodeMap analyzeCode(std::vector<uint8_t> rom)
+{
+	CodeMap map;
+	rom.resize(MMU::romSize);
+
+	// explicit stack instead of recursion, every branch target is a new path
+	std::vector<uint16_t> pending = { entryPoint };
+	pending.insert(pending.end(), std::begin(interruptVectors), std::end(interruptVectors));
+
+	auto const follow = [&](uint32_t target)
+	{
+		// code in ram is copied there at runtime, nothing to analyze
+		if (target < MMU::romSize)
+			pending.push_back(static_cast<uint16_t>(target));
+	};
+
+	while (!pending.empty())
+	{
+		uint32_t address = pending.back();
+		pending.pop_back();
+
+		while (address < MMU::romSize && map.kind(static_cast<uint16_t>(address)) == CodeMap::Kind::Unknown)
+		{
+			uint8_t const opCode = rom[address];
+			uint8_t const length = instructionLength(opCode);
+			// an illegal opcode or an instruction overlapping one already found means this path ran into data
+			if (length == 0 || address + length > MMU::romSize)
+				break;
+			bool overlaps = false;
+			for (uint32_t i = 1; i < length; i++)
+				overlaps |= map.kind(static_cast<uint16_t>(address + i)) != CodeMap::Kind::Unknown;
+			if (overlaps)
+				break;
+
+			map.set(static_cast<uint16_t>(address), CodeMap::Kind::Opcode);
+			for (uint32_t i = 1; i < length; i++)
+				map.set(static_cast<uint16_t>(address + i), CodeMap::Kind::Operand);
+			map.instructionCount++;
+
+			uint32_t const next = address + length;
+			uint16_t const immediate = length == 3 ? static_cast<uint16_t>(rom[address + 1] | rom[address + 2] << 8) : 0;
+			uint32_t const relative = next + static_cast<int8_t>(rom[address + 1]);
+
+			bool fallsThrough = true;
+			switch (opCode)
+			{
+				case 0x18: // JR e
+					follow(relative & 0xFFFF);
+					fallsThrough = false;
+					break;
+				case 0x20: case 0x28: case 0x30: case 0x38: // JR cc, e
+					follow(relative & 0xFFFF);
+					break;
+				case 0xC3: // JP nn
+					follow(immediate);
+					fallsThrough = false;
+					break;
+				case 0xC2: case 0xCA: case 0xD2: case 0xDA: // JP cc, nn
+				case 0xC4: case 0xCC: case 0xD4: case 0xDC: case 0xCD: // CALL
+					follow(immediate);
+					break;
+				case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF: // RST
+					follow(opCode & 0x38);
+					break;
+				case 0xC9: case 0xD9: // RET, RETI
+				case 0xE9: // JP (HL), the target is only known at runtime
+					fallsThrough = false;
+					break;
+			}
+			if (!fallsThrough)
+				break;
+			address = next;
+		}
+	}
+
+	for (uint32_t address = 0; address < MMU::romSize; address++)
+	{
+		if (map.kind(static_cast<uint16_t>(address)) == CodeMap::Kind::Unknown)
+		{
+			map.set(static_cast<uint16_t>(address), CodeMap::Kind::Data);
+			map.dataBytes++;
+		}
+	}
+	return map;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// What every byte of the rom is, 2 bits per byte, found by following the control flow
+// from the entry point and the interrupt vectors. Ram is left Unknown, its code changes at runtime.
+class CodeMap
+{
+	public:
+
+	enum class Kind : uint8_t
+	{
+		Unknown,
+		Opcode,  // first byte of an instruction reached by the analysis
+		Operand,
+		Data,    // rom byte no path reaches
+	};
+
+	static uint32_t constexpr addressCount = 0x10000;
+
+	CodeMap() : bits(addressCount / 4) {}
+
+	Kind kind(uint16_t address) const
+	{
+		return static_cast<Kind>(bits[address >> 2] >> ((address & 3) * 2) & 3);
+	}
+
+	void set(uint16_t address, Kind kind)
+	{
+		uint8_t const shift = (address & 3) * 2;
+		bits[address >> 2] = static_cast<uint8_t>((bits[address >> 2] & ~(3 << shift)) | static_cast<uint8_t>(kind) << shift);
+	}
+
+	bool empty() const { return instructionCount == 0; }
+
+	uint32_t instructionCount = 0;
+	uint32_t dataBytes = 0;
+
+	private:
+
+	std::vector<uint8_t> bits;
+};
+
+// recursive descent over the rom, takes a copy so it can run on a worker thread while the console runs
+CodeMap analyzeCode(std::vector<uint8_t> rom);
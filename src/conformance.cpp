@@ -0,0 +1,233 @@
+#include "conformance.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+#include "tracing.hpp"
+
+namespace conformance
+{
+
+std::vector<Rom> collectRoms(std::filesystem::path const& source, uint64_t defaultTimeout)
+{
+	std::vector<Rom> roms;
+	if (std::filesystem::is_directory(source))
+	{
+		for (auto const& entry : std::filesystem::recursive_directory_iterator(source))
+		{
+			if (entry.is_regular_file() && entry.path().extension() == ".gb")
+				roms.push_back({ entry.path(), defaultTimeout });
+		}
+		std::sort(roms.begin(), roms.end(), [](Rom const& a, Rom const& b) { return a.path < b.path; });
+		return roms;
+	}
+
+	std::ifstream list(source);
+	std::string line;
+	while (std::getline(list, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		std::istringstream fields(line);
+		Rom rom;
+		std::string path;
+		fields >> path;
+		rom.path = source.parent_path() / path;
+		if (!(fields >> rom.timeoutCycles))
+			rom.timeoutCycles = defaultTimeout;
+		roms.push_back(rom);
+	}
+	return roms;
+}
+
+// Mooneye roms load 3/5/8/13/21/34 in B/C/D/E/H/L on success and 0x42 everywhere on failure
+static bool detectFibonacci(Registers const& r, Result& result)
+{
+	if (r.b == 3 && r.c == 5 && r.d == 8 && r.e == 13 && r.h == 21 && r.l == 34)
+	{
+		result = Result::Passed;
+		return true;
+	}
+	if (r.b == 0x42 && r.c == 0x42 && r.d == 0x42 && r.e == 0x42 && r.h == 0x42 && r.l == 0x42)
+	{
+		result = Result::Failed;
+		return true;
+	}
+	return false;
+}
+
+// Blargg roms print "Passed" or "Failed" on the serial port
+static bool detectSerial(std::string const& output, Result& result)
+{
+	if (output.find("Passed") != std::string::npos)
+	{
+		result = Result::Passed;
+		return true;
+	}
+	if (output.find("Failed") != std::string::npos)
+	{
+		result = Result::Failed;
+		return true;
+	}
+	return false;
+}
+
+// Blargg roms also write their status to 0xA000 once the DE B0 61 signature is in place,
+// 0x80 while running, then the result code followed by the text from 0xA004
+static bool detectMemory(MMU const& mmu, Result& result, std::string& output)
+{
+	static uint16_t constexpr statusAddress = 0xA000;
+	static uint16_t constexpr textAddress = 0xA004;
+	static uint16_t constexpr textEnd = 0xBFFF;
+
+	if (mmu.memMap[0xA001] != 0xDE || mmu.memMap[0xA002] != 0xB0 || mmu.memMap[0xA003] != 0x61)
+		return false;
+
+	uint8_t const status = mmu.memMap[statusAddress];
+	if (status == 0x80)
+		return false;
+
+	output.clear();
+	for (uint16_t address = textAddress; address < textEnd && mmu.memMap[address] != 0; address++)
+		output.push_back(static_cast<char>(mmu.memMap[address]));
+
+	result = status == 0 ? Result::Passed : Result::Failed;
+	return true;
+}
+
+Report runRom(Rom const& rom)
+{
+	GB_TRACE_ZONE("conformance rom");
+	Report report;
+	report.rom = rom;
+
+	auto gb = std::make_unique<Gameboy>();
+	gb->breakOnFault = false;
+	if (!gb->loadCardridge(rom.path))
+	{
+		report.result = Result::LoadError;
+		return report;
+	}
+	gb->start();
+
+	std::string serialOutput;
+	gb->onSerialOut = [&serialOutput](uint8_t byte) { serialOutput.push_back(static_cast<char>(byte)); };
+
+	auto const start = std::chrono::steady_clock::now();
+	uint64_t const startTick = gb->ticks;
+	uint64_t const endTick = startTick + rom.timeoutCycles;
+
+	// verdicts are checked once per frame, roms idle in a loop once they are done
+	while (gb->ticks < endTick)
+	{
+		if (gb->run(std::min(endTick, gb->ticks + Gameboy::cyclesPerFrame)) == Gameboy::RunResult::Fault)
+		{
+			report.result = Result::Fault;
+			break;
+		}
+
+		if (detectSerial(serialOutput, report.result))
+		{
+			report.detectedBy = "serial";
+			break;
+		}
+		if (detectFibonacci(gb->registers, report.result))
+		{
+			report.detectedBy = "registers";
+			break;
+		}
+		if (detectMemory(gb->mmu, report.result, report.output))
+		{
+			report.detectedBy = "memory";
+			break;
+		}
+	}
+
+	report.cycles = gb->ticks - startTick;
+	report.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (report.output.empty())
+		report.output = serialOutput;
+	return report;
+}
+
+std::vector<Report> runAll(std::vector<Rom> const& roms, unsigned threadCount)
+{
+	std::vector<Report> reports(roms.size());
+	std::atomic<size_t> next = 0;
+
+	auto const worker = [&]()
+	{
+		for (size_t i = next++; i < roms.size(); i = next++)
+			reports[i] = runRom(roms[i]);
+	};
+
+	threadCount = std::max(1u, std::min<unsigned>(threadCount, static_cast<unsigned>(roms.size())));
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < threadCount; i++)
+		threads.emplace_back(worker);
+	worker();
+	for (std::thread& thread : threads)
+		thread.join();
+
+	return reports;
+}
+
+char const* resultName(Result result)
+{
+	switch (result)
+	{
+		case Result::Passed: return "PASS";
+		case Result::Failed: return "FAIL";
+		case Result::Timeout: return "TIMEOUT";
+		case Result::Fault: return "FAULT";
+		case Result::LoadError: return "LOAD ERROR";
+	}
+	return "?";
+}
+
+void printTable(std::vector<Report> const& reports)
+{
+	static double constexpr clockHz = 4194304.0;
+
+	size_t nameWidth = 8;
+	for (Report const& report : reports)
+		nameWidth = std::max(nameWidth, report.rom.path.filename().string().size());
+
+	printf("%-*s  %-10s  %-9s  %14s  %10s  %9s\n", static_cast<int>(nameWidth), "rom", "result", "detection", "cycles", "wall ms", "speed");
+
+	size_t passed = 0;
+	uint64_t totalCycles = 0;
+	double totalSeconds = 0.0;
+	for (Report const& report : reports)
+	{
+		// emulated time over wall time, how many times faster than a real console
+		double const speed = report.wallSeconds > 0.0 ? report.cycles / clockHz / report.wallSeconds : 0.0;
+		printf("%-*s  %-10s  %-9s  %14llu  %10.2f  %8.1fx\n",
+			static_cast<int>(nameWidth), report.rom.path.filename().string().c_str(),
+			resultName(report.result), report.detectedBy,
+			static_cast<unsigned long long>(report.cycles), report.wallSeconds * 1000.0, speed);
+
+		passed += report.result == Result::Passed;
+		totalCycles += report.cycles;
+		totalSeconds += report.wallSeconds;
+	}
+
+	printf("%zu/%zu passed, %llu cycles emulated in %.2f s summed over all roms\n",
+		passed, reports.size(), static_cast<unsigned long long>(totalCycles), totalSeconds);
+
+	for (Report const& report : reports)
+	{
+		if (report.result != Result::Passed && !report.output.empty())
+			printf("\n%s output:\n%s\n", report.rom.path.filename().string().c_str(), report.output.c_str());
+	}
+}
+
+}
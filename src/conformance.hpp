@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "gameboy.hpp"
+
+// Runs test roms (Blargg, Mooneye) without a window and detects their verdict from
+// the serial output, the Mooneye Fibonacci registers or Blargg's text in cartridge RAM.
+namespace conformance
+{
+	// about 30 emulated seconds, enough for the slowest cpu_instrs roms
+	static uint64_t constexpr defaultTimeoutCycles = 30ull * 4194304;
+
+	struct Rom
+	{
+		std::filesystem::path path;
+		uint64_t timeoutCycles = defaultTimeoutCycles;
+	};
+
+	enum class Result
+	{
+		Passed,
+		Failed,
+		Timeout,
+		Fault,
+		LoadError,
+	};
+
+	struct Report
+	{
+		Rom rom;
+		Result result = Result::Timeout;
+		char const* detectedBy = "-";
+		uint64_t cycles = 0;
+		double wallSeconds = 0.0;
+		std::string output;
+	};
+
+	// source is a directory searched for .gb files, or a text file listing "<rom> [timeout cycles]" per line
+	std::vector<Rom> collectRoms(std::filesystem::path const& source, uint64_t defaultTimeout);
+	Report runRom(Rom const& rom);
+	std::vector<Report> runAll(std::vector<Rom> const& roms, unsigned threadCount);
+	void printTable(std::vector<Report> const& reports);
+	char const* resultName(Result result);
+}
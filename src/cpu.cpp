@@ -11,9 +11,12 @@ static void stop(Gameboy& gb)
 	
 }
 
+// there's no interrupt dispatch, a halted cpu wakes up and carries on after the HALT once
+// an event raises an enabled interrupt. One that is already pending doesn't halt at all
 static void halt(Gameboy& gb)
 {
-	__debugbreak(); // TODO
+	if (!(gb.mmu.memMap[MMU::ieAddress] & gb.mmu.memMap[MMU::ifAddress] & MMU::interruptMask))
+		gb.halted = true;
 }
 
 static void rlca(Gameboy& gb)
@@ -32,10 +35,10 @@ static void rlca(Gameboy& gb)
 #define EACH_R(M, ...) M(a, __VA_ARGS__) M(b, __VA_ARGS__) M(c, __VA_ARGS__) M(d, __VA_ARGS__) M(e, __VA_ARGS__) M(h, __VA_ARGS__) M(l, __VA_ARGS__)
 #define EACH_RR(M) M(af) M(bc) M(de) M(hl)
 
-#define LD_DRR_R(r1, r2) static void ld_##r1##_##r2##(Gameboy& gb) { gb.mmu.memMap[gb.registers.##r1##()] = gb.registers.##r2; }
+#define LD_DRR_R(r1, r2) static void ld_##r1##_##r2##(Gameboy& gb) { gb.mmu.writeByte(gb.registers.##r1##(), gb.registers.##r2); }
 LD_DRR_R(bc, a)
 
-#define LD_R_DRR(r1, r2) static void ld_##r1##_##r2##(Gameboy& gb) { gb.registers.##r1 = gb.mmu.memMap[gb.registers.##r2##()]; }
+#define LD_R_DRR(r1, r2) static void ld_##r1##_##r2##(Gameboy& gb) { gb.registers.##r1 = gb.mmu.readByte(gb.registers.##r2##()); }
 LD_R_DRR(a, bc)
 LD_R_DRR(a, de)
 
@@ -100,7 +103,7 @@ static void ldi_dhl_a(Gameboy& gb)
 
 static void ldi_a_dhl(Gameboy& gb)
 {
-	gb.registers.a = gb.registers.hl();
+	gb.registers.a = gb.mmu.readByte(gb.registers.hl());
 	gb.registers.hl()++;
 }
 
@@ -112,7 +115,7 @@ static void ldd_dhl_a(Gameboy& gb)
 
 static void ldd_a_dhl(Gameboy& gb)
 {
-	gb.registers.a = gb.registers.hl();
+	gb.registers.a = gb.mmu.readByte(gb.registers.hl());
 	gb.registers.hl()--;
 }
 
@@ -155,7 +158,24 @@ EACH_R(ADD_R)
 #define SUB_R(r) static void sub_##r(Gameboy& gb) { gb.registers.a -= gb.registers.##r; }
 EACH_R(SUB_R)
 
-#define ADD_RR(r) static void add_##r(Gameboy& gb) { gb.registers.hl() = gb.registers.##r(); }
+static void add_hl_impl(Gameboy& gb, uint16_t value)
+{
+	uint16_t const hl = gb.registers.hl();
+	if ((hl & 0x0FFF) + (value & 0x0FFF) > 0x0FFF)
+		gb.registers.setFlags(Registers::halfCarryFlag);
+	else
+		gb.registers.clearFlags(Registers::halfCarryFlag);
+
+	if (hl + value > 0xFFFF)
+		gb.registers.setFlags(Registers::carryFlag);
+	else
+		gb.registers.clearFlags(Registers::carryFlag);
+
+	gb.registers.clearFlags(Registers::negativeFlag);
+	gb.registers.hl() = hl + value;
+}
+
+#define ADD_RR(r) static void add_##r(Gameboy& gb) { add_hl_impl(gb, gb.registers.##r()); }
 EACH_RR(ADD_RR)
 
 static void add_n(Gameboy& gb, uint8_t value)
@@ -236,7 +256,7 @@ static void jr_nz_n(Gameboy& gb, uint8_t value)
 		gb.ticks += 8;
 	else
 	{
-		gb.registers.pc += value;
+		gb.registers.pc += static_cast<int8_t>(value);
 		gb.ticks += 12;
 	}
 }
@@ -245,7 +265,7 @@ static void jr_z_n(Gameboy& gb, uint8_t value)
 {
 	if (gb.registers.isFlagSet(Registers::zeroFlag))
 	{
-		gb.registers.pc += value;
+		gb.registers.pc += static_cast<int8_t>(value);
 		gb.ticks += 12;
 	}
 	else
@@ -254,8 +274,7 @@ static void jr_z_n(Gameboy& gb, uint8_t value)
 
 static void jr_n(Gameboy& gb, uint8_t value)
 {
-	gb.registers.pc += value;
-	__debugbreak();
+	gb.registers.pc += static_cast<int8_t>(value);
 }
 
 static void rrca(Gameboy& gb)
@@ -288,26 +307,53 @@ static void rla(Gameboy& gb)
 	gb.registers.clearFlags(Registers::negativeFlag | Registers::zeroFlag | Registers::halfCarryFlag);
 }
 
-static void call_z_nn(Gameboy& gb, uint16_t value)
+// the shadow call stack sees every entry and return, see CallStack
+static void push_call(Gameboy& gb, uint16_t address)
 {
-	if (gb.registers.isFlagSet(Registers::zeroFlag))
-	{
-		gb.registers.sp -= 2;
-		gb.mmu.writeShort(gb.registers.sp, gb.registers.pc);
-		gb.registers.pc = value;
-		gb.ticks += 24;
-	}
-	else
-		gb.ticks += 12;
+	gb.registers.sp -= 2;
+	gb.mmu.writeShort(gb.registers.sp, gb.registers.pc);
+	gb.registers.pc = address;
+	gb.callStack.enter(gb.mmu.bankedAddress(address), gb.registers.sp, gb.ticks);
+}
+
+static void pop_return(Gameboy& gb)
+{
+	gb.callStack.leave(gb.registers.sp, gb.ticks);
+	gb.registers.pc = gb.mmu.readShort(gb.registers.sp);
+	gb.registers.sp += 2;
 }
 
 static void call_nn(Gameboy& gb, uint16_t value)
 {
-	gb.registers.sp -= 2;
-	gb.mmu.writeShort(gb.registers.sp, gb.registers.pc);
-	gb.registers.pc = value;
+	push_call(gb, value);
 }
 
+#define CALL_CC_NN(cc, condition) static void call_##cc##_nn(Gameboy& gb, uint16_t value) { if (condition) { push_call(gb, value); gb.ticks += 24; } else gb.ticks += 12; }
+CALL_CC_NN(nz, !gb.registers.isFlagSet(Registers::zeroFlag))
+CALL_CC_NN(z, gb.registers.isFlagSet(Registers::zeroFlag))
+CALL_CC_NN(nc, !gb.registers.isFlagSet(Registers::carryFlag))
+CALL_CC_NN(c, gb.registers.isFlagSet(Registers::carryFlag))
+
+static void ret(Gameboy& gb)
+{
+	pop_return(gb);
+}
+
+// no interrupts yet, so nothing for IME to enable
+static void reti(Gameboy& gb)
+{
+	pop_return(gb);
+}
+
+#define RET_CC(cc, condition) static void ret_##cc(Gameboy& gb) { if (condition) { pop_return(gb); gb.ticks += 20; } else gb.ticks += 8; }
+RET_CC(nz, !gb.registers.isFlagSet(Registers::zeroFlag))
+RET_CC(z, gb.registers.isFlagSet(Registers::zeroFlag))
+RET_CC(nc, !gb.registers.isFlagSet(Registers::carryFlag))
+RET_CC(c, gb.registers.isFlagSet(Registers::carryFlag))
+
+#define RST(n) static void rst_##n(Gameboy& gb) { push_call(gb, 0x##n); }
+RST(00) RST(08) RST(10) RST(18) RST(20) RST(28) RST(30) RST(38)
+
 static void rra(Gameboy& gb)
 {
 	int const carry = (gb.registers.isFlagSet(Registers::carryFlag) ? 1 : 0) << 7;
@@ -353,18 +399,120 @@ static void daa(Gameboy& gb)
 		gb.registers.setFlags(Registers::carryFlag);
 }
 
+// CB prefixed instructions, the low 3 bits pick the operand and the upper ones the operation
+
+static uint8_t& cb_operand(Gameboy& gb, uint8_t index)
+{
+	switch (index)
+	{
+		case 0: return gb.registers.b;
+		case 1: return gb.registers.c;
+		case 2: return gb.registers.d;
+		case 3: return gb.registers.e;
+		case 4: return gb.registers.h;
+		case 5: return gb.registers.l;
+		default: return gb.registers.a;
+	}
+}
+
+template<uint8_t opCode>
+static void cb_op(Gameboy& gb)
+{
+	// (hl) goes through the mmu, read into a temporary and written back unless it's a BIT
+	bool constexpr memoryOperand = (opCode & 0x07) == 6;
+	uint8_t memoryValue = memoryOperand ? gb.mmu.readByte(gb.registers.hl()) : 0;
+	uint8_t& value = memoryOperand ? memoryValue : cb_operand(gb, opCode & 0x07);
+	uint8_t constexpr bit = (opCode >> 3) & 0x07;
+
+	if constexpr (opCode >= 0xC0)
+	{
+		value |= 1 << bit;
+	}
+	else if constexpr (opCode >= 0x80)
+	{
+		value &= ~(1 << bit);
+	}
+	else if constexpr (opCode >= 0x40)
+	{
+		if (value & (1 << bit))
+			gb.registers.clearFlags(Registers::zeroFlag);
+		else
+			gb.registers.setFlags(Registers::zeroFlag);
+		gb.registers.clearFlags(Registers::negativeFlag);
+		gb.registers.setFlags(Registers::halfCarryFlag);
+	}
+	else
+	{
+		uint8_t const carryIn = gb.registers.isFlagSet(Registers::carryFlag) ? 1 : 0;
+		uint8_t carryOut = 0;
+		uint8_t result = 0;
+		if constexpr (bit == 0) // RLC
+		{
+			carryOut = value >> 7;
+			result = (value << 1) | carryOut;
+		}
+		else if constexpr (bit == 1) // RRC
+		{
+			carryOut = value & 0x01;
+			result = (value >> 1) | (carryOut << 7);
+		}
+		else if constexpr (bit == 2) // RL
+		{
+			carryOut = value >> 7;
+			result = (value << 1) | carryIn;
+		}
+		else if constexpr (bit == 3) // RR
+		{
+			carryOut = value & 0x01;
+			result = (value >> 1) | (carryIn << 7);
+		}
+		else if constexpr (bit == 4) // SLA
+		{
+			carryOut = value >> 7;
+			result = value << 1;
+		}
+		else if constexpr (bit == 5) // SRA
+		{
+			carryOut = value & 0x01;
+			result = (value >> 1) | (value & 0x80);
+		}
+		else if constexpr (bit == 6) // SWAP
+		{
+			result = (value << 4) | (value >> 4);
+		}
+		else // SRL
+		{
+			carryOut = value & 0x01;
+			result = value >> 1;
+		}
+
+		value = result;
+		gb.registers.f = (result == 0 ? Registers::zeroFlag : 0) | (carryOut ? Registers::carryFlag : 0);
+	}
+
+	if constexpr (memoryOperand && (opCode < 0x40 || opCode >= 0x80))
+		gb.mmu.writeByte(gb.registers.hl(), memoryValue);
+}
+
+static void prefix_cb(Gameboy& gb, uint8_t opCode)
+{
+	Instruction const& instr = cbInstructions[opCode];
+	std::get<void(*)(Gameboy&)>(instr.op)(gb);
+	gb.ticks += instr.cycles;
+}
+
 #define UNDEFINED_INSTRUCTION {0, 0, nop, "UNDEFINED"}
 
 Instruction instructions[256] = {
 	{ 1, 4, nop, "NOP"}, // 00
-	{ 3, 6, ld_bc_nn, "LD BC, 0x%04X" }, // 01
+	{ 3, 12, ld_bc_nn, "LD BC, 0x%04X" }, // 01
 	{ 1, 8, ld_bc_a, "LD (BC), A" }, //02
 	{ 1, 8, inc_bc, "INC BC" }, // 03
 	{ 1, 4, inc_b, "INC B" }, // 04
 	{ 1, 4, dec_b, "DEC B" }, // 05
-	{ 2, 4, ld_b_n, "LD B, 0x%02X" }, // 06
+	{ 2, 8, ld_b_n, "LD B, 0x%02X" }, // 06
 	{ 1, 4, rlca, "RLCA" }, // 07
-	{ 3, 16, ld_dnn_sp, "LD (0x%04X), SP" }, // 08
+	{ 3, 20, ld_dnn_sp, "LD (0x%04X), SP" }, // 08
 	{ 1, 8, add_bc, "ADD BC"}, // 09
 	{ 1, 8, ld_a_bc, "LD A, (BC)" }, // 0A
 	{ 1, 8, dec_bc, "DEC BC" }, // 0B
@@ -372,8 +520,8 @@ Instruction instructions[256] = {
 	{ 1, 4, dec_c, "DEC C" }, // 0D
 	{ 2, 8, ld_c_n, "LD C, 0x%02X" }, // 0E
 	{ 1, 4, rrca, "RRCA"}, // 0F
-	{ 1, 0, stop, "STOP" }, // 10
-	{ 3, 8, ld_de_nn, "LD DE, 0x%04X" }, // 11
+	{ 1, 4, stop, "STOP" }, // 10
+	{ 3, 12, ld_de_nn, "LD DE, 0x%04X" }, // 11
 	{ 1, 8, ld_dde_a, "LD (DE), A" }, // 12
 	{ 1, 8, inc_de, "INC DE" }, // 13
 	{ 1, 4, inc_d, "INC D" }, // 14
@@ -473,8 +621,8 @@ Instruction instructions[256] = {
 	UNDEFINED_INSTRUCTION, // 72
 	UNDEFINED_INSTRUCTION, // 73
 	UNDEFINED_INSTRUCTION, // 74
-	{ 1, 4, halt, "HALT" }, // 75
-	UNDEFINED_INSTRUCTION, // 76
+	UNDEFINED_INSTRUCTION, // 75
+	{ 1, 4, halt, "HALT" }, // 76
 	UNDEFINED_INSTRUCTION, // 77
 	{ 1, 4, ld_a_b, "LD A, B" }, // 78
 	{ 1, 4, ld_a_c, "LD A, C" },
@@ -526,7 +674,7 @@ Instruction instructions[256] = {
 	{ 1, 4, and_a, "AND A" },
 	{ 1, 4, xor_b, "XOR B" },
 	{ 1, 4, xor_c, "XOR C" },
-	{ 1, 4, xor_b, "XOR D" },
+	{ 1, 4, xor_d, "XOR D" },
 	{ 1, 4, xor_e, "XOR E" },
 	{ 1, 4, xor_h, "XOR H" },
 	{ 1, 4, xor_l, "XOR L" },
@@ -542,36 +690,44 @@ Instruction instructions[256] = {
 	{ 1, 4, or_a, "OR A" }, // b7
 	{ 1, 4, cp_b, "CP B" },
 	{ 1, 4, cp_c, "CP C" },
-	{ 1, 4, cp_a, "CP D" },
-	{ 1, 4, cp_a, "CP E" },
-	{ 1, 4, cp_a, "CP H" },
-	{ 1, 4, cp_a, "CP L" },
+	{ 1, 4, cp_d, "CP D" },
+	{ 1, 4, cp_e, "CP E" },
+	{ 1, 4, cp_h, "CP H" },
+	{ 1, 4, cp_l, "CP L" },
 	UNDEFINED_INSTRUCTION,
 	{ 1, 4, cp_a, "CP A" },			// bf
-	UNDEFINED_INSTRUCTION,			// c0
-	{ 1, 16, pop_bc, "POP BC" },	// c1
+	{ 1, 0 /*variable ticks*/, ret_nz, "RET NZ" }, // c0
+	{ 1, 12, pop_bc, "POP BC" },	// c1
 	UNDEFINED_INSTRUCTION,			// c2
 	{ 3, 16, jp_nn, "JP 0x%04X" },	// c3
-	UNDEFINED_INSTRUCTION, // c4
+	{ 3, 0 /*variable ticks*/, call_nz_nn, "CALL NZ, 0x%04X" }, // c4
 	UNDEFINED_INSTRUCTION, // c5
 	UNDEFINED_INSTRUCTION, // c6
-	UNDEFINED_INSTRUCTION, // c7
-	UNDEFINED_INSTRUCTION, // c8
-	UNDEFINED_INSTRUCTION, // c9
+	{ 1, 16, rst_00, "RST 0x00" }, // c7
+	{ 1, 0 /*variable ticks*/, ret_z, "RET Z" }, // c8
+	{ 1, 16, ret, "RET" }, // c9
 	UNDEFINED_INSTRUCTION, // ca
-	UNDEFINED_INSTRUCTION, // cb 
+	{ 2, 0 /*cycles from the cb table*/, prefix_cb, "PREFIX CB 0x%02X" }, // cb
 	{ 3, 0 /*variable ticks*/, call_z_nn, "CALL Z, 0x%04X" }, // cc
 	{ 3, 24, call_nn, "CALL 0x%04X" }, // cd
 	UNDEFINED_INSTRUCTION, // ce
+	{ 1, 16, rst_08, "RST 0x08" }, // cf
+	{ 1, 0 /*variable ticks*/, ret_nc, "RET NC" }, // d0
 	UNDEFINED_INSTRUCTION,
 	UNDEFINED_INSTRUCTION,
 	UNDEFINED_INSTRUCTION,
+	{ 3, 0 /*variable ticks*/, call_nc_nn, "CALL NC, 0x%04X" }, // d4
 	UNDEFINED_INSTRUCTION,
 	UNDEFINED_INSTRUCTION,
+	{ 1, 16, rst_10, "RST 0x10" }, // d7
+	{ 1, 0 /*variable ticks*/, ret_c, "RET C" }, // d8
+	{ 1, 16, reti, "RETI" }, // d9
 	UNDEFINED_INSTRUCTION,
 	UNDEFINED_INSTRUCTION,
+	{ 3, 0 /*variable ticks*/, call_c_nn, "CALL C, 0x%04X" }, // dc
 	UNDEFINED_INSTRUCTION,
 	UNDEFINED_INSTRUCTION,
+	{ 1, 16, rst_18, "RST 0x18" }, // df
 	UNDEFINED_INSTRUCTION,
 	UNDEFINED_INSTRUCTION,
 	UNDEFINED_INSTRUCTION,
@@ -579,6 +735,7 @@ Instruction instructions[256] = {
 	UNDEFINED_INSTRUCTION,
 	UNDEFINED_INSTRUCTION,
 	UNDEFINED_INSTRUCTION,
+	{ 1, 16, rst_20, "RST 0x20" }, // e7
 	UNDEFINED_INSTRUCTION,
 	UNDEFINED_INSTRUCTION,
 	UNDEFINED_INSTRUCTION,
@@ -586,24 +743,15 @@ Instruction instructions[256] = {
 	UNDEFINED_INSTRUCTION,
 	UNDEFINED_INSTRUCTION,
 	UNDEFINED_INSTRUCTION,
+	{ 1, 16, rst_28, "RST 0x28" }, // ef
 	UNDEFINED_INSTRUCTION,
-	UNDEFINED_INSTRUCTION,
-	UNDEFINED_INSTRUCTION,
-	UNDEFINED_INSTRUCTION,
-	UNDEFINED_INSTRUCTION,
-	UNDEFINED_INSTRUCTION,
-	UNDEFINED_INSTRUCTION,
-	UNDEFINED_INSTRUCTION,
-	UNDEFINED_INSTRUCTION,
-	UNDEFINED_INSTRUCTION,
-	UNDEFINED_INSTRUCTION,
-	{ 1, 16, pop_af, "POP AF" }, // f1
+	{ 1, 12, pop_af, "POP AF" }, // f1
 	UNDEFINED_INSTRUCTION,
 	UNDEFINED_INSTRUCTION,
 	UNDEFINED_INSTRUCTION,
 	{ 1, 16, push_af, "PUSH AF" }, // f5
 	UNDEFINED_INSTRUCTION,
-	UNDEFINED_INSTRUCTION, // f7
+	{ 1, 16, rst_30, "RST 0x30" }, // f7
 	UNDEFINED_INSTRUCTION,
 	UNDEFINED_INSTRUCTION,
 	UNDEFINED_INSTRUCTION,
@@ -611,5 +759,51 @@ Instruction instructions[256] = {
 	UNDEFINED_INSTRUCTION,
 	UNDEFINED_INSTRUCTION,
 	{ 2, 8, cp_n, "CP 0x%02X" }, //fe
-	UNDEFINED_INSTRUCTION, //ff
+	{ 1, 16, rst_38, "RST 0x38" }, // ff
 };
+
+// (HL) operands take 8 more cycles, 4 for BIT which doesn't write back
+#define CB_ROW(name, base, hlCycles) \
+	{ 2, 8, cb_op<base + 0>, name " B" }, \
+	{ 2, 8, cb_op<base + 1>, name " C" }, \
+	{ 2, 8, cb_op<base + 2>, name " D" }, \
+	{ 2, 8, cb_op<base + 3>, name " E" }, \
+	{ 2, 8, cb_op<base + 4>, name " H" }, \
+	{ 2, 8, cb_op<base + 5>, name " L" }, \
+	{ 2, hlCycles, cb_op<base + 6>, name " (HL)" }, \
+	{ 2, 8, cb_op<base + 7>, name " A" },
+
+Instruction cbInstructions[256] = {
+	CB_ROW("RLC", 0x00, 16)
+	CB_ROW("RRC", 0x08, 16)
+	CB_ROW("RL", 0x10, 16)
+	CB_ROW("RR", 0x18, 16)
+	CB_ROW("SLA", 0x20, 16)
+	CB_ROW("SRA", 0x28, 16)
+	CB_ROW("SWAP", 0x30, 16)
+	CB_ROW("SRL", 0x38, 16)
+	CB_ROW("BIT 0,", 0x40, 12)
+	CB_ROW("BIT 1,", 0x48, 12)
+	CB_ROW("BIT 2,", 0x50, 12)
+	CB_ROW("BIT 3,", 0x58, 12)
+	CB_ROW("BIT 4,", 0x60, 12)
+	CB_ROW("BIT 5,", 0x68, 12)
+	CB_ROW("BIT 6,", 0x70, 12)
+	CB_ROW("BIT 7,", 0x78, 12)
+	CB_ROW("RES 0,", 0x80, 16)
+	CB_ROW("RES 1,", 0x88, 16)
+	CB_ROW("RES 2,", 0x90, 16)
+	CB_ROW("RES 3,", 0x98, 16)
+	CB_ROW("RES 4,", 0xA0, 16)
+	CB_ROW("RES 5,", 0xA8, 16)
+	CB_ROW("RES 6,", 0xB0, 16)
+	CB_ROW("RES 7,", 0xB8, 16)
+	CB_ROW("SET 0,", 0xC0, 16)
+	CB_ROW("SET 1,", 0xC8, 16)
+	CB_ROW("SET 2,", 0xD0, 16)
+	CB_ROW("SET 3,", 0xD8, 16)
+	CB_ROW("SET 4,", 0xE0, 16)
+	CB_ROW("SET 5,", 0xE8, 16)
+	CB_ROW("SET 6,", 0xF0, 16)
+	CB_ROW("SET 7,", 0xF8, 16)
+};
\ No newline at end of file
@@ -6,39 +6,40 @@
 
 struct Registers {
 	
-	uint8_t a;
+	// low byte first so the pairs read right on little endian hosts, B is the high byte of BC
 	uint8_t f;
+	uint8_t a;
 
-	uint8_t b;
 	uint8_t c;
+	uint8_t b;
 
-	uint8_t d;
 	uint8_t e;
+	uint8_t d;
 
-	uint8_t h;
 	uint8_t l;
+	uint8_t h;
 	
 	uint16_t sp;
 	uint16_t pc;
 
 	uint16_t& af()
 	{
-		return *std::bit_cast<uint16_t*>(&a);
+		return *std::bit_cast<uint16_t*>(&f);
 	}
 	
 	uint16_t& bc()
 	{
-		return *std::bit_cast<uint16_t*>(&b);
+		return *std::bit_cast<uint16_t*>(&c);
 	}
 
 	uint16_t& de()
 	{
-		return *std::bit_cast<uint16_t*>(&d);
+		return *std::bit_cast<uint16_t*>(&e);
 	}
 
 	uint16_t& hl()
 	{
-		return *std::bit_cast<uint16_t*>(&h);
+		return *std::bit_cast<uint16_t*>(&l);
 	}
 
 	static uint8_t constexpr zeroFlag = 1 << 7;
@@ -78,5 +79,9 @@ struct Instruction
 	const char* name;
 };
 
+static uint8_t constexpr cbPrefix = 0xCB;
+
 extern Instruction instructions[256];
+// second byte of the 0xCB prefixed instructions
+extern Instruction cbInstructions[256];
 
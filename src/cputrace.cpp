@@ -0,0 +1,341 @@
+#include "cputrace.hpp"
+
+#include <cstring>
+
+#include "symbols.hpp"
+
+static char constexpr traceMagic[8] = { 'G', 'B', 'T', 'R', 'A', 'C', 'E', '1' };
+// one bit per byte of a record that changed, stored as 3 bytes before the changed bytes
+static size_t constexpr maskBytes = 3;
+
+// writes the bytes of record that differ from previous, most lines only touch pc, a flag and ticks.
+// out needs room for maxEncodedSize bytes, returns the end of what was written
+static size_t constexpr maxEncodedSize = maskBytes + sizeof(TraceRecord);
+static uint8_t* encodeRecord(TraceRecord const& record, TraceRecord const& previous, uint8_t* out)
+{
+	uint8_t const* bytes = reinterpret_cast<uint8_t const*>(&record);
+	uint8_t const* prevBytes = reinterpret_cast<uint8_t const*>(&previous);
+
+	uint8_t* changed = out + maskBytes;
+	uint32_t mask = 0;
+	// whole 8 byte words are skipped first, ticks and the register bytes rarely all move
+	for (uint32_t word = 0; word < sizeof(TraceRecord); word += 8)
+	{
+		uint64_t current, prev;
+		memcpy(&current, bytes + word, 8);
+		memcpy(&prev, prevBytes + word, 8);
+		if (current == prev)
+			continue;
+		for (uint32_t i = word; i < word + 8; i++)
+		{
+			*changed = bytes[i];
+			uint32_t const differs = bytes[i] != prevBytes[i];
+			mask |= differs << i;
+			changed += differs;
+		}
+	}
+	for (size_t i = 0; i < maskBytes; i++)
+		out[i] = static_cast<uint8_t>(mask >> (i * 8));
+	return changed;
+}
+
+static bool decodeRecord(uint8_t const* data, size_t size, size_t& offset, TraceRecord& record)
+{
+	if (offset + maskBytes > size)
+		return false;
+	uint32_t mask = 0;
+	for (size_t i = 0; i < maskBytes; i++)
+		mask |= static_cast<uint32_t>(data[offset++]) << (i * 8);
+
+	uint8_t* bytes = reinterpret_cast<uint8_t*>(&record);
+	for (uint32_t i = 0; i < sizeof(TraceRecord); i++)
+	{
+		if (mask & (1u << i))
+		{
+			if (offset >= size)
+				return false;
+			bytes[i] = data[offset++];
+		}
+	}
+	return true;
+}
+
+CpuTraceWriter::~CpuTraceWriter()
+{
+	close();
+}
+
+bool CpuTraceWriter::open(std::filesystem::path const& path)
+{
+	file = fopen(path.string().c_str(), "wb");
+	if (file == nullptr)
+	{
+		fprintf(stderr, "error : failed to open \"%s\"\n", path.string().c_str());
+		return false;
+	}
+	fwrite(traceMagic, 1, sizeof(traceMagic), file);
+	written = sizeof(traceMagic);
+
+	for (size_t i = 0; i < maxPendingBatches; i++)
+		freeBatches.emplace_back().resize(batchRecords);
+	batch = std::move(freeBatches.back());
+	freeBatches.pop_back();
+	batchSize = 0;
+	submitted = 0;
+	closing = false;
+
+	writer = std::thread(&CpuTraceWriter::writerLoop, this);
+	return true;
+}
+
+void CpuTraceWriter::close()
+{
+	if (file == nullptr)
+		return;
+
+	if (batchSize > 0)
+	{
+		batch.resize(batchSize);
+		submit();
+	}
+	{
+		std::lock_guard const lock(mutex);
+		closing = true;
+	}
+	cv.notify_all();
+	writer.join();
+
+	fclose(file);
+	file = nullptr;
+	pending.clear();
+	freeBatches.clear();
+	batch.clear();
+}
+
+void CpuTraceWriter::submit()
+{
+	std::unique_lock lock(mutex);
+	submitted += batchSize;
+	pending.push_back(std::move(batch));
+	cv.notify_all();
+
+	// waits only when the writer is maxPendingBatches behind
+	cv.wait(lock, [this]() { return !freeBatches.empty() || closing; });
+	if (!freeBatches.empty())
+	{
+		batch = std::move(freeBatches.back());
+		freeBatches.pop_back();
+	}
+	batch.resize(batchRecords);
+	batchSize = 0;
+}
+
+void CpuTraceWriter::writerLoop()
+{
+	std::vector<uint8_t> compressed;
+	for (;;)
+	{
+		std::vector<TraceRecord> records;
+		{
+			std::unique_lock lock(mutex);
+			cv.wait(lock, [this]() { return !pending.empty() || closing; });
+			if (pending.empty())
+				return;
+			records = std::move(pending.front());
+			pending.erase(pending.begin());
+		}
+
+		uint32_t header[2] = { static_cast<uint32_t>(records.size()), 0 };
+		compressed.resize(sizeof(header) + records.size() * maxEncodedSize);
+		uint8_t* out = compressed.data() + sizeof(header);
+		TraceRecord previous = {};
+		for (TraceRecord const& record : records)
+		{
+			out = encodeRecord(record, previous, out);
+			previous = record;
+		}
+		compressed.resize(out - compressed.data());
+		header[1] = static_cast<uint32_t>(compressed.size() - sizeof(header));
+		memcpy(compressed.data(), header, sizeof(header));
+		fwrite(compressed.data(), 1, compressed.size(), file);
+
+		std::lock_guard const lock(mutex);
+		written += compressed.size();
+		records.resize(batchRecords);
+		freeBatches.push_back(std::move(records));
+		cv.notify_all();
+	}
+}
+
+CpuTraceReader::~CpuTraceReader()
+{
+	if (file != nullptr)
+		fclose(file);
+}
+
+bool CpuTraceReader::open(std::filesystem::path const& path)
+{
+	file = fopen(path.string().c_str(), "rb");
+	if (file == nullptr)
+	{
+		fprintf(stderr, "error : failed to open \"%s\"\n", path.string().c_str());
+		return false;
+	}
+
+	char magic[sizeof(traceMagic)] = {};
+	binary = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, traceMagic, sizeof(magic)) == 0;
+	if (!binary)
+		rewind(file);
+	return true;
+}
+
+bool CpuTraceReader::readBlock()
+{
+	uint32_t header[2];
+	if (fread(header, sizeof(header), 1, file) != 1)
+		return false;
+	block.resize(header[1]);
+	if (fread(block.data(), 1, block.size(), file) != block.size())
+		return false;
+	blockRecords = header[0];
+	blockOffset = 0;
+	previous = {};
+	return true;
+}
+
+bool CpuTraceReader::next(TraceRecord& record)
+{
+	if (file == nullptr)
+		return false;
+
+	if (!binary)
+	{
+		char line[128];
+		while (fgets(line, sizeof(line), file) != nullptr)
+		{
+			unsigned a, f, b, c, d, e, h, l, sp, pc, mem[4];
+			if (sscanf(line, "A:%x F:%x B:%x C:%x D:%x E:%x H:%x L:%x SP:%x PC:%x PCMEM:%x,%x,%x,%x",
+				&a, &f, &b, &c, &d, &e, &h, &l, &sp, &pc, &mem[0], &mem[1], &mem[2], &mem[3]) != 14)
+				continue;
+			record = { static_cast<uint16_t>(pc), static_cast<uint16_t>(sp),
+				static_cast<uint8_t>(a), static_cast<uint8_t>(f), static_cast<uint8_t>(b), static_cast<uint8_t>(c),
+				static_cast<uint8_t>(d), static_cast<uint8_t>(e), static_cast<uint8_t>(h), static_cast<uint8_t>(l),
+				{ static_cast<uint8_t>(mem[0]), static_cast<uint8_t>(mem[1]), static_cast<uint8_t>(mem[2]), static_cast<uint8_t>(mem[3]) },
+				0 };
+			return true;
+		}
+		return false;
+	}
+
+	while (blockRecords == 0)
+	{
+		if (!readBlock())
+			return false;
+	}
+	if (!decodeRecord(block.data(), block.size(), blockOffset, previous))
+	{
+		fprintf(stderr, "error : truncated trace block\n");
+		return false;
+	}
+	blockRecords--;
+	record = previous;
+	return true;
+}
+
+namespace cputrace
+{
+
+void formatDoctorLine(TraceRecord const& r, char* out, size_t size)
+{
+	snprintf(out, size, "A:%02X F:%02X B:%02X C:%02X D:%02X E:%02X H:%02X L:%02X SP:%04X PC:%04X PCMEM:%02X,%02X,%02X,%02X",
+		r.a, r.f, r.b, r.c, r.d, r.e, r.h, r.l, r.sp, r.pc, r.pcMem[0], r.pcMem[1], r.pcMem[2], r.pcMem[3]);
+}
+
+bool convertToDoctor(std::filesystem::path const& tracePath, std::filesystem::path const& outPath)
+{
+	CpuTraceReader reader;
+	if (!reader.open(tracePath))
+		return false;
+
+	FILE* out = stdout;
+	if (!outPath.empty())
+	{
+		out = fopen(outPath.string().c_str(), "w");
+		if (out == nullptr)
+		{
+			fprintf(stderr, "error : failed to open \"%s\"\n", outPath.string().c_str());
+			return false;
+		}
+	}
+
+	char line[128];
+	TraceRecord record;
+	while (reader.next(record))
+	{
+		formatDoctorLine(record, line, sizeof(line));
+		fputs(line, out);
+		fputc('\n', out);
+	}
+
+	if (out != stdout)
+		fclose(out);
+	return true;
+}
+
+bool diff(std::filesystem::path const& a, std::filesystem::path const& b, SymbolTable const* symbols)
+{
+	CpuTraceReader readers[2];
+	if (!readers[0].open(a) || !readers[1].open(b))
+		return false;
+	// doctor logs have no cycle count, ticks are only compared between two binary traces
+	bool const compareTicks = readers[0].hasTicks() && readers[1].hasTicks();
+
+	TraceRecord previous = {};
+	TraceRecord ra, rb;
+	for (uint64_t index = 0;; index++)
+	{
+		bool const hasA = readers[0].next(ra);
+		bool const hasB = readers[1].next(rb);
+		if (!hasA || !hasB)
+		{
+			if (hasA != hasB)
+			{
+				printf("traces match for %llu instructions, then \"%s\" ends\n",
+					static_cast<unsigned long long>(index), (hasA ? b : a).string().c_str());
+				return false;
+			}
+			printf("traces match, %llu instructions\n", static_cast<unsigned long long>(index));
+			return true;
+		}
+
+		if (!compareTicks)
+			ra.ticks = rb.ticks = 0;
+		if (memcmp(&ra, &rb, sizeof(TraceRecord)) != 0)
+		{
+			auto const print = [&](char const* name, TraceRecord const& record, bool ticks)
+			{
+				char line[128];
+				formatDoctorLine(record, line, sizeof(line));
+				printf("  %-8s %s", name, line);
+				if (ticks)
+					printf(" CY:%llu", static_cast<unsigned long long>(record.ticks));
+				if (symbols != nullptr)
+				{
+					symbols->format(MMU::bankOfBankedAddress(record.pc), record.pc, line, sizeof(line));
+					printf(" %s", line);
+				}
+				printf("\n");
+			};
+
+			printf("first divergence at instruction %llu\n", static_cast<unsigned long long>(index));
+			if (index > 0)
+				print("previous", previous, false);
+			print("a", ra, compareTicks);
+			print("b", rb, compareTicks);
+			return false;
+		}
+		previous = ra;
+	}
+}
+
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cpu.hpp"
+#include "memory.hpp"
+
+class SymbolTable;
+
+// State before an instruction executes, what a line of a Gameboy Doctor log holds plus the cycle count.
+struct TraceRecord
+{
+	uint16_t pc;
+	uint16_t sp;
+	uint8_t a, f, b, c, d, e, h, l;
+	uint8_t pcMem[4];
+	uint64_t ticks;
+};
+static_assert(sizeof(TraceRecord) == 24);
+
+// Binary instruction trace. Records are batched on the emulation thread and a writer thread
+// delta compresses every full batch against the previous record before it goes to disk.
+// Layout: "GBTRACE1", then blocks of { u32 records, u32 bytes, payload }, each block starts
+// from a zeroed record so it decodes on its own.
+class CpuTraceWriter
+{
+	public:
+
+	static size_t constexpr batchRecords = 1 << 16;
+	// batches queued for the writer before the emulation waits for it
+	static size_t constexpr maxPendingBatches = 8;
+
+	~CpuTraceWriter();
+
+	bool open(std::filesystem::path const& path);
+	// flushes the partial batch and waits for everything to be written
+	void close();
+
+	void record(Registers const& registers, MMU const& mmu, uint64_t ticks)
+	{
+		uint16_t const pc = registers.pc;
+		TraceRecord& r = batch[batchSize++];
+		r.pc = pc;
+		r.sp = registers.sp;
+		r.a = registers.a; r.f = registers.f;
+		r.b = registers.b; r.c = registers.c;
+		r.d = registers.d; r.e = registers.e;
+		r.h = registers.h; r.l = registers.l;
+		for (uint16_t i = 0; i < 4; i++)
+			r.pcMem[i] = mmu.memMap[static_cast<uint16_t>(pc + i)];
+		r.ticks = ticks;
+		if (batchSize == batchRecords) [[unlikely]]
+			submit();
+	}
+
+	uint64_t recorded() const { return submitted + batchSize; }
+	uint64_t bytesWritten() const { return written; }
+
+	private:
+
+	void submit();
+	void writerLoop();
+
+	FILE* file = nullptr;
+	std::vector<TraceRecord> batch;
+	size_t batchSize = 0;
+	uint64_t submitted = 0;
+	// added to by the writer thread, read by the ui while it runs
+	std::atomic<uint64_t> written = 0;
+
+	std::thread writer;
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::vector<std::vector<TraceRecord>> pending;
+	std::vector<std::vector<TraceRecord>> freeBatches;
+	bool closing = false;
+};
+
+// Reads a binary trace, or a Gameboy Doctor text log which has no cycle counts.
+class CpuTraceReader
+{
+	public:
+
+	~CpuTraceReader();
+
+	bool open(std::filesystem::path const& path);
+	bool next(TraceRecord& record);
+
+	bool hasTicks() const { return binary; }
+
+	private:
+
+	bool readBlock();
+
+	FILE* file = nullptr;
+	bool binary = false;
+	std::vector<uint8_t> block;
+	size_t blockOffset = 0;
+	uint32_t blockRecords = 0;
+	TraceRecord previous = {};
+};
+
+namespace cputrace
+{
+	void formatDoctorLine(TraceRecord const& record, char* out, size_t size);
+
+	// writes a trace as a Gameboy Doctor log, to stdout when path is empty
+	bool convertToDoctor(std::filesystem::path const& tracePath, std::filesystem::path const& outPath);
+
+	// prints the first record where the two traces disagree, returns true when they match,
+	// pc is also shown as label+offset when symbols are given
+	bool diff(std::filesystem::path const& a, std::filesystem::path const& b, SymbolTable const* symbols = nullptr);
+}
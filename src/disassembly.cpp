@@ -0,0 +1,239 @@
+#include "disassembly.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "cpu.hpp"
+#include "memory.hpp"
+#include "symbols.hpp"
+
+uint8_t instructionLength(uint8_t opCode)
+{
+	switch (opCode)
+	{
+		case 0x06: case 0x0E: case 0x16: case 0x1E: case 0x26: case 0x2E: case 0x36: case 0x3E:
+		case 0x10: case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:
+		case 0xC6: case 0xCE: case 0xD6: case 0xDE: case 0xE6: case 0xEE: case 0xF6: case 0xFE:
+		case 0xCB: case 0xE0: case 0xE8: case 0xF0: case 0xF8:
+			return 2;
+		case 0x01: case 0x08: case 0x11: case 0x21: case 0x31:
+		case 0xC2: case 0xC3: case 0xC4: case 0xCA: case 0xCC: case 0xCD:
+		case 0xD2: case 0xD4: case 0xDA: case 0xDC: case 0xEA: case 0xFA:
+			return 3;
+		case 0xD3: case 0xDB: case 0xDD: case 0xE3: case 0xE4: case 0xEB: case 0xEC: case 0xED: case 0xF4: case 0xFC: case 0xFD:
+			return 0;
+		default:
+			return 1;
+	}
+}
+
+uint8_t formatInstruction(uint8_t const* memory, uint16_t address, char* out, size_t size)
+{
+	uint8_t const opCode = memory[address];
+	uint8_t const operand = memory[static_cast<uint16_t>(address + 1)];
+	if (opCode == cbPrefix)
+	{
+		snprintf(out, size, "%s", cbInstructions[operand].name);
+		return 2;
+	}
+
+	Instruction const& instr = instructions[opCode];
+	if (instr.len == 2)
+		snprintf(out, size, instr.name, operand);
+	else if (instr.len == 3)
+		snprintf(out, size, instr.name, operand | memory[static_cast<uint16_t>(address + 2)] << 8);
+	else if (instr.len == 0)
+		snprintf(out, size, "%s 0x%02X", instr.name, opCode);
+	else
+		snprintf(out, size, "%s", instr.name);
+	// the cpu table has no length for what isn't implemented, the listing still has to skip the operands
+	return std::max<uint8_t>(instructionLength(opCode), 1);
+}
+
+uint32_t Disassembly::decodeLine(uint8_t const* memory, uint32_t address, std::vector<Line>& out)
+{
+	char buffer[64];
+	uint8_t length = 0;
+	CodeMap::Kind const kind = codeMap != nullptr ? codeMap->kind(static_cast<uint16_t>(address)) : CodeMap::Kind::Unknown;
+	if (kind == CodeMap::Kind::Data || kind == CodeMap::Kind::Operand)
+	{
+		// consecutive data bytes share a line, an operand only starts a line when the map and memory disagree
+		int written = snprintf(buffer, sizeof(buffer), "db 0x%02X", memory[address]);
+		for (length = 1; length < maxDataPerLine && address + length < addressCount
+			&& codeMap->kind(static_cast<uint16_t>(address + length)) == CodeMap::Kind::Data; length++)
+			written += snprintf(buffer + written, sizeof(buffer) - written, ", 0x%02X", memory[address + length]);
+	}
+	else
+	{
+		length = formatInstruction(memory, static_cast<uint16_t>(address), buffer, sizeof(buffer));
+	}
+	uint8_t const textLength = static_cast<uint8_t>(strlen(buffer));
+
+	// an instruction running past the end of the address space is cut, its operands would wrap to 0
+	uint32_t const next = std::min(address + length, addressCount);
+	out.push_back({ static_cast<uint16_t>(address), static_cast<uint8_t>(next - address), textLength, static_cast<uint32_t>(arena.size()) });
+	arena.append(buffer, textLength);
+
+	lineStart[address] = true;
+	for (uint32_t i = address + 1; i < next; i++)
+		lineStart[i] = false;
+	return next;
+}
+
+void Disassembly::build(uint8_t const* memory)
+{
+	lines.clear();
+	arena.clear();
+	deadText = 0;
+	lineStart.assign(addressCount, false);
+	source.assign(memory, memory + addressCount);
+
+	// about 4 characters per byte of code, 3 bytes per instruction on average
+	lines.reserve(addressCount / 2);
+	arena.reserve(addressCount * 4);
+	for (uint32_t address = 0; address < addressCount;)
+		address = decodeLine(memory, address, lines);
+
+	rebuildIndex();
+}
+
+bool Disassembly::refresh(uint8_t const* memory)
+{
+	bool const changed = refresh(memory, MMU::romSize, MMU::ioBegin);
+	return refresh(memory, MMU::hramBegin, addressCount) || changed;
+}
+
+bool Disassembly::refresh(uint8_t const* memory, uint32_t first, uint32_t end)
+{
+	if (source.empty())
+	{
+		build(memory);
+		return true;
+	}
+
+	auto const findChange = [&](uint32_t from) -> uint32_t
+	{
+		// 8 bytes at a time, most of the range is unchanged
+		while (from + 8 <= end && memcmp(&source[from], &memory[from], 8) == 0)
+			from += 8;
+		while (from < end && source[from] == memory[from])
+			from++;
+		return from;
+	};
+	// bytes past end count as unchanged, the io registers would never let the listing sync again
+	auto const unchanged = [&](uint32_t from, uint32_t to) -> bool
+	{
+		to = std::min(to, end);
+		return from >= to || memcmp(&source[from], &memory[from], to - from) == 0;
+	};
+
+	bool changed = false;
+	for (uint32_t address = first; address < end;)
+	{
+		uint32_t const change = findChange(address);
+		if (change >= end)
+			break;
+
+		// back to the start of the instruction the changed byte belongs to
+		uint32_t start = change;
+		while (!lineStart[start])
+			start--;
+
+		// re-decode until a line starts where an old one did and the bytes it decodes didn't move
+		decoded.clear();
+		uint32_t next = start;
+		do
+		{
+			next = decodeLine(memory, next, decoded);
+		} while (next < addressCount && (next <= change || !lineStart[next] || !unchanged(next, next + maxDataPerLine)));
+
+		memcpy(&source[start], &memory[start], next - start);
+		splice(start, next, decoded);
+		changed = true;
+		address = next;
+	}
+
+	if (changed)
+		compactArena();
+	return changed;
+}
+
+void Disassembly::splice(uint32_t start, uint32_t end, std::vector<Line> const& replacement)
+{
+	uint32_t const firstLine = addressToLine[start];
+	uint32_t const endLine = end < addressCount ? addressToLine[end] : static_cast<uint32_t>(lines.size());
+	for (uint32_t i = firstLine; i < endLine; i++)
+		deadText += lines[i].textLength;
+
+	if (replacement.size() == endLine - firstLine)
+	{
+		std::copy(replacement.begin(), replacement.end(), lines.begin() + firstLine);
+	}
+	else
+	{
+		lines.erase(lines.begin() + firstLine, lines.begin() + endLine);
+		lines.insert(lines.begin() + firstLine, replacement.begin(), replacement.end());
+		int32_t const shift = static_cast<int32_t>(replacement.size()) - static_cast<int32_t>(endLine - firstLine);
+		for (uint32_t address = end; address < addressCount; address++)
+			addressToLine[address] += shift;
+	}
+	for (uint32_t i = firstLine; i < firstLine + replacement.size(); i++)
+		indexLine(i);
+}
+
+void Disassembly::rebuildIndex()
+{
+	addressToLine.resize(addressCount);
+	for (uint32_t i = 0; i < lines.size(); i++)
+		indexLine(i);
+}
+
+void Disassembly::indexLine(uint32_t index)
+{
+	Line const& line = lines[index];
+	for (uint32_t address = line.address; address < line.address + line.length; address++)
+		addressToLine[address] = index;
+}
+
+void Disassembly::compactArena()
+{
+	// re-decoded lines append their text, the arena is rewritten once half of it is dead
+	if (deadText * 2 < arena.size())
+		return;
+
+	std::string compacted;
+	compacted.reserve((arena.size() - deadText) * 2);
+	for (Line& line : lines)
+	{
+		uint32_t const offset = static_cast<uint32_t>(compacted.size());
+		compacted.append(arena, line.textOffset, line.textLength);
+		line.textOffset = offset;
+	}
+	arena = std::move(compacted);
+	deadText = 0;
+}
+
+bool Disassembly::writeListing(std::filesystem::path const& path, SymbolTable const* symbols) const
+{
+	FILE* file = fopen(path.string().c_str(), "w");
+	if (file == nullptr)
+	{
+		fprintf(stderr, "error : failed to open \"%s\"\n", path.string().c_str());
+		return false;
+	}
+
+	for (Line const& line : lines)
+	{
+		if (symbols != nullptr)
+		{
+			SymbolTable::Match const match = symbols->find(MMU::bankOfBankedAddress(line.address), line.address);
+			if (!match.name.empty() && match.offset == 0)
+				fprintf(file, "%.*s:\n", static_cast<int>(match.name.size()), match.name.data());
+		}
+		std::string_view const code = text(line);
+		fprintf(file, "0x%04X  %.*s\n", line.address, static_cast<int>(code.size()), code.data());
+	}
+	fclose(file);
+	return true;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "codemap.hpp"
+
+class SymbolTable;
+
+// length of every sm83 opcode, also the ones the cpu doesn't implement yet, 0 for the illegal ones
+uint8_t instructionLength(uint8_t opCode);
+
+// writes the instruction at address, returns its length, at least 1 so illegal opcodes still advance
+uint8_t formatInstruction(uint8_t const* memory, uint16_t address, char* out, size_t size);
+
+// Disassembly of the whole address space decoded once, text kept in a single arena.
+// There is no mbc yet so rom banks 0 and 1 are the first 0x8000 bytes of the flat map.
+// refresh() compares against the bytes the listing was built from and only re-decodes
+// from a changed byte until the instruction boundaries line up with the old listing again,
+// the new lines are spliced in place and the index only moves when the line count changes.
+// With a code map, rom bytes no path reaches are listed as data instead of desyncing the code after them.
+class Disassembly
+{
+	public:
+
+	static uint32_t constexpr addressCount = 0x10000;
+	static uint8_t constexpr maxDataPerLine = 8;
+
+	struct Line
+	{
+		uint16_t address;
+		uint8_t length;
+		uint8_t textLength;
+		uint32_t textOffset;
+	};
+
+	// call build() again after changing the map, nullptr lists everything as code
+	void setCodeMap(CodeMap const* map) { codeMap = map; }
+
+	void build(uint8_t const* memory);
+	// returns true when some lines changed. The ram, the io registers left out since they change
+	// every frame and aren't code, rom is only written by the memory editor which refreshes it itself
+	bool refresh(uint8_t const* memory);
+	// what changed in [first, end), the re-decoded lines may run past end until they're in sync
+	bool refresh(uint8_t const* memory, uint32_t first, uint32_t end);
+
+	size_t lineCount() const { return lines.size(); }
+	Line const& line(size_t index) const { return lines[index]; }
+	std::string_view text(Line const& line) const { return std::string_view(arena.data() + line.textOffset, line.textLength); }
+	// index of the line the address belongs to, an operand byte maps to its instruction
+	uint32_t lineOf(uint16_t address) const { return addressToLine[address]; }
+	bool isData(Line const& line) const { return codeMap != nullptr && codeMap->kind(line.address) == CodeMap::Kind::Data; }
+
+	// symbols add a "label:" line before every labelled address
+	bool writeListing(std::filesystem::path const& path, SymbolTable const* symbols = nullptr) const;
+
+	private:
+
+	uint32_t decodeLine(uint8_t const* memory, uint32_t address, std::vector<Line>& out);
+	void rebuildIndex();
+	void indexLine(uint32_t index);
+	// replaces the lines of [start, end), start and end are line starts of the old listing
+	void splice(uint32_t start, uint32_t end, std::vector<Line> const& replacement);
+	void compactArena();
+
+	CodeMap const* codeMap = nullptr;
+	std::vector<Line> lines;
+	std::string arena;
+	// text of replaced lines still in the arena
+	size_t deadText = 0;
+	std::vector<uint32_t> addressToLine;
+	// set where a line starts, what tells refresh() the old listing is back in sync
+	std::vector<bool> lineStart;
+	std::vector<uint8_t> source;
+	// refresh() decodes into it before splicing
+	std::vector<Line> decoded;
+};
@@ -1,12 +1,55 @@
 #include "gameboy.hpp"
 
+#include <algorithm>
 #include <cstring>
+#include <fstream>
+#include <utility>
+#include <vector>
+
+#include "cputrace.hpp"
+#include "disassembly.hpp"
+
+Gameboy::Gameboy(PpuMode ppuMode) : ppuMode(ppuMode)
+{
+	if (ppuMode == PpuMode::fifo)
+	{
+		mmu.beforeVideoWrite = [this]
+		{
+			// stores land on the last memory cycle of their instruction
+			uint8_t const cycles = instructions[mmu.memMap[instructionPc]].cycles;
+			ppu.advance<PpuMode::fifo>(mmu, ticks + std::max<uint8_t>(cycles, 4) - 4);
+		};
+	}
+}
 
 void Gameboy::loadCardridge(uint8_t* data, size_t size)
 {
 	memcpy(mmu.rom(), data, size);
 }
 
+bool Gameboy::loadCardridge(std::filesystem::path const& romPath)
+{
+	std::ifstream file(romPath, std::ios::binary | std::ios::ate);
+	if (!file)
+	{
+		fprintf(stderr, "error : failed to open \"%s\"\n", romPath.string().c_str());
+		return false;
+	}
+
+	size_t const size = file.tellg();
+	if (size > MMU::romSize)
+	{
+		fprintf(stderr, "error : cardrige is too big\n");
+		return false;
+	}
+
+	std::vector<uint8_t> data(size);
+	file.seekg(0, std::ios::beg);
+	file.read(reinterpret_cast<char*>(data.data()), size);
+	loadCardridge(data.data(), size);
+	return true;
+}
+
 void Gameboy::start()
 {
 	registers.af() = 0x01B0;
@@ -15,6 +58,7 @@ void Gameboy::start()
 	registers.hl() = 0x014D;
 	registers.sp = 0xFFFE;
 	registers.pc = 0x100;
+	halted = false;
 	
 	mmu.memMap[0xFF05] = 0x00; // TIMA
 	mmu.memMap[0xFF06] = 0x00; // TMA
@@ -46,46 +90,359 @@ void Gameboy::start()
 	mmu.memMap[0xFF49] = 0xFF; // OBP1
 	mmu.memMap[0xFF4A] = 0x00; // WY
 	mmu.memMap[0xFF4B] = 0x00; // WX
-	// mmu.memMap[0xFFFF] = 0x00; // IE
+	mmu.memMap[0xFFFF] = 0x00; // IE
+	callStack.reset(ticks);
+	ppu.reset(mmu, ticks);
+	scheduleNextEvent();
 }
 
 void Gameboy::cpuStep()
 {
-	Instruction const instr = instructions[mmu.rom()[registers.pc]];
+	uint16_t const pc = registers.pc;
+	uint8_t const opCode = mmu.fetchByte(pc);
+	Instruction const instr = instructions[opCode];
+#ifdef GB_OPCODE_PROFILER
+	uint16_t const profileIndex = opCode == cbPrefix ? 256 + mmu.rom()[pc + 1] : opCode;
+	uint64_t const startTicks = ticks;
+#endif
+	if (cpuTrace) [[unlikely]]
+		cpuTrace->record(registers, mmu, ticks);
+	if (mmu.codeDataLog) [[unlikely]]
+		mmu.codeDataLog->logExecution(pc, instr.len);
+	// pc already points to the next instruction while this one executes
+	registers.pc += instr.len;
 	switch (instr.len)
 	{
 		case 1:
 			std::get<void(*)(Gameboy&)>(instr.op)(*this);
 			break;
 		case 2:
-			std::get<void(*)(Gameboy&, uint8_t)>(instr.op)(*this, mmu.readByte(registers.pc + 1));
+			std::get<void(*)(Gameboy&, uint8_t)>(instr.op)(*this, mmu.fetchByte(pc + 1));
 			break;
 		case 3:
-			std::get<void(*)(Gameboy&, uint16_t)>(instr.op)(*this, mmu.readShort(registers.pc + 1));
+			std::get<void(*)(Gameboy&, uint16_t)>(instr.op)(*this, mmu.fetchShort(pc + 1));
 			break;
 		default:
-			fprintf(stderr, "instruction not implemented: %s, 0x%02X\n", disassembleInstruction(registers.pc).c_str(), mmu.rom()[registers.pc]);
-			__debugbreak();
+			fprintf(stderr, "instruction not implemented: %s, 0x%02X\n", disassembleInstruction(pc).c_str(), opCode);
+			faulted = true;
+			if (breakOnFault)
+				__debugbreak();
 			break;
 	}
-	registers.pc++;
 	ticks += instr.cycles;
+
+#ifdef GB_OPCODE_PROFILER
+	opcodeProfile.record(profileIndex, ticks - startTicks);
+#endif
 }
 
-std::string Gameboy::disassembleInstruction(uint16_t address)
+Gameboy::RunResult Gameboy::step()
 {
-	uint8_t const opCode = mmu.rom()[address];
-	Instruction const instr = instructions[opCode];
+	if (mmu.watchpoints.dirty)
+		mmu.updatePageFlags();
+	uint16_t const pc = registers.pc;
+	instructionPc = pc;
+	// nothing wakes a halted cpu without an event, a step waits for one a frame at most
+	if (halted)
+		idle(ticks + cyclesPerFrame);
+	else
+		cpuStep();
+	if (faulted)
+		return RunResult::Fault;
+	RunResult result = RunResult::Completed;
+	if (mmu.pendingEvents)
+		result = handleIOEvents(pc);
+	if (ticks >= nextEventTick)
+	{
+		if (ppuMode == PpuMode::fifo)
+			handleTimedEvents<PpuMode::fifo>();
+		else
+			handleTimedEvents<PpuMode::scanline>();
+	}
+	return result;
+}
+
+Gameboy::RunResult Gameboy::run(uint64_t targetTick)
+{
+	// the breakpoint test only exists in the loop while one is armed, the first instruction
+	// always runs so continuing from a breakpoint doesn't stop on it again
+	if (mmu.watchpoints.dirty)
+		mmu.updatePageFlags();
+	if (ppuMode == PpuMode::fifo)
+		return breakpoints.armed() ? runLoop<true, PpuMode::fifo>(targetTick) : runLoop<false, PpuMode::fifo>(targetTick);
+	return breakpoints.armed() ? runLoop<true, PpuMode::scanline>(targetTick) : runLoop<false, PpuMode::scanline>(targetTick);
+}
 
-	if (instr.len > 1)
+// detaches what a replay must not feed or change for as long as it's alive, the profiles included
+// since a rewind runs the same instructions again
+class ReplayScope
+{
+	public:
+
+	explicit ReplayScope(Gameboy& gb) : gb(gb),
+		trace(std::exchange(gb.cpuTrace, nullptr)),
+		serialOut(std::exchange(gb.onSerialOut, nullptr)),
+		watchpoint(std::exchange(gb.onWatchpoint, nullptr)),
+		lastWatchHit(gb.lastWatchHit),
+		breakOnHit(std::exchange(gb.mmu.watchpoints.breakOnHit, false)),
+		countHits(std::exchange(gb.mmu.watchpoints.countHits, false)),
+		countBreakpointHits(std::exchange(gb.breakpoints.countHits, false)),
+#ifdef GB_OPCODE_PROFILER
+		recordOpcodes(std::exchange(gb.opcodeProfile.recording, false)),
+#endif
+		recording(std::exchange(gb.callStack.recording, false))
 	{
-		char buffer[30];
-		if (instr.len == 2)
-			snprintf(buffer, sizeof(buffer), instr.name, mmu.readByte(address + 1));
+		if (gb.mmu.watchpoints.dirty)
+			gb.mmu.updatePageFlags();
+		// a sample left pending just raises an event that finds nothing to do
+		gb.pcSampler.nextSampleTick = UINT64_MAX;
+	}
+
+	~ReplayScope()
+	{
+		gb.cpuTrace = trace;
+		gb.onSerialOut = std::move(serialOut);
+		gb.onWatchpoint = std::move(watchpoint);
+		gb.lastWatchHit = lastWatchHit;
+		gb.mmu.watchpoints.breakOnHit = breakOnHit;
+		gb.mmu.watchpoints.countHits = countHits;
+		gb.breakpoints.countHits = countBreakpointHits;
+#ifdef GB_OPCODE_PROFILER
+		gb.opcodeProfile.recording = recordOpcodes;
+#endif
+		gb.callStack.recording = recording;
+		if (gb.pcSampler.interval > 0)
+		{
+			gb.pcSampler.nextSampleTick = gb.ticks + gb.pcSampler.interval;
+			gb.nextEventTick = std::min(gb.nextEventTick, gb.pcSampler.nextSampleTick);
+		}
+	}
+
+	ReplayScope(ReplayScope const&) = delete;
+	ReplayScope& operator=(ReplayScope const&) = delete;
+
+	private:
+
+	Gameboy& gb;
+	CpuTraceWriter* const trace;
+	std::function<void(uint8_t)> serialOut;
+	std::function<void(Watchpoints::Hit const&)> watchpoint;
+	Watchpoints::Hit const lastWatchHit;
+	bool const breakOnHit;
+	bool const countHits;
+	bool const countBreakpointHits;
+#ifdef GB_OPCODE_PROFILER
+	bool const recordOpcodes;
+#endif
+	bool const recording;
+};
+
+Gameboy::RunResult Gameboy::replay(uint64_t targetTick, bool checkBreakpoints)
+{
+	ReplayScope const scope(*this);
+	bool const stopOnBreakpoints = checkBreakpoints && breakpoints.armed();
+	if (ppuMode == PpuMode::fifo)
+		return stopOnBreakpoints ? runLoop<true, PpuMode::fifo>(targetTick) : runLoop<false, PpuMode::fifo>(targetTick);
+	return stopOnBreakpoints ? runLoop<true, PpuMode::scanline>(targetTick) : runLoop<false, PpuMode::scanline>(targetTick);
+}
+
+Gameboy::RunResult Gameboy::replayStep()
+{
+	ReplayScope const scope(*this);
+	return step();
+}
+
+template<bool checkBreakpoints, PpuMode mode>
+Gameboy::RunResult Gameboy::runLoop(uint64_t targetTick)
+{
+	while (ticks < targetTick)
+	{
+		uint16_t const pc = registers.pc;
+		if constexpr (mode == PpuMode::fifo)
+			instructionPc = pc;
+		if (halted) [[unlikely]]
+			idle(targetTick);
 		else
-			snprintf(buffer, sizeof(buffer), instr.name, mmu.readShort(address + 1));
-		return std::string(buffer);
+			cpuStep();
+		if (faulted) [[unlikely]]
+			return RunResult::Fault;
+		if (mmu.pendingEvents) [[unlikely]]
+		{
+			RunResult const result = handleIOEvents(pc);
+			if (result != RunResult::Completed)
+				return result;
+		}
+
+		if (ticks >= nextEventTick) [[unlikely]]
+		{
+			RunResult const result = handleTimedEvents<mode>();
+			if (result != RunResult::Completed)
+				return result;
+		}
+
+		if constexpr (checkBreakpoints)
+		{
+			if (!halted && breakpoints.hit(mmu.bankOf(registers.pc), registers.pc, registers, mmu))
+				return RunResult::Breakpoint;
+		}
 	}
-	
-	return instr.name;
+	return RunResult::Completed;
+}
+
+Gameboy::RunResult Gameboy::runFrame()
+{
+	return run(ticks - ticks % cyclesPerFrame + cyclesPerFrame);
+}
+
+void Gameboy::setPcSampling(uint32_t interval)
+{
+	if (interval > 0)
+		pcSampler.enable(interval, ticks);
+	else
+		pcSampler.disable();
+	scheduleNextEvent();
+}
+
+void Gameboy::setCheats(Cheats const* cheats)
+{
+	mmu.setCheats(cheats);
+	scheduleNextEvent();
+}
+
+Gameboy::RunResult Gameboy::handleIOEvents(uint16_t instructionPc)
+{
+	if (mmu.pendingEvents & MMU::serialControlEvent)
+	{
+		uint8_t const sc = mmu.memMap[MMU::scAddress];
+		if ((sc & Serial::transferStart) && (sc & Serial::internalClock))
+		{
+			serial.active = true;
+			serial.endTick = ticks + Serial::transferCycles;
+			scheduleNextEvent();
+		}
+	}
+
+	if (mmu.pendingEvents & MMU::lcdControlEvent)
+	{
+		ppu.lcdControlWritten(mmu, ticks);
+		scheduleNextEvent();
+	}
+
+	RunResult result = RunResult::Completed;
+	if (mmu.pendingEvents & MMU::watchpointEvent)
+	{
+		for (Watchpoints::Hit& hit : mmu.watchpoints.pending)
+		{
+			hit.pc = instructionPc;
+			if (onWatchpoint)
+				onWatchpoint(hit);
+		}
+		lastWatchHit = mmu.watchpoints.pending.back();
+		mmu.watchpoints.pending.clear();
+		if (mmu.watchpoints.breakOnHit)
+			result = RunResult::Watchpoint;
+	}
+	mmu.pendingEvents = 0;
+	return result;
+}
+
+template<PpuMode mode>
+Gameboy::RunResult Gameboy::handleTimedEvents()
+{
+	if (ticks >= pcSampler.nextSampleTick)
+		pcSampler.sample(mmu.bankedAddress(registers.pc), ticks);
+
+	if (ticks >= ppu.nextTick())
+		ppu.advance<mode>(mmu, ticks);
+
+	// on tick boundaries rather than host frames so replays write at the same points
+	if (ticks >= cheatTick)
+	{
+		mmu.cheats->applyRamWrites(mmu.memMap);
+		// written around the mmu, oam may have changed
+		mmu.oamWrites = MMU::allOamEntries;
+	}
+
+	RunResult result = RunResult::Completed;
+	if (serial.active && ticks >= serial.endTick)
+	{
+		if (linked)
+			result = RunResult::SerialTransfer;
+		else
+			completeSerialTransfer(Serial::disconnectedByte);
+	}
+
+	if (halted && (mmu.memMap[MMU::ieAddress] & mmu.memMap[MMU::ifAddress] & MMU::interruptMask))
+		halted = false;
+
+	scheduleNextEvent();
+	return result;
+}
+
+void Gameboy::idle(uint64_t targetTick)
+{
+	// the halt loop takes 4 cycles a turn, an event between turns is seen at the next one
+	uint64_t const wakeTick = std::min(nextEventTick, targetTick);
+	uint64_t const wait = wakeTick > ticks ? wakeTick - ticks : 0;
+	ticks += std::max<uint64_t>(4, (wait + 3) & ~uint64_t(3));
+}
+
+void Gameboy::scheduleNextEvent()
+{
+	nextEventTick = pcSampler.nextSampleTick;
+	cheatTick = mmu.cheats != nullptr && mmu.cheats->hasRamWrites() ? ticks - ticks % cyclesPerFrame + cyclesPerFrame : UINT64_MAX;
+	nextEventTick = std::min({ nextEventTick, cheatTick, ppu.nextTick() });
+	if (serial.active)
+		nextEventTick = std::min(nextEventTick, serial.endTick);
+}
+
+void Gameboy::completeSerialTransfer(uint8_t incoming)
+{
+	if (onSerialOut)
+		onSerialOut(mmu.memMap[MMU::sbAddress]);
+	serial.active = false;
+	mmu.memMap[MMU::sbAddress] = incoming;
+	// an external clock slave that hasn't armed SC still shifts but doesn't get an interrupt
+	if (mmu.memMap[MMU::scAddress] & Serial::transferStart)
+	{
+		mmu.memMap[MMU::scAddress] &= ~Serial::transferStart;
+		mmu.memMap[MMU::ifAddress] |= Serial::interruptFlag;
+	}
+}
+
+void Gameboy::saveState(GameboyState& state) const
+{
+	state.registers = registers;
+	memcpy(state.memMap, mmu.memMap, sizeof(state.memMap));
+	state.buttons = mmu.buttons;
+	state.serial = serial;
+	state.ticks = ticks;
+	state.callFrames = callStack.stack();
+	state.ppu = ppu.state();
+	state.halted = halted;
+}
+
+void Gameboy::loadState(GameboyState const& state)
+{
+	registers = state.registers;
+	memcpy(mmu.memMap, state.memMap, sizeof(mmu.memMap));
+	mmu.oamWrites = MMU::allOamEntries;
+	mmu.buttons = state.buttons;
+	mmu.pendingEvents = 0;
+	mmu.watchpoints.pending.clear();
+	serial = state.serial;
+	ticks = state.ticks;
+	callStack.restore(state.callFrames);
+	ppu.restore(state.ppu);
+	halted = state.halted;
+	if (pcSampler.interval > 0)
+		pcSampler.nextSampleTick = ticks + pcSampler.interval;
+	scheduleNextEvent();
+}
+
+std::string Gameboy::disassembleInstruction(uint16_t address)
+{
+	char buffer[32];
+	formatInstruction(mmu.memMap, address, buffer, sizeof(buffer));
+	return buffer;
 }
@@ -1,19 +1,120 @@
 #pragma once
 
 #include <string>
+#include <filesystem>
+#include <functional>
 
 #include "cpu.hpp"
 #include "memory.hpp"
+#include "serial.hpp"
+#include "profiler.hpp"
+#include "breakpoints.hpp"
+#include "callstack.hpp"
+#include "ppu.hpp"
+
+class CpuTraceWriter;
+
+// everything needed to restore a console to an earlier point, used by rollback
+struct GameboyState
+{
+	Registers registers;
+	uint8_t memMap[sizeof(MMU::memMap)];
+	uint8_t buttons;
+	Serial serial;
+	uint64_t ticks;
+	std::vector<CallStack::Frame> callFrames;
+	Ppu::Timing ppu;
+	bool halted;
+};
 
 struct Gameboy
 {
+	static uint32_t constexpr cyclesPerFrame = 70224;
+
+	enum class RunResult
+	{
+		Completed,
+		SerialTransfer, // only returned when linked, the cable has to exchange SB before resuming
+		Fault, // hit an instruction that isn't implemented
+		Breakpoint, // stopped before the instruction at pc
+		Watchpoint, // stopped after the instruction that hit lastWatchHit
+	};
+
+	explicit Gameboy(PpuMode ppuMode = PpuMode::scanline);
+	// the fifo mode hands the mmu a hook to this
+	Gameboy(Gameboy const&) = delete;
+	Gameboy& operator=(Gameboy const&) = delete;
+
 	void loadCardridge(uint8_t* data, size_t size);
+	bool loadCardridge(std::filesystem::path const& romPath);
 	void start();
 
 	void cpuStep();
+	// one instruction with the io events it raised handled, what the debugger steps with
+	RunResult step();
+	RunResult run(uint64_t targetTick);
+	// re-execution from a restored state, only stops on breakpoints when asked to and leaves the
+	// trace, serial and watchpoint observers, the breakpoint and watchpoint hit counts, the pc
+	// samples and the opcode and call profiles alone
+	RunResult replay(uint64_t targetTick, bool checkBreakpoints);
+	// what step() is to run(), a halted cpu idles to the next event
+	RunResult replayStep();
+	RunResult runFrame();
+	void completeSerialTransfer(uint8_t incoming);
+
+	// samples pc every interval cycles, 0 turns sampling off
+	void setPcSampling(uint32_t interval);
+	// null turns cheats off, set again after the list changed so the page flags follow
+	void setCheats(Cheats const* cheats);
+
+	void saveState(GameboyState& state) const;
+	void loadState(GameboyState const& state);
+
 	std::string disassembleInstruction(uint16_t address);
 	
-	Registers registers;
+	Registers registers = {};
 	MMU mmu;
+	Serial serial;
+	Ppu ppu;
+	PpuMode const ppuMode;
 	uint64_t ticks = 0;
+	bool linked = false;
+	bool faulted = false;
+	// set by HALT, the cpu idles until an event raises an interrupt enabled in IE
+	bool halted = false;
+	// batch runs turn this off to report the fault instead of stopping the process
+	bool breakOnFault = true;
+	// receives the byte shifted out by every transfer
+	std::function<void(uint8_t)> onSerialOut;
+#ifdef GB_OPCODE_PROFILER
+	OpcodeProfile opcodeProfile;
+#endif
+	PcSampler pcSampler;
+	Breakpoints breakpoints;
+	CallStack callStack;
+	// records the state before every instruction when set
+	CpuTraceWriter* cpuTrace = nullptr;
+	// receives every watchpoint hit, whether it stops the run or not
+	std::function<void(Watchpoints::Hit const&)> onWatchpoint;
+	Watchpoints::Hit lastWatchHit = {};
+
+	private:
+
+	// the ppu mode is a template parameter so the scanline loop has nothing of the fifo one
+	template<bool checkBreakpoints, PpuMode mode>
+	RunResult runLoop(uint64_t targetTick);
+	RunResult handleIOEvents(uint16_t instructionPc);
+	template<PpuMode mode>
+	RunResult handleTimedEvents();
+	void scheduleNextEvent();
+	friend class ReplayScope;
+	// skips the halted cpu to the next event, or to targetTick if that comes first
+	void idle(uint64_t targetTick);
+
+	// earliest tick something other than the cpu has to run, checked once per instruction
+	uint64_t nextEventTick = UINT64_MAX;
+	// next frame boundary GameShark codes are applied on
+	uint64_t cheatTick = UINT64_MAX;
+	// the instruction executing, only kept by the fifo mode to time video register writes
+	uint16_t instructionPc = 0;
 };
@@ -0,0 +1,747 @@
+#include "headless.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "conformance.hpp"
+#include "codemap.hpp"
+#include "cputrace.hpp"
+#include "disassembly.hpp"
+#include "gameboy.hpp"
+#include "link.hpp"
+#include "netplay.hpp"
+#include "opcodetests.hpp"
+#include "symbols.hpp"
+#include "tiles.hpp"
+#include "tracing.hpp"
+#include "upscale.hpp"
+
+struct HeadlessOptions
+{
+	enum class Netplay { None, Host, Join };
+
+	std::filesystem::path romPath;
+	std::filesystem::path linkRomPath;
+	std::filesystem::path serialLogPath;
+	std::filesystem::path conformancePath;
+	std::filesystem::path opcodeTestsPath;
+	std::filesystem::path opcodeProfilePath;
+	std::filesystem::path pcProfilePath;
+	std::filesystem::path callProfilePath;
+	std::filesystem::path cdlPath;
+	std::filesystem::path tracePath;
+	std::filesystem::path cpuTracePath;
+	std::filesystem::path doctorTracePath;
+	std::filesystem::path diffTracePaths[2];
+	std::filesystem::path outputPath;
+	std::filesystem::path listingPath;
+	std::filesystem::path symbolsPath;
+	std::vector<std::string> breakpoints;
+	std::vector<std::string> watchpoints;
+	bool watchLog = false;
+	std::vector<std::string> cheats;
+	uint32_t sampleInterval = 64;
+	bool verbose = false;
+	bool benchTiles = false;
+	bool benchUpscale = false;
+	PpuMode ppuMode = PpuMode::scanline;
+	bool render = true;
+	uint32_t frameskip = 0;
+	// runs the rom again with the fifo ppu after the scanline one
+	bool comparePpuModes = false;
+	uint64_t timeoutCycles = conformance::defaultTimeoutCycles;
+	unsigned jobs = std::thread::hardware_concurrency();
+	uint32_t frames = 600;
+	Netplay netplay = Netplay::None;
+	uint16_t port = NetplaySession::defaultPort;
+	bool randomInput = false;
+	uint32_t inputSeed = 0;
+};
+
+static void printUsage()
+{
+	fprintf(stderr,
+		"usage: gb-emulator --headless <rom> [options]\n"
+		"       gb-emulator --headless --conformance <dir|list> [--timeout-cycles <n>] [--jobs <n>]\n"
+		"       gb-emulator --headless --sm83-tests <dir> [--jobs <n>] [--verbose]\n"
+		"       gb-emulator --headless --trace-doctor <trace> [--output <txt>]\n"
+		"       gb-emulator --headless --trace-diff <trace|log> <trace|log>\n"
+		"       gb-emulator --headless --bench-tiles\n"
+		"       gb-emulator --headless --bench-upscale\n"
+		"  --frames <n>           number of frames to run (default 600)\n"
+		"  --link <rom>           cartridge of the second console on the link cable\n"
+		"  --serial-log <file>    write every byte exchanged over the link cable\n"
+		"  --netplay-host <port>  play the first console, wait for a peer on localhost\n"
+		"  --netplay-join <port>  play the second console, connect to a localhost host\n"
+		"  --input-seed <n>       feed pseudo random joypad input derived from the seed\n"
+		"  --ppu <mode>           scanline (default), fifo for mid-line effects, or both to compare their fps\n"
+		"  --no-render            keep the ppu timing but draw nothing\n"
+		"  --frameskip <n>        draw one frame out of n + 1\n"
+		"  --opcode-profile <csv> export executions and cycles per opcode (GB_OPCODE_PROFILER builds)\n"
+		"  --pc-profile <file>    sample pc and write the hottest routines and addresses\n"
+		"  --call-profile <file>  write cycles per call path as folded stacks for flame graphs\n"
+		"  --cdl <file>           log executed and read rom bytes, merged into the file when it exists\n"
+		"  --sample-interval <n>  cycles between two pc samples (default 64)\n"
+		"  --trace <json>         write a chrome trace of the run (GB_TRACING builds)\n"
+		"  --cpu-trace <file>     record the state before every instruction as a binary trace\n"
+		"  --trace-doctor <file>  convert a binary trace to a Gameboy Doctor log\n"
+		"  --output <file>        where --trace-doctor writes, stdout by default\n"
+		"  --trace-diff <a> <b>   report the first instruction two traces or doctor logs disagree on\n"
+		"  --break <addr[,cond]>  stop the first console before addr, e.g. 0x0150 or 0x0150,A==0x3C&&[HL]>5\n"
+		"  --watch <range[,rwc]>  stop the first console after an access, e.g. C000-C0FF,w or FF40,c\n"
+		"  --watch-log            print every watchpoint hit instead of stopping\n"
+		"  --cheat <code>         apply a GameShark (01FF16D0) or Game Genie (00A-17B-C49) code\n"
+		"  --symbols <sym>        label addresses in reports, defaults to the .sym next to the rom\n"
+		"  --disassemble <asm>    write the rom listing, code and data told apart, instead of running\n"
+		"  --conformance <path>   run every test rom of a directory or list file in parallel\n"
+		"  --timeout-cycles <n>   emulated cycles before a test rom times out\n"
+		"  --jobs <n>             test roms running at the same time (default: core count)\n"
+		"  --sm83-tests <dir>     check every opcode against the SM83 single step json vectors\n"
+		"  --verbose              also list what passed\n");
+}
+
+static bool parseOptions(int argc, char* argv[], HeadlessOptions& options)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		std::string_view const arg = argv[i];
+		bool const hasValue = i + 1 < argc;
+		if (!arg.starts_with("--") && options.romPath.empty())
+			options.romPath = argv[i];
+		else if (arg == "--frames" && hasValue)
+			options.frames = std::stoul(argv[++i]);
+		else if (arg == "--link" && hasValue)
+			options.linkRomPath = argv[++i];
+		else if (arg == "--serial-log" && hasValue)
+			options.serialLogPath = argv[++i];
+		else if (arg == "--netplay-host" && hasValue)
+		{
+			options.netplay = HeadlessOptions::Netplay::Host;
+			options.port = static_cast<uint16_t>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--netplay-join" && hasValue)
+		{
+			options.netplay = HeadlessOptions::Netplay::Join;
+			options.port = static_cast<uint16_t>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--input-seed" && hasValue)
+		{
+			options.randomInput = true;
+			options.inputSeed = std::stoul(argv[++i]);
+		}
+		else if (arg == "--conformance" && hasValue)
+			options.conformancePath = argv[++i];
+		else if (arg == "--timeout-cycles" && hasValue)
+			options.timeoutCycles = std::stoull(argv[++i]);
+		else if (arg == "--opcode-profile" && hasValue)
+			options.opcodeProfilePath = argv[++i];
+		else if (arg == "--pc-profile" && hasValue)
+			options.pcProfilePath = argv[++i];
+		else if (arg == "--call-profile" && hasValue)
+			options.callProfilePath = argv[++i];
+		else if (arg == "--cdl" && hasValue)
+			options.cdlPath = argv[++i];
+		else if (arg == "--sample-interval" && hasValue)
+			options.sampleInterval = std::max(1ul, std::stoul(argv[++i]));
+		else if (arg == "--trace" && hasValue)
+			options.tracePath = argv[++i];
+		else if (arg == "--cpu-trace" && hasValue)
+			options.cpuTracePath = argv[++i];
+		else if (arg == "--trace-doctor" && hasValue)
+			options.doctorTracePath = argv[++i];
+		else if (arg == "--output" && hasValue)
+			options.outputPath = argv[++i];
+		else if (arg == "--trace-diff" && i + 2 < argc)
+		{
+			options.diffTracePaths[0] = argv[++i];
+			options.diffTracePaths[1] = argv[++i];
+		}
+		else if (arg == "--break" && hasValue)
+			options.breakpoints.push_back(argv[++i]);
+		else if (arg == "--watch" && hasValue)
+			options.watchpoints.push_back(argv[++i]);
+		else if (arg == "--watch-log")
+			options.watchLog = true;
+		else if (arg == "--cheat" && hasValue)
+			options.cheats.push_back(argv[++i]);
+		else if (arg == "--symbols" && hasValue)
+			options.symbolsPath = argv[++i];
+		else if (arg == "--disassemble" && hasValue)
+			options.listingPath = argv[++i];
+		else if (arg == "--sm83-tests" && hasValue)
+			options.opcodeTestsPath = argv[++i];
+		else if (arg == "--verbose")
+			options.verbose = true;
+		else if (arg == "--bench-tiles")
+			options.benchTiles = true;
+		else if (arg == "--bench-upscale")
+			options.benchUpscale = true;
+		else if (arg == "--no-render")
+			options.render = false;
+		else if (arg == "--frameskip" && hasValue)
+			options.frameskip = std::stoul(argv[++i]);
+		else if (arg == "--ppu" && hasValue)
+		{
+			std::string_view const mode = argv[++i];
+			if (mode != "scanline" && mode != "fifo" && mode != "both")
+			{
+				fprintf(stderr, "unknown ppu mode \"%s\"\n", argv[i]);
+				return false;
+			}
+			options.ppuMode = mode == "fifo" ? PpuMode::fifo : PpuMode::scanline;
+			options.comparePpuModes = mode == "both";
+		}
+		else if (arg == "--jobs" && hasValue)
+			options.jobs = std::stoul(argv[++i]);
+		else
+		{
+			fprintf(stderr, "unknown option \"%s\"\n", argv[i]);
+			return false;
+		}
+	}
+	return !options.romPath.empty() || !options.conformancePath.empty() || !options.opcodeTestsPath.empty()
+		|| !options.doctorTracePath.empty() || !options.diffTracePaths[0].empty() || options.benchTiles
+		|| options.benchUpscale;
+}
+
+// tile decode and palette mapping of every instruction set the cpu has, against the scalar path
+static int benchTiles()
+{
+	// a full vram of tiles, decoded and mapped a few thousand times
+	size_t constexpr rowCount = 384 * 8;
+	uint32_t constexpr iterations = 2000;
+	std::vector<uint8_t> rows(rowCount * 2);
+	uint32_t seed = 0x12345678;
+	for (uint8_t& byte : rows)
+	{
+		seed = seed * 1664525 + 1013904223;
+		byte = static_cast<uint8_t>(seed >> 24);
+	}
+
+	std::vector<uint8_t> expectedIndices(rowCount * 8);
+	std::vector<uint32_t> expectedRgba(rowCount * 8);
+	tiles::decodeRows(tiles::Isa::scalar, rows.data(), rowCount, expectedIndices.data());
+	tiles::mapPalette(tiles::Isa::scalar, expectedIndices.data(), expectedIndices.size(), 0xE4, expectedRgba.data());
+
+	std::vector<tiles::Isa> isas = { tiles::Isa::scalar };
+	if (tiles::bestIsa() != tiles::Isa::scalar)
+		isas.push_back(tiles::Isa::sse2);
+	if (tiles::bestIsa() == tiles::Isa::avx2)
+		isas.push_back(tiles::Isa::avx2);
+
+	bool allMatch = true;
+	double scalarSeconds[2] = {};
+	for (tiles::Isa const isa : isas)
+	{
+		std::vector<uint8_t> indices(rowCount * 8);
+		std::vector<uint32_t> rgba(rowCount * 8);
+		double seconds[2];
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < iterations; i++)
+			tiles::decodeRows(isa, rows.data(), rowCount, indices.data());
+		seconds[0] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < iterations; i++)
+			tiles::mapPalette(isa, indices.data(), indices.size(), 0xE4, rgba.data());
+		seconds[1] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (isa == tiles::Isa::scalar)
+			std::copy(seconds, seconds + 2, scalarSeconds);
+
+		bool const match = indices == expectedIndices && rgba == expectedRgba;
+		allMatch &= match;
+		double const pixels = static_cast<double>(rowCount) * 8 * iterations;
+		printf("%-6s decode %8.1f Mpx/s (x%.1f), palette %8.1f Mpx/s (x%.1f)%s\n", tiles::isaName(isa),
+			pixels / seconds[0] * 1e-6, scalarSeconds[0] / seconds[0], pixels / seconds[1] * 1e-6, scalarSeconds[1] / seconds[1],
+			match ? "" : ", MISMATCH");
+	}
+	return allMatch ? 0 : 1;
+}
+
+// every upscale filter on one thread without and with SSE2, then on all of them, against the scalar output
+static int benchUpscale()
+{
+	uint32_t constexpr width = Ppu::screenWidth;
+	uint32_t constexpr height = Ppu::screenHeight;
+	uint32_t constexpr iterations = 500;
+	// a screen of tiles picked from a small set like a game's, half flat, the rest diagonals,
+	// checkers and noise, worse than most games for the filters that follow edges
+	std::vector<uint32_t> source(width * height);
+	uint32_t seed = 0x12345678;
+	auto const random = [&seed]
+	{
+		seed = seed * 1664525 + 1013904223;
+		return seed >> 24;
+	};
+	uint32_t constexpr tileCount = 32;
+	std::vector<uint32_t> tileSet(tileCount * 64);
+	for (uint32_t tile = 0; tile < tileCount; tile++)
+	{
+		uint32_t const kind = tile % 8 < 4 ? 0 : tile % 8 - 3;
+		uint32_t const shades[2] = { tiles::shades[random() & 3], tiles::shades[random() & 3] };
+		for (uint32_t y = 0; y < 8; y++)
+		{
+			for (uint32_t x = 0; x < 8; x++)
+			{
+				uint32_t const noise = random();
+				bool const second = kind == 1 ? x + y < 8 : kind == 2 ? x > y : kind == 3 ? ((x ^ y) & 2) != 0 : (noise & 1) != 0;
+				tileSet[tile * 64 + y * 8 + x] = kind == 0 ? shades[0] : kind == 4 ? tiles::shades[noise & 3] : shades[second];
+			}
+		}
+	}
+	for (uint32_t tileY = 0; tileY < height; tileY += 8)
+	{
+		for (uint32_t tileX = 0; tileX < width; tileX += 8)
+		{
+			uint32_t const* const tile = tileSet.data() + random() % tileCount * 64;
+			for (uint32_t y = 0; y < 8; y++)
+				std::copy(tile + y * 8, tile + y * 8 + 8, source.begin() + (tileY + y) * width + tileX);
+		}
+	}
+
+	Upscaler single(1);
+	Upscaler threaded;
+	bool allMatch = true;
+	for (uint8_t i = static_cast<uint8_t>(upscale::Filter::nearest); i < static_cast<uint8_t>(upscale::Filter::count); i++)
+	{
+		upscale::Filter const filter = static_cast<upscale::Filter>(i);
+		uint32_t const scale = upscale::factor(filter);
+		std::vector<uint32_t> expected(source.size() * scale * scale);
+		upscale::filterRows(filter, false, source.data(), width, height, 0, height, expected.data());
+
+		// microseconds a frame
+		auto const time = [&](Upscaler& upscaler, bool vectorized, bool& match)
+		{
+			std::vector<uint32_t> output(expected.size());
+			auto const start = std::chrono::steady_clock::now();
+			for (uint32_t i = 0; i < iterations; i++)
+				upscaler.run(filter, source.data(), width, height, output.data(), vectorized);
+			double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			match &= output == expected;
+			return seconds / iterations * 1e6;
+		};
+		bool match = true;
+		double const scalar = time(single, false, match);
+		double const vectorized = time(single, true, match);
+		double const parallel = time(threaded, true, match);
+		allMatch &= match;
+		printf("%-10s %ux: scalar %7.1f us, SSE2 %7.1f us, %2u threads %7.1f us a frame%s\n", upscale::filterName(filter), scale,
+			scalar, vectorized, threaded.threadCount(), parallel, match ? "" : ", MISMATCH");
+	}
+	return allMatch ? 0 : 1;
+}
+
+// deterministic joypad mashing, holds each combination for 16 frames
+static uint8_t scriptedInput(uint32_t seed, int player, uint32_t frame)
+{
+	uint32_t x = seed * 0x9E3779B9u ^ (player + 1) * 0x85EBCA6Bu ^ (frame / 16) * 0xC2B2AE35u;
+	x ^= x >> 16;
+	x *= 0x7FEB352Du;
+	x ^= x >> 15;
+	return static_cast<uint8_t>(x);
+}
+
+static int runNetplay(HeadlessOptions const& options, Gameboy& player0, Gameboy& player1)
+{
+	NetplaySession session(player0, player1);
+	if (options.netplay == HeadlessOptions::Netplay::Host)
+		session.host(options.port);
+	else
+		session.join(options.port);
+
+	int const localPlayer = options.netplay == HeadlessOptions::Netplay::Host ? 0 : 1;
+	auto const start = std::chrono::steady_clock::now();
+	for (uint32_t frame = 0; frame < options.frames; frame++)
+		session.advanceFrame(options.randomInput ? scriptedInput(options.inputSeed, localPlayer, frame) : 0);
+	session.finish();
+	double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("netplay: %u frames in %.3f s, %u rollbacks, %u resimulated frames, %u stalls\n",
+		session.frame(), seconds, session.rollbackCount, session.resimulatedFrames, session.stalledFrames);
+	printf("netplay: checksum 0x%016llX\n", static_cast<unsigned long long>(session.checksum()));
+	return 0;
+}
+
+static int runLinked(HeadlessOptions const& options, Gameboy& a, Gameboy& b)
+{
+	LinkCable cable(a, b);
+
+	FILE* serialLog = nullptr;
+	if (!options.serialLogPath.empty())
+	{
+		serialLog = fopen(options.serialLogPath.string().c_str(), "w");
+		if (serialLog == nullptr)
+		{
+			fprintf(stderr, "error : failed to open \"%s\"\n", options.serialLogPath.string().c_str());
+			return 1;
+		}
+		cable.onTransfer = [serialLog](uint64_t tick, uint8_t fromA, uint8_t fromB)
+		{
+			fprintf(serialLog, "%llu %02X %02X\n", static_cast<unsigned long long>(tick), fromA, fromB);
+		};
+	}
+
+	auto const start = std::chrono::steady_clock::now();
+	for (uint32_t frame = 0; frame < options.frames; frame++)
+	{
+		if (options.randomInput)
+		{
+			a.mmu.buttons = scriptedInput(options.inputSeed, 0, frame);
+			b.mmu.buttons = scriptedInput(options.inputSeed, 1, frame);
+		}
+		GB_TRACE_ZONE("runFrame");
+		cable.runFrame();
+		if (a.faulted || b.faulted)
+		{
+			fprintf(stderr, "stopped at frame %u, a console hit an unimplemented instruction\n", frame);
+			break;
+		}
+	}
+	double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if (serialLog != nullptr)
+		fclose(serialLog);
+
+	printf("linked: %u frames in %.3f s, %.1f fps, %llu transfers, %llu sync points\n",
+		options.frames, seconds, options.frames / seconds,
+		static_cast<unsigned long long>(cable.transfers), static_cast<unsigned long long>(cable.syncPoints));
+	return 0;
+}
+
+static int exportTrace(HeadlessOptions const& options, int result)
+{
+	if (options.tracePath.empty())
+		return result;
+#ifdef GB_TRACING
+	if (!tracing::exportChromeTrace(options.tracePath))
+		return 1;
+#else
+	fprintf(stderr, "error : built without GB_TRACING, no trace to export\n");
+	return 1;
+#endif
+	return result;
+}
+
+// the explicit --symbols file, or the .sym rgblink wrote next to the rom
+static SymbolTable loadSymbols(HeadlessOptions const& options)
+{
+	SymbolTable symbols;
+	if (!options.symbolsPath.empty())
+		symbols.load(options.symbolsPath);
+	else if (!options.romPath.empty() && std::filesystem::exists(symbolPathFor(options.romPath)))
+		symbols.load(symbolPathFor(options.romPath));
+	return symbols;
+}
+
+static void printWatchHit(Watchpoints::Hit const& hit, uint64_t ticks)
+{
+	if (hit.kind == Watchpoints::read)
+		printf("watchpoint: read 0x%04X at pc 0x%04X, cycle %llu, 0x%02X\n", hit.address, hit.pc, static_cast<unsigned long long>(ticks), hit.oldValue);
+	else
+		printf("watchpoint: %s 0x%04X at pc 0x%04X, cycle %llu, 0x%02X -> 0x%02X\n",
+			watchKindName(hit.kind), hit.address, hit.pc, static_cast<unsigned long long>(ticks), hit.oldValue, hit.newValue);
+}
+
+static char const* ppuModeName(PpuMode mode)
+{
+	return mode == PpuMode::fifo ? "fifo" : "scanline";
+}
+
+// the frame loop alone, what the ppu modes are compared on
+static double timeFrames(HeadlessOptions const& options, Gameboy& gb)
+{
+	auto const start = std::chrono::steady_clock::now();
+	for (uint32_t frame = 0; frame < options.frames && !gb.faulted; frame++)
+	{
+		if (options.randomInput)
+			gb.mmu.buttons = scriptedInput(options.inputSeed, 0, frame);
+		gb.runFrame();
+	}
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int runSingle(HeadlessOptions const& options, Gameboy& gb)
+{
+	if (!options.pcProfilePath.empty())
+		gb.setPcSampling(options.sampleInterval);
+
+	CpuTraceWriter cpuTrace;
+	if (!options.cpuTracePath.empty())
+	{
+		if (!cpuTrace.open(options.cpuTracePath))
+			return 1;
+		gb.cpuTrace = &cpuTrace;
+	}
+
+	CodeDataLog codeDataLog(MMU::romSize);
+	if (!options.cdlPath.empty())
+	{
+		if (std::filesystem::exists(options.cdlPath) && !codeDataLog.load(options.cdlPath))
+			return 1;
+		gb.mmu.setCodeDataLog(&codeDataLog);
+	}
+
+	auto const start = std::chrono::steady_clock::now();
+	for (uint32_t frame = 0; frame < options.frames; frame++)
+	{
+		GB_TRACE_ZONE("runFrame");
+		if (options.randomInput)
+			gb.mmu.buttons = scriptedInput(options.inputSeed, 0, frame);
+		Gameboy::RunResult const result = gb.runFrame();
+		if (result == Gameboy::RunResult::Breakpoint)
+		{
+			Registers const& r = gb.registers;
+			printf("breakpoint at 0x%04X, frame %u, cycle %llu, A:%02X F:%02X B:%02X C:%02X D:%02X E:%02X H:%02X L:%02X SP:%04X\n",
+				r.pc, frame, static_cast<unsigned long long>(gb.ticks), r.a, r.f, r.b, r.c, r.d, r.e, r.h, r.l, r.sp);
+			break;
+		}
+		if (result == Gameboy::RunResult::Watchpoint)
+		{
+			printWatchHit(gb.lastWatchHit, gb.ticks);
+			break;
+		}
+		if (gb.faulted)
+		{
+			fprintf(stderr, "stopped at frame %u, hit an unimplemented instruction\n", frame);
+			break;
+		}
+	}
+	double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("%u frames (%llu cycles) in %.3f s, %.1f fps, %s ppu, %llu drawn\n",
+		options.frames, static_cast<unsigned long long>(gb.ticks), seconds, options.frames / seconds, ppuModeName(gb.ppuMode),
+		static_cast<unsigned long long>(gb.ppu.drawnFrames));
+
+	if (options.comparePpuModes)
+	{
+		// the run above had the trace, log and debugger hooks attached, both modes are timed again
+		// on consoles with none of them so the ratio only compares the ppus
+		double seconds[2] = {};
+		uint64_t ticks[2] = {};
+		for (PpuMode const mode : { PpuMode::scanline, PpuMode::fifo })
+		{
+			auto bare = std::make_unique<Gameboy>(mode);
+			bare->breakOnFault = false;
+			if (!bare->loadCardridge(options.romPath))
+				return 1;
+			bare->start();
+			bare->setCheats(gb.mmu.cheats);
+			bare->ppu.renderEnabled = gb.ppu.renderEnabled;
+			bare->ppu.frameskip = gb.ppu.frameskip;
+			size_t const index = mode == PpuMode::fifo;
+			seconds[index] = timeFrames(options, *bare);
+			ticks[index] = bare->ticks;
+		}
+		printf("%u frames (%llu cycles) in %.3f s, %.1f fps, scanline ppu without hooks\n",
+			options.frames, static_cast<unsigned long long>(ticks[0]), seconds[0], options.frames / seconds[0]);
+		printf("%u frames (%llu cycles) in %.3f s, %.1f fps, fifo ppu without hooks, %.2fx the scanline time\n",
+			options.frames, static_cast<unsigned long long>(ticks[1]), seconds[1], options.frames / seconds[1], seconds[1] / seconds[0]);
+	}
+
+	if (gb.cpuTrace != nullptr)
+	{
+		gb.cpuTrace = nullptr;
+		cpuTrace.close();
+		printf("%llu instructions traced, %.1f MB\n",
+			static_cast<unsigned long long>(cpuTrace.recorded()), cpuTrace.bytesWritten() / (1024.0 * 1024.0));
+	}
+
+	if (!options.pcProfilePath.empty())
+	{
+		SymbolTable const symbols = loadSymbols(options);
+		if (!gb.pcSampler.writeReport(options.pcProfilePath, findRoutineEntries(gb.mmu, &symbols), !symbols.empty() ? &symbols : nullptr))
+			return 1;
+	}
+
+	if (!options.cdlPath.empty())
+	{
+		gb.mmu.setCodeDataLog(nullptr);
+		CodeDataLog::Coverage const coverage = codeDataLog.coverage();
+		printf("coverage: %u code, %u data, %u dma source bytes, %.1f%% of the rom\n",
+			coverage.code, coverage.data, coverage.dma, 100.0 * coverage.touched / codeDataLog.size());
+		if (!codeDataLog.save(options.cdlPath))
+			return 1;
+	}
+
+	if (!options.callProfilePath.empty())
+	{
+		SymbolTable const symbols = loadSymbols(options);
+		if (!gb.callStack.writeFolded(options.callProfilePath, gb.ticks, !symbols.empty() ? &symbols : nullptr))
+			return 1;
+	}
+
+	if (!options.opcodeProfilePath.empty())
+	{
+#ifdef GB_OPCODE_PROFILER
+		if (!gb.opcodeProfile.writeCsv(options.opcodeProfilePath))
+			return 1;
+#else
+		fprintf(stderr, "error : built without GB_OPCODE_PROFILER, no opcode profile to export\n");
+		return 1;
+#endif
+	}
+	return 0;
+}
+
+int runHeadless(int argc, char* argv[])
+{
+	HeadlessOptions options;
+	try {
+		if (!parseOptions(argc, argv, options))
+		{
+			printUsage();
+			return 1;
+		}
+	}
+	catch (std::exception const&) {
+		printUsage();
+		return 1;
+	}
+
+	if (!options.conformancePath.empty())
+	{
+		std::vector<conformance::Rom> const roms = conformance::collectRoms(options.conformancePath, options.timeoutCycles);
+		if (roms.empty())
+		{
+			fprintf(stderr, "error : no test rom found in \"%s\"\n", options.conformancePath.string().c_str());
+			return 1;
+		}
+
+		std::vector<conformance::Report> const reports = conformance::runAll(roms, options.jobs);
+		conformance::printTable(reports);
+		bool const allPassed = std::all_of(reports.begin(), reports.end(),
+			[](conformance::Report const& report) { return report.result == conformance::Result::Passed; });
+		return exportTrace(options, allPassed ? 0 : 1);
+	}
+
+	if (options.benchTiles)
+		return benchTiles();
+	if (options.benchUpscale)
+		return benchUpscale();
+
+	if (!options.doctorTracePath.empty())
+		return cputrace::convertToDoctor(options.doctorTracePath, options.outputPath) ? 0 : 1;
+
+	if (!options.diffTracePaths[0].empty())
+	{
+		SymbolTable const symbols = loadSymbols(options);
+		return cputrace::diff(options.diffTracePaths[0], options.diffTracePaths[1], !symbols.empty() ? &symbols : nullptr) ? 0 : 1;
+	}
+
+	if (!options.opcodeTestsPath.empty())
+	{
+		std::vector<opcodetests::OpcodeReport> const reports = opcodetests::runAll(options.opcodeTestsPath, options.jobs);
+		opcodetests::printReport(reports, options.verbose);
+		bool const allPassed = std::all_of(reports.begin(), reports.end(),
+			[](opcodetests::OpcodeReport const& report) { return report.implemented && report.failed == 0; });
+		return allPassed ? 0 : 1;
+	}
+
+	// two consoles are too big for the stack once linked
+	std::unique_ptr<Gameboy> const consoles[2] = { std::make_unique<Gameboy>(options.ppuMode), std::make_unique<Gameboy>(options.ppuMode) };
+	Gameboy& gb = *consoles[0];
+	consoles[0]->breakOnFault = false;
+	consoles[1]->breakOnFault = false;
+	if (!gb.loadCardridge(options.romPath))
+		return 1;
+	if (!options.listingPath.empty())
+	{
+		CodeMap const codeMap = analyzeCode(std::vector<uint8_t>(gb.mmu.rom(), gb.mmu.rom() + MMU::romSize));
+		printf("%u instructions, %u data bytes\n", codeMap.instructionCount, codeMap.dataBytes);
+		Disassembly disassembly;
+		disassembly.setCodeMap(&codeMap);
+		disassembly.build(gb.mmu.memMap);
+		SymbolTable const symbols = loadSymbols(options);
+		return disassembly.writeListing(options.listingPath, !symbols.empty() ? &symbols : nullptr) ? 0 : 1;
+	}
+	gb.start();
+	for (std::unique_ptr<Gameboy> const& console : consoles)
+	{
+		console->ppu.renderEnabled = options.render;
+		console->ppu.frameskip = options.frameskip;
+	}
+
+	for (std::string const& breakpoint : options.breakpoints)
+	{
+		size_t const comma = breakpoint.find(',');
+		uint16_t bank = 0, address = 0;
+		std::string error;
+		if (!parseBreakpointAddress(std::string_view(breakpoint).substr(0, comma), bank, address))
+			error = "bad address";
+		else
+			gb.breakpoints.add(bank, address, comma != std::string::npos ? std::string_view(breakpoint).substr(comma + 1) : std::string_view(), error);
+		if (!error.empty())
+		{
+			fprintf(stderr, "error : breakpoint \"%s\", %s\n", breakpoint.c_str(), error.c_str());
+			return 1;
+		}
+	}
+
+	for (std::string const& watchpoint : options.watchpoints)
+	{
+		uint16_t first = 0, last = 0;
+		uint8_t kinds = 0;
+		if (!parseWatchpoint(watchpoint, first, last, kinds))
+		{
+			fprintf(stderr, "error : watchpoint \"%s\", expected a hex address or range and an optional ,rwc\n", watchpoint.c_str());
+			return 1;
+		}
+		gb.mmu.watchpoints.add(first, last, kinds);
+	}
+	if (options.watchLog)
+	{
+		gb.mmu.watchpoints.breakOnHit = false;
+		gb.onWatchpoint = [&gb](Watchpoints::Hit const& hit) { printWatchHit(hit, gb.ticks); };
+	}
+
+	Cheats cheats;
+	for (std::string const& code : options.cheats)
+	{
+		Cheats::Cheat cheat;
+		if (!parseCheat(code, cheat))
+		{
+			fprintf(stderr, "error : cheat \"%s\", expected a GameShark ram code or a Game Genie rom code\n", code.c_str());
+			return 1;
+		}
+		cheats.add(cheat);
+	}
+	if (cheats.active())
+		gb.setCheats(&cheats);
+
+	if (!options.linkRomPath.empty())
+	{
+		if (!consoles[1]->loadCardridge(options.linkRomPath))
+			return 1;
+		consoles[1]->start();
+	}
+
+	if (options.netplay != HeadlessOptions::Netplay::None)
+	{
+		if (options.linkRomPath.empty())
+		{
+			fprintf(stderr, "error : netplay needs the second console cartridge, use --link\n");
+			return 1;
+		}
+
+		try {
+			return runNetplay(options, *consoles[0], *consoles[1]);
+		}
+		catch (std::exception const& e) {
+			fprintf(stderr, "%s\n", e.what());
+			return 1;
+		}
+	}
+
+	if (!options.linkRomPath.empty())
+		return exportTrace(options, runLinked(options, *consoles[0], *consoles[1]));
+
+	return exportTrace(options, runSingle(options, gb));
+}
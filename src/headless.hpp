@@ -0,0 +1,5 @@
+#pragma once
+
+// runs the emulator without any window, used for automated and batch runs
+// gb-emulator --headless <rom> [options]
+int runHeadless(int argc, char* argv[]);
@@ -0,0 +1,62 @@
+#include "link.hpp"
+
+#include <algorithm>
+
+LinkCable::LinkCable(Gameboy& a_, Gameboy& b_) : a(a_), b(b_)
+{
+	a.linked = true;
+	b.linked = true;
+}
+
+LinkCable::~LinkCable()
+{
+	a.linked = false;
+	b.linked = false;
+}
+
+void LinkCable::run(uint64_t targetTick)
+{
+	while (a.ticks < targetTick || b.ticks < targetTick)
+	{
+		Gameboy& behind = a.ticks <= b.ticks ? a : b;
+		Gameboy& other = &behind == &a ? b : a;
+
+		// the other console can't complete a transfer before its pending one ends,
+		// or if idle before a full transfer duration from where it stopped
+		uint64_t const otherEvent = other.serial.active ? other.serial.endTick : other.ticks + Serial::transferCycles;
+		uint64_t const limit = std::min(targetTick, otherEvent);
+		syncPoints++;
+
+		Gameboy::RunResult const result = behind.run(limit);
+		if (result == Gameboy::RunResult::Fault || result == Gameboy::RunResult::Breakpoint || result == Gameboy::RunResult::Watchpoint)
+			return;
+		if (result == Gameboy::RunResult::SerialTransfer)
+		{
+			// limit guarantees the other side has nothing to exchange before this tick
+			if (other.run(behind.ticks) == Gameboy::RunResult::SerialTransfer)
+				other.serial.active = false;
+			exchange(behind, other);
+		}
+	}
+}
+
+void LinkCable::runFrame()
+{
+	uint64_t const ticks = std::min(a.ticks, b.ticks);
+	run(ticks - ticks % Gameboy::cyclesPerFrame + Gameboy::cyclesPerFrame);
+}
+
+void LinkCable::exchange(Gameboy& master, Gameboy& slave)
+{
+	uint8_t const masterOut = master.mmu.memMap[MMU::sbAddress];
+	uint8_t const slaveOut = slave.mmu.memMap[MMU::sbAddress];
+	master.completeSerialTransfer(slaveOut);
+	slave.completeSerialTransfer(masterOut);
+	transfers++;
+
+	if (onTransfer)
+	{
+		bool const masterIsA = &master == &a;
+		onTransfer(master.ticks, masterIsA ? masterOut : slaveOut, masterIsA ? slaveOut : masterOut);
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "gameboy.hpp"
+
+// Serial cable between two consoles of the same process.
+// Both consoles run in batches and only meet when a transfer completes, a batch never
+// goes further than the earliest point the other console could complete a transfer.
+class LinkCable
+{
+	public:
+
+	LinkCable(Gameboy& a, Gameboy& b);
+	~LinkCable();
+
+	void run(uint64_t targetTick);
+	void runFrame();
+
+	// called after each exchanged byte with the tick and what each side sent
+	std::function<void(uint64_t, uint8_t, uint8_t)> onTransfer;
+	uint64_t transfers = 0;
+	uint64_t syncPoints = 0;
+
+	private:
+
+	void exchange(Gameboy& master, Gameboy& slave);
+
+	Gameboy& a;
+	Gameboy& b;
+};
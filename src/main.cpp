@@ -1,9 +1,14 @@
+#include <string_view>
 #include "app.hpp"
+#include "headless.hpp"
 
 int main(int argc, char *argv[])
 {
+	if (argc > 1 && std::string_view(argv[1]) == "--headless")
+		return runHeadless(argc - 2, argv + 2);
+
 	App app;
 	app.init();
 	app.run();
     return 0;
-}
\ No newline at end of file
+}
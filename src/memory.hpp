@@ -1,14 +1,88 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <bit>
+#include <functional>
+
+#include "cdl.hpp"
+#include "cheats.hpp"
+#include "watchpoints.hpp"
 
 struct MMU
 {
 	static uint16_t constexpr romSize = 0x8000;
 	static uint16_t constexpr titleAddress = 0x0134;
+	static uint16_t constexpr ioBegin = 0xFF00;
+	static uint16_t constexpr hramBegin = 0xFF80;
+	static uint16_t constexpr joypadAddress = 0xFF00;
+	static uint16_t constexpr sbAddress = 0xFF01;
+	static uint16_t constexpr scAddress = 0xFF02;
+	static uint16_t constexpr ifAddress = 0xFF0F;
+	static uint16_t constexpr ieAddress = 0xFFFF;
+	// VBlank, STAT, timer, serial and joypad, the bits IF and IE share
+	static uint8_t constexpr interruptMask = 0x1F;
+	static uint16_t constexpr lcdcAddress = 0xFF40;
+	static uint16_t constexpr statAddress = 0xFF41;
+	static uint16_t constexpr lyAddress = 0xFF44;
+	// LCDC to WX, what the PPU reads while it draws
+	static uint16_t constexpr videoRegistersEnd = 0xFF4C;
+	static uint16_t constexpr dmaAddress = 0xFF46;
+	static uint16_t constexpr oamAddress = 0xFE00;
+	static uint16_t constexpr oamSize = 0xA0;
+	// one bit per 4 byte oam entry
+	static uint64_t constexpr allOamEntries = (uint64_t(1) << (oamSize / 4)) - 1;
+	// rom bank 0 at 0x0000, switchable bank at 0x4000
+	static uint16_t constexpr romBankSize = 0x4000;
+	// range of bankedAddress(), every rom bank and the rest of the address space
+	static uint32_t constexpr bankedAddressSpace = 0x10000;
+
+	// joypad buttons, a set bit means pressed
+	static uint8_t constexpr buttonRight = 1 << 0;
+	static uint8_t constexpr buttonLeft = 1 << 1;
+	static uint8_t constexpr buttonUp = 1 << 2;
+	static uint8_t constexpr buttonDown = 1 << 3;
+	static uint8_t constexpr buttonA = 1 << 4;
+	static uint8_t constexpr buttonB = 1 << 5;
+	static uint8_t constexpr buttonSelect = 1 << 6;
+	static uint8_t constexpr buttonStart = 1 << 7;
+
+	// set on io writes the Gameboy has to react to, polled after each instruction
+	static uint8_t constexpr serialControlEvent = 1 << 0;
+	static uint8_t constexpr watchpointEvent = 1 << 1;
+	static uint8_t constexpr lcdControlEvent = 1 << 2;
+
+	// page flags, accesses to a flagged page leave the direct memMap path
+	static uint8_t constexpr pageIO = 1 << 0;
+	static uint8_t constexpr pageWatchRead = 1 << 1;
+	static uint8_t constexpr pageWatchWrite = 1 << 2;
+	static uint8_t constexpr pageCodeDataLog = 1 << 3;
+	// rom pages a Game Genie code substitutes bytes in, fetches check this one too
+	static uint8_t constexpr pageRomPatch = 1 << 4;
+	// oam, the PPU indexes sprites by the lines they cover
+	static uint8_t constexpr pageOam = 1 << 5;
 
-	uint8_t memMap[0xFFFF];
+	MMU()
+	{
+		updatePageFlags();
+	}
+
+	uint8_t memMap[0x10000] = {};
+	uint8_t buttons = 0;
+	uint8_t pendingEvents = 0;
+	// one entry per 256 byte page
+	uint8_t pageFlags[0x100] = {};
+	Watchpoints watchpoints;
+	// rom byte flags of the game being logged, set through setCodeDataLog
+	CodeDataLog* codeDataLog = nullptr;
+	// enabled cheats, set through setCheats, null while there are none
+	Cheats const* cheats = nullptr;
+	// entries whose Y or X changed since the PPU last indexed them
+	uint64_t oamWrites = allOamEntries;
+	// set by a Gameboy drawing with the pixel fifo, catches the PPU up before a video register changes
+	std::function<void()> beforeVideoWrite;
+	// plain 64 KiB of ram, no io registers, dma or watchpoints, what the cpu test vectors expect
+	bool flatBus = false;
 
 	const char* romName() const
 	{
@@ -17,24 +91,132 @@ struct MMU
 
 	void writeByte(uint16_t address, uint8_t value)
 	{
+		if (pageFlags[address >> 8]) [[unlikely]]
+		{
+			writeSlow(address, value);
+			return;
+		}
 		memMap[address] = value;
 	}
 
 	void writeShort(uint16_t address, uint16_t value)
 	{
+		if (pageFlags[address >> 8] | pageFlags[static_cast<uint16_t>(address + 1) >> 8]) [[unlikely]]
+		{
+			writeSlow(address, static_cast<uint8_t>(value));
+			writeSlow(address + 1, value >> 8);
+			return;
+		}
 		*std::bit_cast<uint16_t*>(&static_cast<uint8_t*>(memMap)[address]) = value;
 	}
-	
+
 	uint8_t readByte(uint16_t address)
 	{
+		if (pageFlags[address >> 8]) [[unlikely]]
+			return readSlow(address);
 		return memMap[address];
 	}
-	
+
 	uint16_t readShort(uint16_t address)
 	{
+		if (pageFlags[address >> 8] | pageFlags[static_cast<uint16_t>(address + 1) >> 8]) [[unlikely]]
+			return readSlow(address) | readSlow(address + 1) << 8;
 		return *std::bit_cast<uint16_t*>(&static_cast<uint8_t*>(memMap)[address]);
 	}
-	
+
+	// instruction stream reads, not data accesses for watchpoints and the code/data log
+	uint8_t fetchByte(uint16_t address) const
+	{
+		if (pageFlags[address >> 8] & pageRomPatch) [[unlikely]]
+			return cheats->patch(address, memMap[address]);
+		return memMap[address];
+	}
+
+	uint16_t fetchShort(uint16_t address) const
+	{
+		uint16_t const next = static_cast<uint16_t>(address + 1);
+		if ((pageFlags[address >> 8] | pageFlags[next >> 8]) & pageRomPatch) [[unlikely]]
+			return fetchByte(address) | fetchByte(next) << 8;
+		return memMap[address] | memMap[next] << 8;
+	}
+
+	// what a cpu read returns, without the watchpoints or the code/data log seeing it, for the debugger
+	uint8_t peekByte(uint16_t address) const
+	{
+		uint8_t value = address == joypadAddress && !flatBus ? readJoypad() : memMap[address];
+		if (pageFlags[address >> 8] & pageRomPatch)
+			value = cheats->patch(address, value);
+		return value;
+	}
+
+	uint8_t readSlow(uint16_t address)
+	{
+		uint8_t value = address == joypadAddress && !flatBus ? readJoypad() : memMap[address];
+		if (pageFlags[address >> 8] & pageRomPatch)
+			value = cheats->patch(address, value);
+		if (pageFlags[address >> 8] & pageCodeDataLog)
+			codeDataLog->logRead(address);
+		if ((pageFlags[address >> 8] & pageWatchRead) && watchpoints.onRead(address, value))
+			pendingEvents |= watchpointEvent;
+		return value;
+	}
+
+	void writeSlow(uint16_t address, uint8_t value)
+	{
+		uint8_t const oldValue = memMap[address];
+		if (address >= ioBegin && !flatBus)
+			writeIO(address, value);
+		else
+			memMap[address] = value;
+		if ((pageFlags[address >> 8] & pageOam) && address < oamAddress + oamSize && (address & 3) < 2)
+			oamWrites |= uint64_t(1) << ((address - oamAddress) / 4);
+		if ((pageFlags[address >> 8] & pageWatchWrite) && watchpoints.onWrite(address, oldValue, memMap[address]))
+			pendingEvents |= watchpointEvent;
+	}
+
+	void setCodeDataLog(CodeDataLog* log)
+	{
+		codeDataLog = log;
+		updatePageFlags();
+	}
+
+	void setCheats(Cheats const* enabled)
+	{
+		cheats = enabled;
+		updatePageFlags();
+	}
+
+	void setFlatBus(bool flat)
+	{
+		flatBus = flat;
+		updatePageFlags();
+	}
+
+	// io always takes the slow path, watched pages only while their watchpoints are enabled,
+	// rom pages while a code/data log is attached, the pages Game Genie codes patch and oam.
+	// A flat bus keeps only the io page slow so 16 bit accesses at 0xFFFF wrap around
+	void updatePageFlags()
+	{
+		if (flatBus)
+		{
+			std::fill_n(pageFlags, sizeof(pageFlags), uint8_t(0));
+			pageFlags[ioBegin >> 8] = pageIO;
+			watchpoints.dirty = false;
+			return;
+		}
+		for (uint32_t page = 0; page < 0x100; page++)
+		{
+			uint8_t const kinds = watchpoints.pageKinds(static_cast<uint8_t>(page));
+			pageFlags[page] = (page >= (ioBegin >> 8) ? pageIO : 0)
+				| (codeDataLog != nullptr && page < (romSize >> 8) ? pageCodeDataLog : 0)
+				| (cheats != nullptr && cheats->patchesPage(static_cast<uint8_t>(page)) ? pageRomPatch : 0)
+				| (page == (oamAddress >> 8) ? pageOam : 0)
+				| (kinds & Watchpoints::read ? pageWatchRead : 0)
+				| (kinds & (Watchpoints::write | Watchpoints::change) ? pageWatchWrite : 0);
+		}
+		watchpoints.dirty = false;
+	}
+
 	uint8_t* rom()
 	{
 		return memMap;
@@ -44,4 +226,66 @@ struct MMU
 	{
 		return &memMap[romSize];
 	}
-};
\ No newline at end of file
+
+	// no mbc yet, bank 1 is always the one mapped at 0x4000
+	uint16_t bankOf(uint16_t address) const
+	{
+		return bankOfBankedAddress(address);
+	}
+
+	// bank a bankedAddress() result was taken in, what symbols are looked up with
+	static uint16_t bankOfBankedAddress(uint32_t bankedAddress)
+	{
+		return bankedAddress >= romBankSize && bankedAddress < romSize ? 1 : 0;
+	}
+
+	// address that tells rom banks apart, what profilers and symbols are keyed on
+	uint32_t bankedAddress(uint16_t address) const
+	{
+		return address;
+	}
+
+	void writeIO(uint16_t address, uint8_t value)
+	{
+		// LY and the mode and coincidence bits of STAT belong to the PPU
+		if (address == lyAddress)
+			return;
+		if (address >= lcdcAddress && address < videoRegistersEnd && beforeVideoWrite)
+			beforeVideoWrite();
+		if (address == statAddress)
+		{
+			memMap[address] = 0x80 | (value & 0x78) | (memMap[address] & 0x07);
+			return;
+		}
+
+		memMap[address] = value;
+		if (address == scAddress)
+			pendingEvents |= serialControlEvent;
+		else if (address == lcdcAddress)
+			pendingEvents |= lcdControlEvent;
+		else if (address == dmaAddress)
+			oamDma(value);
+	}
+
+	// copies at once, the cpu isn't locked out of the bus for the 160 cycles it takes
+	void oamDma(uint8_t sourcePage)
+	{
+		uint16_t const source = sourcePage << 8;
+		for (uint16_t i = 0; i < oamSize; i++)
+			memMap[oamAddress + i] = memMap[static_cast<uint16_t>(source + i)];
+		oamWrites = allOamEntries;
+		if (codeDataLog != nullptr)
+			codeDataLog->logDma(source, oamSize);
+	}
+
+	uint8_t readJoypad() const
+	{
+		uint8_t const select = memMap[joypadAddress];
+		uint8_t result = 0xCF | (select & 0x30);
+		if (!(select & 0x10))
+			result &= ~(buttons & 0x0F);
+		if (!(select & 0x20))
+			result &= ~(buttons >> 4);
+		return result;
+	}
+};
@@ -0,0 +1,281 @@
+#include "netplay.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <chrono>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using SocketHandle = SOCKET;
+static void closeSocket(SocketHandle s) { closesocket(s); }
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+using SocketHandle = int;
+static void closeSocket(SocketHandle s) { close(s); }
+#endif
+
+// a send to a peer that went away raises SIGPIPE on linux, which ends the process instead of the session
+#ifdef MSG_NOSIGNAL
+static int constexpr sendFlags = MSG_NOSIGNAL;
+#else
+static int constexpr sendFlags = 0;
+#endif
+
+struct InputPacket
+{
+	uint32_t frame;
+	uint8_t buttons;
+	uint8_t padding[3];
+};
+
+static void initSockets()
+{
+#ifdef _WIN32
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+		throw std::runtime_error("failed to init winsock");
+#endif
+}
+
+static sockaddr_in loopbackAddress(uint16_t port)
+{
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	return address;
+}
+
+static void setNoDelay(SocketHandle s)
+{
+	int const enable = 1;
+	setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<char const*>(&enable), sizeof(enable));
+#ifdef SO_NOSIGPIPE
+	// macOS has no MSG_NOSIGNAL, the socket itself is told instead
+	setsockopt(s, SOL_SOCKET, SO_NOSIGPIPE, reinterpret_cast<char const*>(&enable), sizeof(enable));
+#endif
+}
+
+// returns true when data can be read, waits forever if wait is set
+static bool pollReadable(SocketHandle s, bool wait)
+{
+	fd_set readSet;
+	FD_ZERO(&readSet);
+	FD_SET(s, &readSet);
+	timeval timeout = {};
+	return select(static_cast<int>(s) + 1, &readSet, nullptr, nullptr, wait ? nullptr : &timeout) > 0;
+}
+
+NetplaySession::NetplaySession(Gameboy& player0, Gameboy& player1)
+	: consoles{ &player0, &player1 }, cable(player0, player1)
+{
+	snapshots.resize((maxRollbackFrames + 1) * 2);
+}
+
+NetplaySession::~NetplaySession()
+{
+	if (connection != -1)
+		closeSocket(static_cast<SocketHandle>(connection));
+}
+
+void NetplaySession::host(uint16_t port)
+{
+	initSockets();
+	localPlayer = 0;
+
+	SocketHandle const listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	int const reuse = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<char const*>(&reuse), sizeof(reuse));
+	sockaddr_in const address = loopbackAddress(port);
+	if (bind(listener, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) != 0 || listen(listener, 1) != 0)
+	{
+		closeSocket(listener);
+		throw std::runtime_error("netplay: failed to listen on port");
+	}
+
+	printf("netplay: waiting for peer on port %u\n", port);
+	SocketHandle const peer = accept(listener, nullptr, nullptr);
+	closeSocket(listener);
+	if (peer == static_cast<SocketHandle>(-1))
+		throw std::runtime_error("netplay: failed to accept peer");
+
+	setNoDelay(peer);
+	connection = static_cast<intptr_t>(peer);
+	baseTick = consoles[0]->ticks;
+}
+
+void NetplaySession::join(uint16_t port)
+{
+	initSockets();
+	localPlayer = 1;
+
+	// the host may not be listening yet when both peers are started together
+	sockaddr_in const address = loopbackAddress(port);
+	for (int attempt = 0; attempt < 100; attempt++)
+	{
+		SocketHandle const s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (connect(s, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) == 0)
+		{
+			setNoDelay(s);
+			connection = static_cast<intptr_t>(s);
+			baseTick = consoles[0]->ticks;
+			return;
+		}
+		closeSocket(s);
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+	throw std::runtime_error("netplay: failed to connect to host");
+}
+
+void NetplaySession::advanceFrame(uint8_t localButtons)
+{
+	receiveInputs(false);
+
+	// we can't predict further than what the snapshot ring can undo
+	if (currentFrame >= remoteConfirmed + maxRollbackFrames)
+	{
+		stalledFrames++;
+		while (currentFrame >= remoteConfirmed + maxRollbackFrames)
+			receiveInputs(true);
+	}
+
+	if (firstMispredicted < currentFrame)
+		rollback();
+
+	setInput(localPlayer, currentFrame, localButtons);
+	sendInput(currentFrame, localButtons);
+	simulateFrame(currentFrame);
+	currentFrame++;
+}
+
+void NetplaySession::finish()
+{
+	while (remoteConfirmed < currentFrame)
+		receiveInputs(true);
+
+	if (firstMispredicted < currentFrame)
+		rollback();
+}
+
+uint64_t NetplaySession::checksum() const
+{
+	// FNV-1a over both consoles, equal on both peers once finish() returned
+	uint64_t hash = 0xCBF29CE484222325ull;
+	auto const mix = [&hash](void const* data, size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= static_cast<uint8_t const*>(data)[i];
+			hash *= 0x100000001B3ull;
+		}
+	};
+
+	for (Gameboy const* gb : consoles)
+	{
+		mix(&gb->registers, sizeof(gb->registers));
+		mix(gb->mmu.memMap, sizeof(gb->mmu.memMap));
+		mix(&gb->ticks, sizeof(gb->ticks));
+	}
+	return hash;
+}
+
+uint8_t NetplaySession::predictRemoteInput() const
+{
+	return remoteConfirmed > 0 ? inputs[remotePlayer()][remoteConfirmed - 1] : 0;
+}
+
+void NetplaySession::setInput(int player, uint32_t frame, uint8_t buttons)
+{
+	if (inputs[player].size() <= frame)
+		inputs[player].resize(frame + 1);
+	inputs[player][frame] = buttons;
+}
+
+void NetplaySession::sendInput(uint32_t frame, uint8_t buttons)
+{
+	InputPacket const packet = { frame, buttons, {} };
+	char const* data = reinterpret_cast<char const*>(&packet);
+	size_t sent = 0;
+	while (sent < sizeof(packet))
+	{
+		int const n = send(static_cast<SocketHandle>(connection), data + sent, static_cast<int>(sizeof(packet) - sent), sendFlags);
+		if (n <= 0)
+			throw std::runtime_error("netplay: peer disconnected");
+		sent += n;
+	}
+}
+
+void NetplaySession::receiveInputs(bool wait)
+{
+	SocketHandle const s = static_cast<SocketHandle>(connection);
+	if (!pollReadable(s, wait))
+		return;
+
+	char buffer[1024];
+	do
+	{
+		int const n = recv(s, buffer, sizeof(buffer), 0);
+		if (n <= 0)
+			throw std::runtime_error("netplay: peer disconnected");
+		receiveBuffer.insert(receiveBuffer.end(), buffer, buffer + n);
+	} while (pollReadable(s, false));
+
+	size_t offset = 0;
+	for (; offset + sizeof(InputPacket) <= receiveBuffer.size(); offset += sizeof(InputPacket))
+	{
+		InputPacket packet;
+		memcpy(&packet, &receiveBuffer[offset], sizeof(packet));
+
+		// tcp keeps packets ordered, frames arrive one after the other
+		if (packet.frame != remoteConfirmed)
+			throw std::runtime_error("netplay: unexpected frame from peer");
+
+		if (packet.frame < currentFrame && inputs[remotePlayer()][packet.frame] != packet.buttons)
+			firstMispredicted = std::min(firstMispredicted, packet.frame);
+
+		setInput(remotePlayer(), packet.frame, packet.buttons);
+		remoteConfirmed++;
+	}
+	receiveBuffer.erase(receiveBuffer.begin(), receiveBuffer.begin() + offset);
+}
+
+GameboyState& NetplaySession::snapshot(uint32_t frame, int player)
+{
+	return snapshots[(frame % (maxRollbackFrames + 1)) * 2 + player];
+}
+
+void NetplaySession::simulateFrame(uint32_t frame)
+{
+	consoles[0]->saveState(snapshot(frame, 0));
+	consoles[1]->saveState(snapshot(frame, 1));
+
+	if (frame >= remoteConfirmed)
+		setInput(remotePlayer(), frame, predictRemoteInput());
+
+	consoles[0]->mmu.buttons = inputs[0][frame];
+	consoles[1]->mmu.buttons = inputs[1][frame];
+	cable.run(baseTick + uint64_t(frame + 1) * Gameboy::cyclesPerFrame);
+}
+
+void NetplaySession::rollback()
+{
+	uint32_t const from = firstMispredicted;
+	firstMispredicted = UINT32_MAX;
+
+	consoles[0]->loadState(snapshot(from, 0));
+	consoles[1]->loadState(snapshot(from, 1));
+	for (uint32_t frame = from; frame < currentFrame; frame++)
+		simulateFrame(frame);
+
+	rollbackCount++;
+	resimulatedFrames += currentFrame - from;
+}
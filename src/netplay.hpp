@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+#include "gameboy.hpp"
+#include "link.hpp"
+
+// Rollback link cable play between two processes over a localhost TCP socket.
+// Each peer simulates both linked consoles so serial transfers stay deterministic,
+// only joypad inputs go over the wire. The remote input is predicted as its last known
+// value and frames are re-simulated from a snapshot when the prediction was wrong.
+class NetplaySession
+{
+	public:
+
+	static uint32_t constexpr maxRollbackFrames = 8;
+	static uint16_t constexpr defaultPort = 7777;
+
+	// player0 is the host console, player1 the joining one, both already started
+	NetplaySession(Gameboy& player0, Gameboy& player1);
+	~NetplaySession();
+
+	void host(uint16_t port);
+	void join(uint16_t port);
+
+	void advanceFrame(uint8_t localButtons);
+	// waits for the remote inputs of every simulated frame and corrects the last ones
+	void finish();
+
+	uint32_t frame() const { return currentFrame; }
+	uint64_t checksum() const;
+
+	uint32_t rollbackCount = 0;
+	uint32_t resimulatedFrames = 0;
+	uint32_t stalledFrames = 0;
+
+	private:
+
+	int remotePlayer() const { return 1 - localPlayer; }
+	uint8_t predictRemoteInput() const;
+	void setInput(int player, uint32_t frame, uint8_t buttons);
+	void sendInput(uint32_t frame, uint8_t buttons);
+	void receiveInputs(bool wait);
+	void simulateFrame(uint32_t frame);
+	void rollback();
+	GameboyState& snapshot(uint32_t frame, int player);
+
+	std::array<Gameboy*, 2> consoles;
+	LinkCable cable;
+	int localPlayer = 0;
+	intptr_t connection = -1;
+	uint64_t baseTick = 0;
+	uint32_t currentFrame = 0;
+	// number of leading frames whose remote input has been received
+	uint32_t remoteConfirmed = 0;
+	uint32_t firstMispredicted = UINT32_MAX;
+	std::vector<uint8_t> inputs[2];
+	std::vector<GameboyState> snapshots;
+	std::vector<uint8_t> receiveBuffer;
+};
@@ -0,0 +1,360 @@
+#include "opcodetests.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string_view>
+#include <thread>
+
+#include "gameboy.hpp"
+
+namespace opcodetests
+{
+
+// just enough json for the test vectors, numbers, strings, arrays, objects and null
+struct JsonValue
+{
+	enum class Type { Null, Number, String, Array, Object };
+
+	Type type = Type::Null;
+	double number = 0.0;
+	std::string string;
+	std::vector<JsonValue> array;
+	std::vector<std::pair<std::string, JsonValue>> object;
+
+	JsonValue const* find(std::string_view key) const
+	{
+		for (auto const& [name, value] : object)
+		{
+			if (name == key)
+				return &value;
+		}
+		return nullptr;
+	}
+
+	int asInt(std::string_view key) const
+	{
+		JsonValue const* value = find(key);
+		return value != nullptr ? static_cast<int>(value->number) : 0;
+	}
+};
+
+class JsonParser
+{
+	public:
+
+	explicit JsonParser(std::string_view text) : text(text) {}
+
+	JsonValue parse()
+	{
+		JsonValue value;
+		parseValue(value);
+		return value;
+	}
+
+	private:
+
+	void skipSpaces()
+	{
+		while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\n' || text[pos] == '\r' || text[pos] == '\t'))
+			pos++;
+	}
+
+	void expect(char c)
+	{
+		skipSpaces();
+		if (pos >= text.size() || text[pos] != c)
+			throw std::runtime_error("malformed json");
+		pos++;
+	}
+
+	void parseString(std::string& out)
+	{
+		expect('"');
+		while (pos < text.size() && text[pos] != '"')
+		{
+			if (text[pos] == '\\')
+				pos++;
+			out.push_back(text[pos++]);
+		}
+		pos++;
+	}
+
+	void parseValue(JsonValue& value)
+	{
+		skipSpaces();
+		if (pos >= text.size())
+			throw std::runtime_error("unexpected end of json");
+
+		char const c = text[pos];
+		if (c == '{')
+		{
+			value.type = JsonValue::Type::Object;
+			pos++;
+			skipSpaces();
+			if (text[pos] == '}')
+			{
+				pos++;
+				return;
+			}
+			do
+			{
+				auto& member = value.object.emplace_back();
+				parseString(member.first);
+				expect(':');
+				parseValue(member.second);
+				skipSpaces();
+			} while (text[pos++] == ',');
+		}
+		else if (c == '[')
+		{
+			value.type = JsonValue::Type::Array;
+			pos++;
+			skipSpaces();
+			if (text[pos] == ']')
+			{
+				pos++;
+				return;
+			}
+			do
+			{
+				parseValue(value.array.emplace_back());
+				skipSpaces();
+			} while (text[pos++] == ',');
+		}
+		else if (c == '"')
+		{
+			value.type = JsonValue::Type::String;
+			parseString(value.string);
+		}
+		else if (text.substr(pos, 4) == "null")
+		{
+			pos += 4;
+		}
+		else
+		{
+			value.type = JsonValue::Type::Number;
+			char* end = nullptr;
+			value.number = strtod(text.data() + pos, &end);
+			if (end == text.data() + pos)
+				throw std::runtime_error("malformed json number");
+			pos = end - text.data();
+		}
+	}
+
+	std::string_view text;
+	size_t pos = 0;
+};
+
+static void loadRegisters(Registers& r, JsonValue const& state)
+{
+	r.a = state.asInt("a");
+	r.b = state.asInt("b");
+	r.c = state.asInt("c");
+	r.d = state.asInt("d");
+	r.e = state.asInt("e");
+	r.f = state.asInt("f");
+	r.h = state.asInt("h");
+	r.l = state.asInt("l");
+	r.sp = state.asInt("sp");
+	r.pc = state.asInt("pc");
+}
+
+// returns an empty string when the console matches the expected state
+static std::string compareState(Gameboy& gb, JsonValue const& expected, uint64_t expectedTicks)
+{
+	char buffer[96];
+	auto const check = [&](char const* name, int got, int want) -> bool
+	{
+		if (got == want)
+			return true;
+		snprintf(buffer, sizeof(buffer), "%s expected 0x%02X got 0x%02X", name, want, got);
+		return false;
+	};
+
+	Registers const& r = gb.registers;
+	if (!check("a", r.a, expected.asInt("a")) || !check("f", r.f, expected.asInt("f"))
+		|| !check("b", r.b, expected.asInt("b")) || !check("c", r.c, expected.asInt("c"))
+		|| !check("d", r.d, expected.asInt("d")) || !check("e", r.e, expected.asInt("e"))
+		|| !check("h", r.h, expected.asInt("h")) || !check("l", r.l, expected.asInt("l"))
+		|| !check("sp", r.sp, expected.asInt("sp")) || !check("pc", r.pc, expected.asInt("pc")))
+		return buffer;
+
+	if (JsonValue const* ram = expected.find("ram"))
+	{
+		for (JsonValue const& entry : ram->array)
+		{
+			uint16_t const address = static_cast<uint16_t>(entry.array[0].number);
+			int const want = static_cast<int>(entry.array[1].number);
+			if (gb.mmu.memMap[address] != want)
+			{
+				snprintf(buffer, sizeof(buffer), "(0x%04X) expected 0x%02X got 0x%02X", address, want, gb.mmu.memMap[address]);
+				return buffer;
+			}
+		}
+	}
+
+	if (gb.ticks != expectedTicks)
+	{
+		snprintf(buffer, sizeof(buffer), "cycles expected %llu got %llu",
+			static_cast<unsigned long long>(expectedTicks), static_cast<unsigned long long>(gb.ticks));
+		return buffer;
+	}
+
+	return {};
+}
+
+static void clearRam(Gameboy& gb, JsonValue const& state)
+{
+	if (JsonValue const* ram = state.find("ram"))
+	{
+		for (JsonValue const& entry : ram->array)
+			gb.mmu.memMap[static_cast<uint16_t>(entry.array[0].number)] = 0;
+	}
+}
+
+static OpcodeReport runFile(std::filesystem::path const& path, Gameboy& gb)
+{
+	OpcodeReport report;
+	report.file = path.filename().string();
+
+	std::string const stem = path.stem().string();
+	bool const isCb = stem.starts_with("cb ");
+	uint8_t const low = static_cast<uint8_t>(std::stoul(isCb ? stem.substr(3) : stem, nullptr, 16));
+	report.opCode = isCb ? (cbPrefix << 8 | low) : low;
+
+	Instruction const& instr = isCb ? cbInstructions[low] : instructions[low];
+	report.name = instr.name;
+	report.implemented = isCb || instr.len > 0;
+	if (!report.implemented)
+		return report;
+
+	std::ifstream file(path, std::ios::binary);
+	std::stringstream content;
+	content << file.rdbuf();
+	JsonValue const vectors = JsonParser(content.str()).parse();
+
+	for (JsonValue const& vector : vectors.array)
+	{
+		JsonValue const* initial = vector.find("initial");
+		JsonValue const* final = vector.find("final");
+		JsonValue const* cycles = vector.find("cycles");
+		if (initial == nullptr || final == nullptr || cycles == nullptr)
+			continue;
+
+		// only the bytes a vector touches are set and cleared
+		loadRegisters(gb.registers, *initial);
+		if (JsonValue const* ram = initial->find("ram"))
+		{
+			for (JsonValue const& entry : ram->array)
+				gb.mmu.memMap[static_cast<uint16_t>(entry.array[0].number)] = static_cast<uint8_t>(entry.array[1].number);
+		}
+		gb.ticks = 0;
+		gb.faulted = false;
+		gb.halted = false;
+		gb.mmu.pendingEvents = 0;
+
+		gb.cpuStep();
+
+		std::string const failure = gb.faulted ? std::string("faulted") : compareState(gb, *final, cycles->array.size() * 4);
+		report.vectors++;
+		if (!failure.empty())
+		{
+			if (report.failed++ == 0)
+			{
+				JsonValue const* name = vector.find("name");
+				report.firstFailure = (name != nullptr ? name->string : report.file) + ": " + failure;
+			}
+		}
+
+		clearRam(gb, *initial);
+		clearRam(gb, *final);
+	}
+
+	return report;
+}
+
+std::vector<OpcodeReport> runAll(std::filesystem::path const& dir, unsigned threadCount)
+{
+	std::vector<std::filesystem::path> files;
+	for (auto const& entry : std::filesystem::directory_iterator(dir))
+	{
+		if (entry.is_regular_file() && entry.path().extension() == ".json")
+			files.push_back(entry.path());
+	}
+	std::sort(files.begin(), files.end());
+
+	std::vector<OpcodeReport> reports(files.size());
+	std::atomic<size_t> next = 0;
+	auto const worker = [&]()
+	{
+		auto gb = std::make_unique<Gameboy>();
+		gb->breakOnFault = false;
+		gb->mmu.setFlatBus(true);
+		for (size_t i = next++; i < files.size(); i = next++)
+		{
+			try {
+				reports[i] = runFile(files[i], *gb);
+			}
+			catch (std::exception const& e) {
+				reports[i].file = files[i].filename().string();
+				reports[i].firstFailure = e.what();
+				reports[i].failed = 1;
+			}
+		}
+	};
+
+	threadCount = std::max(1u, std::min<unsigned>(threadCount, static_cast<unsigned>(files.size())));
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < threadCount; i++)
+		threads.emplace_back(worker);
+	worker();
+	for (std::thread& thread : threads)
+		thread.join();
+
+	return reports;
+}
+
+void printReport(std::vector<OpcodeReport> const& reports, bool verbose)
+{
+	size_t passedOpcodes = 0, failedOpcodes = 0, missingOpcodes = 0;
+	size_t totalVectors = 0, failedVectors = 0;
+
+	for (OpcodeReport const& report : reports)
+	{
+		char opCode[8];
+		if (report.opCode > 0xFF)
+			snprintf(opCode, sizeof(opCode), "CB %02X", report.opCode & 0xFF);
+		else
+			snprintf(opCode, sizeof(opCode), "%02X", report.opCode);
+
+		if (!report.implemented)
+		{
+			missingOpcodes++;
+			if (verbose)
+				printf("%-6s %-18s not implemented\n", opCode, "");
+			continue;
+		}
+
+		totalVectors += report.vectors;
+		failedVectors += report.failed;
+		if (report.failed == 0)
+		{
+			passedOpcodes++;
+			if (verbose)
+				printf("%-6s %-18s %5zu/%-5zu ok\n", opCode, report.name, report.vectors, report.vectors);
+			continue;
+		}
+
+		failedOpcodes++;
+		printf("%-6s %-18s %5zu/%-5zu failed, first: %s\n", opCode, report.name, report.failed, report.vectors, report.firstFailure.c_str());
+	}
+
+	printf("%zu opcodes pass, %zu fail, %zu not implemented, %zu/%zu vectors failed\n",
+		passedOpcodes, failedOpcodes, missingOpcodes, failedVectors, totalVectors);
+}
+
+}
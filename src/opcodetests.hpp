@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Runs the SM83 single step test vectors (github.com/SingleStepTests/sm83) against the
+// instruction tables. Every vector sets registers and ram, executes one instruction and
+// compares registers, ram and the cycle count with the expected final state.
+namespace opcodetests
+{
+	struct OpcodeReport
+	{
+		std::string file;
+		uint16_t opCode = 0; // 0xCBxx for the cb table
+		char const* name = "";
+		size_t vectors = 0;
+		size_t failed = 0;
+		bool implemented = true;
+		std::string firstFailure;
+	};
+
+	// dir holds one json file per opcode, "00.json" to "ff.json" and "cb 00.json" to "cb ff.json"
+	std::vector<OpcodeReport> runAll(std::filesystem::path const& dir, unsigned threadCount);
+	void printReport(std::vector<OpcodeReport> const& reports, bool verbose);
+}
@@ -0,0 +1,528 @@
+#include "ppu.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include "memory.hpp"
+#include "tiles.hpp"
+
+namespace
+{
+	uint16_t tileAddress(uint8_t lcdc, uint8_t tile)
+	{
+		// 0x8800 addressing is signed around 0x9000
+		return lcdc & Ppu::unsignedTileData ? 0x8000 + tile * 16 : 0x9000 + static_cast<int8_t>(tile) * 16;
+	}
+
+	// one line of a 32x32 tile map, starting firstX pixels in, into screenWidth + 8 indices
+	void decodeMapLine(uint8_t const* memory, uint8_t lcdc, uint16_t map, uint8_t y, uint8_t firstX, uint8_t* indices)
+	{
+		uint32_t constexpr tileCount = Ppu::screenWidth / 8 + 1;
+		uint8_t rows[tileCount * 2];
+		uint16_t const mapRow = map + (y / 8) * 32;
+		for (uint32_t t = 0; t < tileCount; t++)
+		{
+			uint8_t const tile = memory[mapRow + ((firstX / 8 + t) & 31)];
+			uint16_t const row = tileAddress(lcdc, tile) + (y % 8) * 2;
+			rows[t * 2] = memory[row];
+			rows[t * 2 + 1] = memory[row + 1];
+		}
+		tiles::decodeRows(rows, tileCount, indices);
+	}
+
+	// the window only shows where the background does on the DMG
+	bool windowShown(uint8_t const* memory, uint8_t lcdc, uint8_t line)
+	{
+		return (lcdc & Ppu::bgEnable) && (lcdc & Ppu::windowEnable) && memory[Ppu::wyAddress] <= line
+			&& memory[Ppu::wxAddress] - 7 < static_cast<int>(Ppu::screenWidth);
+	}
+}
+
+void Ppu::reset(MMU& mmu, uint64_t ticks)
+{
+	timing = {};
+	timing.nextTick = UINT64_MAX;
+	mmu.memMap[MMU::lyAddress] = 0;
+	lcdControlWritten(mmu, ticks);
+	updateStat(mmu);
+}
+
+void Ppu::lcdControlWritten(MMU& mmu, uint64_t ticks)
+{
+	bool const on = (mmu.memMap[MMU::lcdcAddress] & lcdEnable) != 0;
+	if (on == timing.lcdOn)
+		return;
+
+	timing.lcdOn = on;
+	timing.line = 0;
+	timing.windowLine = 0;
+	timing.windowReached = on && mmu.memMap[wyAddress] == 0;
+	mmu.memMap[MMU::lyAddress] = 0;
+	if (on)
+	{
+		startFrame();
+		timing.mode = oamScan;
+		timing.nextTick = ticks + oamScanCycles;
+	}
+	else
+	{
+		// a disabled lcd shows nothing and sits in mode 0
+		timing.mode = hblank;
+		timing.nextTick = UINT64_MAX;
+		std::fill(framebuffer.begin(), framebuffer.end(), tiles::shades[0]);
+	}
+	updateStat(mmu);
+}
+
+template<>
+void Ppu::advance<PpuMode::scanline>(MMU& mmu, uint64_t ticks)
+{
+	while (ticks >= timing.nextTick)
+		nextMode<PpuMode::scanline>(mmu);
+}
+
+template<>
+void Ppu::advance<PpuMode::fifo>(MMU& mmu, uint64_t ticks)
+{
+	for (;;)
+	{
+		if (timing.mode == transfer)
+		{
+			if (!(renderEnabled && drawingFrame ? runFifo<true>(mmu, ticks) : runFifo<false>(mmu, ticks)))
+			{
+				// a dot a pixel at best, checked again then
+				timing.nextTick = timing.fifo.tick + (screenWidth - timing.fifo.x);
+				return;
+			}
+			timing.mode = hblank;
+			timing.nextTick = timing.fifo.tick + cyclesPerLine - oamScanCycles - timing.fifo.dots;
+			updateStat(mmu);
+		}
+		if (ticks < timing.nextTick)
+			return;
+		nextMode<PpuMode::fifo>(mmu);
+	}
+}
+
+template<PpuMode mode>
+void Ppu::nextMode(MMU& mmu)
+{
+	switch (timing.mode)
+	{
+		case oamScan:
+			timing.mode = transfer;
+			if constexpr (mode == PpuMode::fifo)
+			{
+				startFifo(mmu);
+				timing.nextTick += transferCycles;
+			}
+			else
+			{
+				timing.nextTick += transferCycles;
+				if (renderEnabled && drawingFrame)
+					renderLine(mmu);
+				else
+					skipLine(mmu);
+			}
+			break;
+		case transfer:
+			timing.mode = hblank;
+			timing.nextTick += cyclesPerLine - oamScanCycles - transferCycles;
+			break;
+		case hblank:
+			timing.line++;
+			if (timing.line == screenHeight)
+			{
+				timing.mode = vblank;
+				timing.nextTick += cyclesPerLine;
+				mmu.memMap[MMU::ifAddress] |= vblankInterrupt;
+				frames++;
+				if (renderEnabled && drawingFrame)
+					drawnFrames++;
+			}
+			else
+			{
+				timing.mode = oamScan;
+				timing.nextTick += oamScanCycles;
+			}
+			break;
+		case vblank:
+			if (timing.line == lineCount - 1)
+			{
+				timing.line = 0;
+				timing.windowLine = 0;
+				timing.windowReached = false;
+				timing.mode = oamScan;
+				startFrame();
+				timing.nextTick += oamScanCycles;
+			}
+			else
+			{
+				timing.line++;
+				timing.nextTick += cyclesPerLine;
+			}
+			break;
+	}
+	mmu.memMap[MMU::lyAddress] = timing.line;
+	if (timing.mode == oamScan && timing.line == mmu.memMap[wyAddress])
+		timing.windowReached = true;
+	updateStat(mmu);
+}
+
+void Ppu::startFrame()
+{
+	// a frame only draws when rendering was on from its first line, so drawnFrames are whole
+	drawingFrame = renderEnabled && skippedFrames == 0;
+	skippedFrames = skippedFrames >= frameskip ? 0 : skippedFrames + 1;
+}
+
+void Ppu::updateStat(MMU& mmu)
+{
+	uint8_t& stat = mmu.memMap[MMU::statAddress];
+	bool const coincidence = timing.line == mmu.memMap[lycAddress];
+	stat = 0x80 | (stat & 0x78) | (coincidence ? lycMatch : 0) | timing.mode;
+
+	bool const signal = (coincidence && (stat & lycInterruptSelect))
+		|| (timing.mode == hblank && (stat & hblankInterruptSelect))
+		|| (timing.mode == vblank && (stat & vblankInterruptSelect))
+		|| (timing.mode == oamScan && (stat & oamInterruptSelect));
+	if (signal && !timing.statSignal)
+		mmu.memMap[MMU::ifAddress] |= statInterrupt;
+	timing.statSignal = signal;
+}
+
+void Ppu::updateSpriteIndex(MMU& mmu, bool tall)
+{
+	uint64_t changed = mmu.oamWrites;
+	if (tall != indexedTall)
+	{
+		indexedTall = tall;
+		changed = MMU::allOamEntries;
+	}
+	mmu.oamWrites = 0;
+
+	int const height = tall ? 16 : 8;
+	for (; changed != 0; changed &= changed - 1)
+	{
+		uint32_t const sprite = std::countr_zero(changed);
+		uint64_t const bit = uint64_t(1) << sprite;
+		for (uint32_t line = spriteFirstLine[sprite]; line < spriteEndLine[sprite]; line++)
+		{
+			lineSprites[line] &= ~bit;
+			lineStale[line] = true;
+		}
+
+		// X only changes the order, the lines are stale all the same
+		int const top = mmu.memMap[MMU::oamAddress + sprite * 4] - 16;
+		spriteFirstLine[sprite] = static_cast<uint8_t>(std::clamp(top, 0, static_cast<int>(screenHeight)));
+		spriteEndLine[sprite] = static_cast<uint8_t>(std::clamp(top + height, 0, static_cast<int>(screenHeight)));
+		for (uint32_t line = spriteFirstLine[sprite]; line < spriteEndLine[sprite]; line++)
+		{
+			lineSprites[line] |= bit;
+			lineStale[line] = true;
+		}
+	}
+}
+
+void Ppu::selectSprites(MMU const& mmu, uint8_t line)
+{
+	// the first 10 sprites of oam on the line, then the smaller x wins and oam order breaks ties
+	uint8_t* const selected = lineSelection[line];
+	uint8_t count = 0;
+	for (uint64_t sprites = lineSprites[line]; sprites != 0 && count < spritesPerLine; sprites &= sprites - 1)
+		selected[count++] = static_cast<uint8_t>(std::countr_zero(sprites));
+	uint8_t const* const memory = mmu.memMap;
+	std::stable_sort(selected, selected + count,
+		[memory](uint8_t a, uint8_t b) { return memory[MMU::oamAddress + a * 4 + 1] < memory[MMU::oamAddress + b * 4 + 1]; });
+	lineSelectionCount[line] = count;
+	lineStale[line] = false;
+}
+
+void Ppu::renderLine(MMU& mmu)
+{
+	uint8_t const* memory = mmu.memMap;
+	uint8_t const lcdc = memory[MMU::lcdcAddress];
+	uint8_t const line = timing.line;
+
+	// background and window indices, sprites look at them for their priority
+	uint8_t decoded[screenWidth + 8];
+	uint8_t background[screenWidth];
+	if (lcdc & bgEnable)
+	{
+		uint8_t const scx = memory[scxAddress];
+		decodeMapLine(memory, lcdc, lcdc & bgMap ? 0x9C00 : 0x9800, static_cast<uint8_t>(memory[scyAddress] + line), scx, decoded);
+		memcpy(background, decoded + (scx & 7), screenWidth);
+
+		if (windowShown(memory, lcdc, line))
+		{
+			int const windowX = memory[wxAddress] - 7;
+			decodeMapLine(memory, lcdc, lcdc & windowMap ? 0x9C00 : 0x9800, timing.windowLine, 0, decoded);
+			int const first = std::max(windowX, 0);
+			memcpy(background + first, decoded + (first - windowX), screenWidth - first);
+			timing.windowLine++;
+		}
+	}
+	else
+		memset(background, 0, sizeof(background));
+
+	uint32_t* const pixels = &framebuffer[line * screenWidth];
+	tiles::mapPalette(background, screenWidth, memory[bgpAddress], pixels);
+
+	if (!(lcdc & spriteEnable))
+		return;
+
+	uint8_t const height = lcdc & tallSprites ? 16 : 8;
+	if (mmu.oamWrites != 0 || (height == 16) != indexedTall)
+		updateSpriteIndex(mmu, height == 16);
+	if (lineStale[line])
+		selectSprites(mmu, line);
+	uint8_t const* const selected = lineSelection[line];
+	uint32_t const selectedCount = lineSelectionCount[line];
+
+	uint8_t rows[spritesPerLine * 2];
+	for (uint32_t i = 0; i < selectedCount; i++)
+	{
+		uint8_t const* const entry = &memory[MMU::oamAddress + selected[i] * 4];
+		uint8_t row = static_cast<uint8_t>(line - (entry[0] - 16));
+		if (entry[3] & flipY)
+			row = height - 1 - row;
+		uint8_t const tile = height == 16 ? entry[2] & 0xFE : entry[2];
+		uint16_t const address = 0x8000 + tile * 16 + row * 2;
+		rows[i * 2] = memory[address];
+		rows[i * 2 + 1] = memory[address + 1];
+	}
+	uint8_t spritePixels[spritesPerLine * 8];
+	tiles::decodeRows(rows, selectedCount, spritePixels);
+
+	uint32_t palettes[2][4];
+	tiles::paletteColors(memory[obp0Address], palettes[0]);
+	tiles::paletteColors(memory[obp1Address], palettes[1]);
+
+	// a pixel belongs to the first sprite with a visible one there, even when it's behind the background
+	bool claimed[screenWidth] = {};
+	for (uint32_t i = 0; i < selectedCount; i++)
+	{
+		uint8_t const* const entry = &memory[MMU::oamAddress + selected[i] * 4];
+		uint8_t const attributes = entry[3];
+		uint32_t const* const colors = palettes[attributes & secondPalette ? 1 : 0];
+		for (int x = 0; x < 8; x++)
+		{
+			int const screenX = entry[1] - 8 + x;
+			uint8_t const index = spritePixels[i * 8 + (attributes & flipX ? 7 - x : x)];
+			if (screenX < 0 || screenX >= static_cast<int>(screenWidth) || index == 0 || claimed[screenX])
+				continue;
+			claimed[screenX] = true;
+			if (!(attributes & behindBackground) || background[screenX] == 0)
+				pixels[screenX] = colors[index];
+		}
+	}
+}
+
+void Ppu::skipLine(MMU const& mmu)
+{
+	// the window keeps counting its lines
+	if (windowShown(mmu.memMap, mmu.memMap[MMU::lcdcAddress], timing.line))
+		timing.windowLine++;
+}
+
+void Ppu::startFifo(MMU& mmu)
+{
+	Fifo& fifo = timing.fifo;
+	fifo = {};
+	fifo.tick = timing.nextTick;
+	// the first tile is fetched twice, the first time for nothing
+	fifo.stall = fetchDots;
+	fifo.discard = mmu.memMap[scxAddress] & 7;
+
+	uint8_t const lcdc = mmu.memMap[MMU::lcdcAddress];
+	if (mmu.oamWrites != 0 || ((lcdc & tallSprites) != 0) != indexedTall)
+		updateSpriteIndex(mmu, (lcdc & tallSprites) != 0);
+	if (lineStale[timing.line])
+		selectSprites(mmu, timing.line);
+	fifo.selectedCount = lineSelectionCount[timing.line];
+	std::copy_n(lineSelection[timing.line], fifo.selectedCount, fifo.selected);
+}
+
+template<bool draw>
+bool Ppu::runFifo(MMU& mmu, uint64_t ticks)
+{
+	Fifo& fifo = timing.fifo;
+	uint8_t const* const memory = mmu.memMap;
+	uint32_t* const pixels = &framebuffer[timing.line * screenWidth];
+	for (; fifo.tick < ticks; fifo.tick++)
+	{
+		if (fifo.x == screenWidth)
+			break;
+		fifo.dots++;
+		if (fifo.stall > 0)
+		{
+			fifo.stall--;
+			continue;
+		}
+
+		uint8_t const lcdc = memory[MMU::lcdcAddress];
+		// sprites are fetched when the output reaches them, the fetcher waits until it lines up with a tile
+		if (fifo.discard == 0 && fifo.nextSprite < fifo.selectedCount)
+		{
+			uint8_t const sprite = fifo.selected[fifo.nextSprite];
+			int const spriteX = memory[MMU::oamAddress + sprite * 4 + 1];
+			if (spriteX - 8 <= fifo.x)
+			{
+				fifo.nextSprite++;
+				if (lcdc & spriteEnable)
+				{
+					int const tile = (spriteX + memory[scxAddress]) / 8;
+					int const wait = tile != fifo.lastSpriteTile ? 5 - std::min(5, (spriteX + memory[scxAddress]) % 8) : 0;
+					fifo.lastSpriteTile = static_cast<int16_t>(tile);
+					if constexpr (draw)
+						fetchSprite(mmu, sprite);
+					fifo.stall = static_cast<uint8_t>(fetchDots + wait - 1);
+					continue;
+				}
+			}
+		}
+
+		// the window restarts the fetcher on its first tile
+		if (!fifo.window && (lcdc & windowEnable) && timing.windowReached && fifo.x + 7 >= memory[wxAddress])
+		{
+			fifo.window = true;
+			fifo.fetchStep = 0;
+			fifo.fetchX = 0;
+			fifo.backgroundCount = 0;
+			fifo.discard = static_cast<uint8_t>(std::max(7 - memory[wxAddress], 0));
+		}
+
+		// the tile number, then the low and high planes, two dots each
+		if (fifo.fetchStep < fetchDots)
+		{
+			if (draw && fifo.fetchStep == 0)
+			{
+				uint16_t const map = lcdc & (fifo.window ? windowMap : bgMap) ? 0x9C00 : 0x9800;
+				uint8_t const y = fifo.window ? timing.windowLine : static_cast<uint8_t>(memory[scyAddress] + timing.line);
+				uint8_t const column = fifo.window ? fifo.fetchX : static_cast<uint8_t>((memory[scxAddress] / 8 + fifo.fetchX) & 31);
+				fifo.fetchTile = memory[map + (y / 8) * 32 + column];
+			}
+			else if (draw && (fifo.fetchStep == 2 || fifo.fetchStep == 4))
+			{
+				uint8_t const y = fifo.window ? timing.windowLine : static_cast<uint8_t>(memory[scyAddress] + timing.line);
+				uint8_t const plane = memory[tileAddress(lcdc, fifo.fetchTile) + (y % 8) * 2 + fifo.fetchStep / 4];
+				(fifo.fetchStep == 2 ? fifo.fetchLow : fifo.fetchHigh) = plane;
+			}
+			fifo.fetchStep++;
+		}
+		else if (fifo.backgroundCount == 0)
+		{
+			if constexpr (draw)
+			{
+				for (int x = 0; x < 8; x++)
+					fifo.background[x] = static_cast<uint8_t>((fifo.fetchLow >> (7 - x) & 1) | (fifo.fetchHigh >> (7 - x) & 1) << 1);
+			}
+			fifo.backgroundCount = 8;
+			fifo.fetchStep = 0;
+			fifo.fetchX++;
+		}
+
+		if (fifo.backgroundCount == 0)
+			continue;
+		uint8_t const background = fifo.background[8 - fifo.backgroundCount--];
+		if (fifo.discard > 0)
+		{
+			fifo.discard--;
+			continue;
+		}
+
+		// palettes and LCDC are read as the pixel leaves, what mid-line raster effects change
+		if constexpr (draw)
+		{
+			uint8_t const index = lcdc & bgEnable ? background : 0;
+			uint8_t& sprite = fifo.sprites[fifo.x & 7];
+			uint8_t const spriteIndex = sprite & 3;
+			if (spriteIndex != 0 && (!(sprite & 8) || index == 0))
+				pixels[fifo.x] = tiles::shades[memory[sprite & 4 ? obp1Address : obp0Address] >> (spriteIndex * 2) & 3];
+			else
+				pixels[fifo.x] = tiles::shades[memory[bgpAddress] >> (index * 2) & 3];
+			sprite = 0;
+		}
+		fifo.x++;
+	}
+	if (fifo.x < screenWidth)
+		return false;
+	if (fifo.window)
+		timing.windowLine++;
+	return true;
+}
+
+void Ppu::fetchSprite(MMU const& mmu, uint8_t sprite)
+{
+	Fifo& fifo = timing.fifo;
+	uint8_t const* const entry = &mmu.memMap[MMU::oamAddress + sprite * 4];
+	uint8_t const height = indexedTall ? 16 : 8;
+	uint8_t row = static_cast<uint8_t>(timing.line - (entry[0] - 16));
+	if (entry[3] & flipY)
+		row = height - 1 - row;
+	uint8_t const tile = height == 16 ? entry[2] & 0xFE : entry[2];
+	uint16_t const address = 0x8000 + tile * 16 + row * 2;
+	uint8_t const low = mmu.memMap[address];
+	uint8_t const high = mmu.memMap[address + 1];
+
+	// sprites fetched earlier keep their opaque pixels, that's the smaller x or the lower oam index
+	int const left = entry[1] - 8;
+	for (int x = std::max(fifo.x - left, 0); x < 8; x++)
+	{
+		int const bit = entry[3] & flipX ? x : 7 - x;
+		uint8_t const index = static_cast<uint8_t>((low >> bit & 1) | (high >> bit & 1) << 1);
+		uint8_t& slot = fifo.sprites[(left + x) & 7];
+		if (index != 0 && slot == 0)
+			slot = static_cast<uint8_t>(index | (entry[3] & secondPalette ? 4 : 0) | (entry[3] & behindBackground ? 8 : 0));
+	}
+}
+
+void Ppu::drawTileSheet(MMU const& mmu, uint8_t palette, uint32_t* rgba)
+{
+	uint32_t constexpr tileCount = 384;
+	uint32_t constexpr tilesPerRow = tileSheetWidth / 8;
+	// decoded tile by tile, then laid out in rows of 16 tiles so the palette maps the sheet at once
+	uint8_t decoded[tileCount * 64];
+	uint8_t sheet[tileSheetWidth * tileSheetHeight];
+	tiles::decodeRows(&mmu.memMap[0x8000], tileCount * 8, decoded);
+	for (uint32_t tile = 0; tile < tileCount; tile++)
+	{
+		uint32_t const x = tile % tilesPerRow * 8;
+		uint32_t const y = tile / tilesPerRow * 8;
+		for (uint32_t row = 0; row < 8; row++)
+			memcpy(&sheet[(y + row) * tileSheetWidth + x], &decoded[tile * 64 + row * 8], 8);
+	}
+	tiles::mapPalette(sheet, sizeof(sheet), palette, rgba);
+}
+
+void Ppu::drawSpriteSheet(MMU const& mmu, uint32_t* rgba)
+{
+	// transparent pixels in a grey no palette has
+	uint32_t constexpr transparent = 0xFF404040;
+	std::fill(rgba, rgba + spriteSheetWidth * spriteSheetHeight, transparent);
+
+	bool const tall = (mmu.memMap[MMU::lcdcAddress] & tallSprites) != 0;
+	for (uint32_t sprite = 0; sprite < spriteCount; sprite++)
+	{
+		uint8_t const* const entry = &mmu.memMap[MMU::oamAddress + sprite * 4];
+		uint8_t const attributes = entry[3];
+		uint32_t const height = tall ? 16 : 8;
+		uint8_t indices[16 * 8];
+		tiles::decodeRows(&mmu.memMap[0x8000 + (tall ? entry[2] & 0xFE : entry[2]) * 16], height, indices);
+		uint32_t colors[4];
+		tiles::paletteColors(mmu.memMap[attributes & secondPalette ? obp1Address : obp0Address], colors);
+
+		uint32_t const cellX = sprite % 8 * 8;
+		uint32_t const cellY = sprite / 8 * 16;
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < 8; x++)
+			{
+				uint8_t const index = indices[(attributes & flipY ? height - 1 - y : y) * 8 + (attributes & flipX ? 7 - x : x)];
+				if (index != 0)
+					rgba[(cellY + y) * spriteSheetWidth + cellX + x] = colors[index];
+			}
+		}
+	}
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct MMU;
+
+// how a Gameboy draws, picked when it's constructed
+enum class PpuMode : uint8_t
+{
+	// a whole line at once, mode 3 always lasts 172 cycles
+	scanline,
+	// pixel by pixel, mid-line register writes show and mode 3 stretches with scrolling,
+	// the window and sprites
+	fifo,
+};
+
+// DMG picture processing unit, timed line by line. Mode changes are events of the Gameboy
+// scheduler, each one updates LY and STAT and raises the VBlank and STAT interrupt flags.
+// The scanline mode draws a whole line from the registers as they are when it enters mode 3,
+// the fifo mode runs mode 3 dot by dot, caught up to the cpu on video register writes and events.
+class Ppu
+{
+	public:
+
+	static uint32_t constexpr screenWidth = 160;
+	static uint32_t constexpr screenHeight = 144;
+	static uint32_t constexpr cyclesPerLine = 456;
+	static uint32_t constexpr lineCount = 154;
+	static uint32_t constexpr oamScanCycles = 80;
+	// without the sprite and fine scroll penalties
+	static uint32_t constexpr transferCycles = 172;
+	// dots the fifo fetcher takes for a tile, a sprite fetch stalls the output as long
+	static uint32_t constexpr fetchDots = 6;
+	static uint32_t constexpr spriteCount = 40;
+	static uint32_t constexpr spritesPerLine = 10;
+
+	static uint16_t constexpr scyAddress = 0xFF42;
+	static uint16_t constexpr scxAddress = 0xFF43;
+	static uint16_t constexpr lycAddress = 0xFF45;
+	static uint16_t constexpr bgpAddress = 0xFF47;
+	static uint16_t constexpr obp0Address = 0xFF48;
+	static uint16_t constexpr obp1Address = 0xFF49;
+	static uint16_t constexpr wyAddress = 0xFF4A;
+	static uint16_t constexpr wxAddress = 0xFF4B;
+
+	// LCDC bits
+	static uint8_t constexpr lcdEnable = 1 << 7;
+	static uint8_t constexpr windowMap = 1 << 6;
+	static uint8_t constexpr windowEnable = 1 << 5;
+	static uint8_t constexpr unsignedTileData = 1 << 4;
+	static uint8_t constexpr bgMap = 1 << 3;
+	static uint8_t constexpr tallSprites = 1 << 2;
+	static uint8_t constexpr spriteEnable = 1 << 1;
+	static uint8_t constexpr bgEnable = 1 << 0;
+
+	// STAT bits, the low two are the mode
+	static uint8_t constexpr lycInterruptSelect = 1 << 6;
+	static uint8_t constexpr oamInterruptSelect = 1 << 5;
+	static uint8_t constexpr vblankInterruptSelect = 1 << 4;
+	static uint8_t constexpr hblankInterruptSelect = 1 << 3;
+	static uint8_t constexpr lycMatch = 1 << 2;
+
+	// IF bits
+	static uint8_t constexpr vblankInterrupt = 1 << 0;
+	static uint8_t constexpr statInterrupt = 1 << 1;
+
+	// sprite attribute bits
+	static uint8_t constexpr behindBackground = 1 << 7;
+	static uint8_t constexpr flipY = 1 << 6;
+	static uint8_t constexpr flipX = 1 << 5;
+	static uint8_t constexpr secondPalette = 1 << 4;
+
+	enum Mode : uint8_t
+	{
+		hblank,
+		vblank,
+		oamScan,
+		transfer,
+	};
+
+	// mode 3 of the fifo mode in progress
+	struct Fifo
+	{
+		// tick of the next dot to run, and dots run since mode 3 started
+		uint64_t tick = 0;
+		uint16_t dots = 0;
+		// next screen pixel
+		uint8_t x = 0;
+		// pixels still to drop, the fine scroll or the window left of the screen
+		uint8_t discard = 0;
+		// dots the pixel output waits, the start of the line and sprite fetches
+		uint8_t stall = 0;
+		// background fetcher, ready to push once fetchStep reaches fetchDots
+		uint8_t fetchStep = 0;
+		uint8_t fetchX = 0;
+		uint8_t fetchTile = 0;
+		uint8_t fetchLow = 0;
+		uint8_t fetchHigh = 0;
+		bool window = false;
+		// background pixels pushed by the fetcher, popped from the front
+		uint8_t background[8] = {};
+		uint8_t backgroundCount = 0;
+		// sprite pixel of each screen x modulo 8, index | palette << 2 | behind << 3, 0 when transparent
+		uint8_t sprites[8] = {};
+		uint8_t selected[spritesPerLine] = {};
+		uint8_t selectedCount = 0;
+		uint8_t nextSprite = 0;
+		// tile column of the last sprite fetched, a second one in the same tile doesn't wait again
+		int16_t lastSpriteTile = -1;
+	};
+
+	// what a save state keeps, the framebuffer is drawn again by the next frame
+	struct Timing
+	{
+		uint8_t line = 0;
+		Mode mode = hblank;
+		// lines of the window drawn this frame, it doesn't move with LY
+		uint8_t windowLine = 0;
+		bool lcdOn = false;
+		// STAT interrupt sources ORed, the flag is raised when it goes up
+		bool statSignal = false;
+		// WY matched LY on a line of this frame, the fifo window starts from there
+		bool windowReached = false;
+		uint64_t nextTick = UINT64_MAX;
+		Fifo fifo;
+	};
+
+	Ppu() : framebuffer(screenWidth * screenHeight, 0) {}
+
+	// picks up LCDC as the boot rom left it
+	void reset(MMU& mmu, uint64_t ticks);
+	void lcdControlWritten(MMU& mmu, uint64_t ticks);
+
+	// runs every mode change due by ticks, and the fifo dots before it
+	template<PpuMode mode>
+	void advance(MMU& mmu, uint64_t ticks);
+
+	uint64_t nextTick() const { return timing.nextTick; }
+	Timing const& state() const { return timing; }
+	void restore(Timing const& saved) { timing = saved; }
+
+	// RGBA, screenWidth pixels a line
+	std::vector<uint32_t> framebuffer;
+	// frames completed
+	uint64_t frames = 0;
+	// frames drawn from the first line to the last, the framebuffer holds a new picture when it changes
+	uint64_t drawnFrames = 0;
+	// cleared, lines aren't drawn but LY, STAT, the interrupts and mode 3 lengths stay exact.
+	// Clearing it stops drawing at the next line, setting it again waits for the next frame
+	bool renderEnabled = true;
+	// frames left undrawn after each drawn one
+	uint32_t frameskip = 0;
+
+	// the 384 tiles of vram, 16 a row, through palette, for the tile viewer
+	static uint32_t constexpr tileSheetWidth = 128;
+	static uint32_t constexpr tileSheetHeight = 192;
+	static void drawTileSheet(MMU const& mmu, uint8_t palette, uint32_t* rgba);
+	// the 40 sprites of oam as 8x16 cells, 8 a row, with their own palette and flips
+	static uint32_t constexpr spriteSheetWidth = 64;
+	static uint32_t constexpr spriteSheetHeight = 80;
+	static void drawSpriteSheet(MMU const& mmu, uint32_t* rgba);
+
+	private:
+
+	template<PpuMode mode>
+	void nextMode(MMU& mmu);
+	void updateStat(MMU& mmu);
+	// decides whether the frame starting is drawn
+	void startFrame();
+	void renderLine(MMU& mmu);
+	// what a line that isn't drawn still changes
+	void skipLine(MMU const& mmu);
+	void startFifo(MMU& mmu);
+	// runs mode 3 dots before ticks, true once the line is done, draw leaves out fetches and pixels
+	template<bool draw>
+	bool runFifo(MMU& mmu, uint64_t ticks);
+	void fetchSprite(MMU const& mmu, uint8_t sprite);
+	// brings the lines of the sprites in mmu.oamWrites up to date
+	void updateSpriteIndex(MMU& mmu, bool tall);
+	// the sprites a line draws, in priority order
+	void selectSprites(MMU const& mmu, uint8_t line);
+
+	Timing timing;
+
+	// sprite index, rebuilt from oam writes instead of scanning oam every line
+	// screen lines each sprite covers, first to one past the last
+	uint8_t spriteFirstLine[spriteCount] = {};
+	uint8_t spriteEndLine[spriteCount] = {};
+	// one bit per sprite covering the line
+	uint64_t lineSprites[screenHeight] = {};
+	uint8_t lineSelection[screenHeight][spritesPerLine] = {};
+	uint8_t lineSelectionCount[screenHeight] = {};
+	// lines whose selection has to be made again before they're drawn
+	bool lineStale[screenHeight] = {};
+	bool indexedTall = false;
+
+	// frameskip state, not part of the timing
+	bool drawingFrame = true;
+	uint32_t skippedFrames = 0;
+};
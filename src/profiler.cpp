@@ -0,0 +1,176 @@
+#include "profiler.hpp"
+
+#include <cstdio>
+#include <algorithm>
+#include <cstring>
+
+#include "cpu.hpp"
+#include "memory.hpp"
+#include "symbols.hpp"
+
+void OpcodeProfile::reset()
+{
+	memset(executions, 0, sizeof(executions));
+	memset(cycles, 0, sizeof(cycles));
+}
+
+uint64_t OpcodeProfile::totalCycles() const
+{
+	uint64_t total = 0;
+	for (uint64_t const c : cycles)
+		total += c;
+	return total;
+}
+
+bool OpcodeProfile::writeCsv(std::filesystem::path const& path) const
+{
+	FILE* file = fopen(path.string().c_str(), "w");
+	if (file == nullptr)
+	{
+		fprintf(stderr, "error : failed to open \"%s\"\n", path.string().c_str());
+		return false;
+	}
+
+	uint64_t const total = totalCycles();
+	fprintf(file, "opcode,name,executions,cycles,cycle share\n");
+	for (uint16_t i = 0; i < opcodeCount; i++)
+	{
+		if (executions[i] == 0)
+			continue;
+		fprintf(file, "%s%02X,\"%s\",%llu,%llu,%.6f\n", i >= 256 ? "CB" : "", i & 0xFF, name(i).c_str(),
+			static_cast<unsigned long long>(executions[i]), static_cast<unsigned long long>(cycles[i]),
+			total > 0 ? static_cast<double>(cycles[i]) / total : 0.0);
+	}
+
+	fclose(file);
+	return true;
+}
+
+std::string OpcodeProfile::name(uint16_t index)
+{
+	std::string result = index < 256 ? instructions[index].name : cbInstructions[index & 0xFF].name;
+	for (auto const& [format, operand] : { std::pair{ "0x%04X", "nn" }, std::pair{ "0x%02X", "n" } })
+	{
+		size_t const pos = result.find(format);
+		if (pos != std::string::npos)
+			result.replace(pos, strlen(format), operand);
+	}
+	return result;
+}
+
+void PcSampler::enable(uint32_t sampleInterval, uint64_t ticks)
+{
+	interval = sampleInterval;
+	nextSampleTick = ticks + interval;
+	if (histogram.empty())
+		histogram.resize(MMU::bankedAddressSpace);
+}
+
+void PcSampler::disable()
+{
+	interval = 0;
+	nextSampleTick = UINT64_MAX;
+}
+
+void PcSampler::reset()
+{
+	std::fill(histogram.begin(), histogram.end(), 0);
+	total = 0;
+}
+
+std::vector<PcSampler::Routine> PcSampler::routines(std::vector<uint32_t> const& entries) const
+{
+	std::vector<Routine> result;
+	result.reserve(entries.size());
+	for (uint32_t const entry : entries)
+		result.push_back({ entry, 0 });
+
+	for (uint32_t address = 0; address < histogram.size(); address++)
+	{
+		if (histogram[address] == 0)
+			continue;
+
+		auto const it = std::upper_bound(entries.begin(), entries.end(), address);
+		if (it != entries.begin())
+			result[it - entries.begin() - 1].samples += histogram[address];
+	}
+
+	std::erase_if(result, [](Routine const& routine) { return routine.samples == 0; });
+	std::sort(result.begin(), result.end(), [](Routine const& a, Routine const& b) { return a.samples > b.samples; });
+	return result;
+}
+
+bool PcSampler::writeReport(std::filesystem::path const& path, std::vector<uint32_t> const& entries, SymbolTable const* symbols) const
+{
+	FILE* file = fopen(path.string().c_str(), "w");
+	if (file == nullptr)
+	{
+		fprintf(stderr, "error : failed to open \"%s\"\n", path.string().c_str());
+		return false;
+	}
+
+	char label[128] = "";
+	auto const symbol = [&](uint32_t bankedAddress) -> char const*
+	{
+		if (symbols != nullptr)
+			symbols->format(MMU::bankOfBankedAddress(bankedAddress), static_cast<uint16_t>(bankedAddress), label, sizeof(label));
+		return label;
+	};
+	char const* const symbolColumn = symbols != nullptr ? ",symbol" : "";
+
+	fprintf(file, "%llu samples, one every %u cycles\n\nroutine,samples,share%s\n", static_cast<unsigned long long>(total), interval, symbolColumn);
+	for (Routine const& routine : routines(entries))
+		fprintf(file, "%05X,%llu,%.6f%s%s\n", routine.entry, static_cast<unsigned long long>(routine.samples), static_cast<double>(routine.samples) / total,
+			symbols != nullptr ? "," : "", symbol(routine.entry));
+
+	fprintf(file, "\naddress,samples,share%s\n", symbolColumn);
+	std::vector<uint32_t> addresses;
+	for (uint32_t address = 0; address < histogram.size(); address++)
+	{
+		if (histogram[address] > 0)
+			addresses.push_back(address);
+	}
+	std::sort(addresses.begin(), addresses.end(), [this](uint32_t a, uint32_t b) { return histogram[a] > histogram[b]; });
+	for (uint32_t const address : addresses)
+		fprintf(file, "%05X,%u,%.6f%s%s\n", address, histogram[address], share(address), symbols != nullptr ? "," : "", symbol(address));
+
+	fclose(file);
+	return true;
+}
+
+std::vector<uint32_t> findRoutineEntries(MMU const& mmu, SymbolTable const* symbols)
+{
+	std::vector<uint32_t> entries = { 0x0000, 0x4000, 0x8000, 0xA000, 0xC000, 0xFE00, 0xFF80 };
+	if (symbols != nullptr && !symbols->empty())
+	{
+		for (SymbolTable::Symbol const& symbol : symbols->all())
+		{
+			uint16_t const address = static_cast<uint16_t>(symbol.key);
+			// local labels (Routine.loop) are inside their routine, other banks aren't mapped yet
+			if (symbols->name(symbol).find('.') == std::string_view::npos && (symbol.key >> 16) == MMU::bankOfBankedAddress(address))
+				entries.push_back(mmu.bankedAddress(address));
+		}
+	}
+	else
+	{
+		entries.push_back(0x0100);
+		for (uint16_t vector = 0x08; vector <= 0x60; vector += 8)
+			entries.push_back(vector);
+
+		for (uint32_t address = 0; address + 2 < MMU::romSize; address++)
+		{
+			uint8_t const op = mmu.memMap[address];
+			// CALL nn and CALL cc, nn
+			if (op == 0xCD || op == 0xC4 || op == 0xCC || op == 0xD4 || op == 0xDC)
+			{
+				uint16_t const target = mmu.memMap[address + 1] | mmu.memMap[address + 2] << 8;
+				if (target < MMU::romSize)
+					entries.push_back(mmu.bankedAddress(target));
+			}
+		}
+	}
+
+	std::sort(entries.begin(), entries.end());
+	entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+	return entries;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Execution count and cycles of every opcode, the 256 base ones followed by the 256 CB ones.
+// Only compiled into the cpu loop when GB_OPCODE_PROFILER is defined.
+struct OpcodeProfile
+{
+	static uint16_t constexpr opcodeCount = 512;
+
+	uint64_t executions[opcodeCount] = {};
+	uint64_t cycles[opcodeCount] = {};
+	// replays turn this off so rewinding doesn't count the same instructions again
+	bool recording = true;
+
+	void record(uint16_t index, uint64_t instrCycles)
+	{
+		if (!recording)
+			return;
+		executions[index]++;
+		cycles[index] += instrCycles;
+	}
+
+	void reset();
+	uint64_t totalCycles() const;
+	bool writeCsv(std::filesystem::path const& path) const;
+
+	// mnemonic with operands shown as n/nn instead of the disassembler format
+	static std::string name(uint16_t index);
+};
+
+struct MMU;
+class SymbolTable;
+
+// Histogram of where pc was, taken every interval emulated cycles, keyed on the banked address.
+struct PcSampler
+{
+	struct Routine
+	{
+		uint32_t entry; // banked address
+		uint64_t samples;
+	};
+
+	uint32_t interval = 0;
+	uint64_t nextSampleTick = UINT64_MAX;
+	uint64_t total = 0;
+	std::vector<uint32_t> histogram;
+
+	void enable(uint32_t sampleInterval, uint64_t ticks);
+	void disable();
+	void reset();
+
+	void sample(uint32_t bankedAddress, uint64_t ticks)
+	{
+		histogram[bankedAddress]++;
+		total++;
+		nextSampleTick = ticks + interval;
+	}
+
+	float share(uint32_t bankedAddress) const
+	{
+		return total > 0 && !histogram.empty() ? static_cast<float>(histogram[bankedAddress]) / total : 0.0f;
+	}
+
+	// every sample is charged to the closest entry point at or below its address, sorted by samples
+	std::vector<Routine> routines(std::vector<uint32_t> const& entries) const;
+	// symbols is optional, routines and addresses get a label+offset column with it
+	bool writeReport(std::filesystem::path const& path, std::vector<uint32_t> const& entries, SymbolTable const* symbols = nullptr) const;
+};
+
+// the start of every memory area so code copied to ram doesn't count as the last rom routine, and
+// the global labels when symbols has any. Without symbols the reset, rst and interrupt vectors
+// and the rom call targets stand in for them
+std::vector<uint32_t> findRoutineEntries(MMU const& mmu, SymbolTable const* symbols = nullptr);
@@ -0,0 +1,339 @@
+#include "ramsearch.hpp"
+
+#include <bit>
+#include <cstring>
+
+#include "simd.hpp"
+
+namespace
+{
+	struct Kernel
+	{
+		RamSearch::Width width;
+		RamSearch::Format format;
+		RamSearch::Compare compare;
+		uint8_t const* current;
+		uint8_t const* reference; // previous snapshot, nullptr to compare against raw
+		uint16_t raw;
+	};
+
+	bool validBcd(uint8_t value)
+	{
+		return (value & 0x0F) <= 9 && (value >> 4) <= 9;
+	}
+
+	[[maybe_unused]] void filterScalar(Kernel const& k, uint64_t* candidates)
+	{
+		bool const word = k.width == RamSearch::Width::word;
+		for (size_t w = 0; w < RamSearch::size / 64; w++)
+		{
+			uint64_t bits = candidates[w];
+			for (uint64_t left = bits; left != 0; left &= left - 1)
+			{
+				size_t const i = w * 64 + std::countr_zero(left);
+				uint8_t const aLow = k.current[i];
+				uint8_t const aHigh = word ? k.current[i + 1] : 0;
+				uint8_t const bLow = k.reference ? k.reference[i] : static_cast<uint8_t>(k.raw);
+				uint8_t const bHigh = word ? (k.reference ? k.reference[i + 1] : static_cast<uint8_t>(k.raw >> 8)) : 0;
+				int32_t a = aLow | aHigh << 8;
+				int32_t b = bLow | bHigh << 8;
+				if (k.format == RamSearch::Format::signedInt)
+				{
+					a = word ? static_cast<int16_t>(a) : static_cast<int8_t>(a);
+					b = word ? static_cast<int16_t>(b) : static_cast<int8_t>(b);
+				}
+
+				bool pass = false;
+				switch (k.compare)
+				{
+					case RamSearch::Compare::equal: pass = a == b; break;
+					case RamSearch::Compare::notEqual: pass = a != b; break;
+					case RamSearch::Compare::greater: pass = a > b; break;
+					case RamSearch::Compare::less: pass = a < b; break;
+				}
+				if (k.format == RamSearch::Format::bcd)
+					pass = pass && validBcd(aLow) && (!word || validBcd(aHigh));
+				if (!pass)
+					bits &= ~(uint64_t(1) << (i & 63));
+			}
+			candidates[w] = bits;
+		}
+	}
+
+#if GB_SIMD_X86
+	// bytewise compares build everything, a word is greater when its high byte is, or when the high
+	// bytes are equal and the low one is greater unsigned. Unsigned compares flip the sign bits first
+	__m128i greater128(__m128i a, __m128i b, bool isSigned)
+	{
+		if (isSigned)
+			return _mm_cmpgt_epi8(a, b);
+		__m128i const bias = _mm_set1_epi8(static_cast<char>(0x80));
+		return _mm_cmpgt_epi8(_mm_xor_si128(a, bias), _mm_xor_si128(b, bias));
+	}
+
+	__m128i validBcd128(__m128i v)
+	{
+		__m128i const nibble = _mm_set1_epi8(0x0F);
+		__m128i const nine = _mm_set1_epi8(9);
+		__m128i const invalid = _mm_or_si128(_mm_cmpgt_epi8(_mm_and_si128(v, nibble), nine), _mm_cmpgt_epi8(_mm_and_si128(_mm_srli_epi16(v, 4), nibble), nine));
+		return _mm_andnot_si128(invalid, _mm_set1_epi8(-1));
+	}
+
+	uint32_t passMask128(Kernel const& k, size_t i)
+	{
+		bool const word = k.width == RamSearch::Width::word;
+		bool const isSigned = k.format == RamSearch::Format::signedInt;
+		__m128i const aLow = _mm_loadu_si128(reinterpret_cast<__m128i const*>(k.current + i));
+		__m128i const bLow = k.reference ? _mm_loadu_si128(reinterpret_cast<__m128i const*>(k.reference + i)) : _mm_set1_epi8(static_cast<char>(k.raw));
+
+		__m128i eq = _mm_cmpeq_epi8(aLow, bLow);
+		__m128i gt, lt;
+		__m128i valid = _mm_set1_epi8(-1);
+		if (!word)
+		{
+			gt = greater128(aLow, bLow, isSigned);
+			lt = greater128(bLow, aLow, isSigned);
+		}
+		else
+		{
+			__m128i const aHigh = _mm_loadu_si128(reinterpret_cast<__m128i const*>(k.current + i + 1));
+			__m128i const bHigh = k.reference ? _mm_loadu_si128(reinterpret_cast<__m128i const*>(k.reference + i + 1)) : _mm_set1_epi8(static_cast<char>(k.raw >> 8));
+			__m128i const eqHigh = _mm_cmpeq_epi8(aHigh, bHigh);
+			gt = _mm_or_si128(greater128(aHigh, bHigh, isSigned), _mm_and_si128(eqHigh, greater128(aLow, bLow, false)));
+			lt = _mm_or_si128(greater128(bHigh, aHigh, isSigned), _mm_and_si128(eqHigh, greater128(bLow, aLow, false)));
+			eq = _mm_and_si128(eq, eqHigh);
+			if (k.format == RamSearch::Format::bcd)
+				valid = validBcd128(aHigh);
+		}
+		if (k.format == RamSearch::Format::bcd)
+			valid = _mm_and_si128(valid, validBcd128(aLow));
+
+		__m128i pass = eq;
+		switch (k.compare)
+		{
+			case RamSearch::Compare::equal: pass = eq; break;
+			case RamSearch::Compare::notEqual: pass = _mm_andnot_si128(eq, _mm_set1_epi8(-1)); break;
+			case RamSearch::Compare::greater: pass = gt; break;
+			case RamSearch::Compare::less: pass = lt; break;
+		}
+		return static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(pass, valid)));
+	}
+
+	void filterSse2(Kernel const& k, uint64_t* candidates)
+	{
+		for (size_t w = 0; w < RamSearch::size / 64; w++)
+		{
+			// dropped blocks stay dropped, late filters only touch what's left
+			if (candidates[w] == 0)
+				continue;
+			uint64_t mask = 0;
+			for (size_t block = 0; block < 4; block++)
+				mask |= uint64_t(passMask128(k, w * 64 + block * 16)) << (block * 16);
+			candidates[w] &= mask;
+		}
+	}
+
+	GB_TARGET_AVX2 __m256i greater256(__m256i a, __m256i b, bool isSigned)
+	{
+		if (isSigned)
+			return _mm256_cmpgt_epi8(a, b);
+		__m256i const bias = _mm256_set1_epi8(static_cast<char>(0x80));
+		return _mm256_cmpgt_epi8(_mm256_xor_si256(a, bias), _mm256_xor_si256(b, bias));
+	}
+
+	GB_TARGET_AVX2 __m256i validBcd256(__m256i v)
+	{
+		__m256i const nibble = _mm256_set1_epi8(0x0F);
+		__m256i const nine = _mm256_set1_epi8(9);
+		__m256i const invalid = _mm256_or_si256(_mm256_cmpgt_epi8(_mm256_and_si256(v, nibble), nine), _mm256_cmpgt_epi8(_mm256_and_si256(_mm256_srli_epi16(v, 4), nibble), nine));
+		return _mm256_andnot_si256(invalid, _mm256_set1_epi8(-1));
+	}
+
+	GB_TARGET_AVX2 uint32_t passMask256(Kernel const& k, size_t i)
+	{
+		bool const word = k.width == RamSearch::Width::word;
+		bool const isSigned = k.format == RamSearch::Format::signedInt;
+		__m256i const aLow = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(k.current + i));
+		__m256i const bLow = k.reference ? _mm256_loadu_si256(reinterpret_cast<__m256i const*>(k.reference + i)) : _mm256_set1_epi8(static_cast<char>(k.raw));
+
+		__m256i eq = _mm256_cmpeq_epi8(aLow, bLow);
+		__m256i gt, lt;
+		__m256i valid = _mm256_set1_epi8(-1);
+		if (!word)
+		{
+			gt = greater256(aLow, bLow, isSigned);
+			lt = greater256(bLow, aLow, isSigned);
+		}
+		else
+		{
+			__m256i const aHigh = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(k.current + i + 1));
+			__m256i const bHigh = k.reference ? _mm256_loadu_si256(reinterpret_cast<__m256i const*>(k.reference + i + 1)) : _mm256_set1_epi8(static_cast<char>(k.raw >> 8));
+			__m256i const eqHigh = _mm256_cmpeq_epi8(aHigh, bHigh);
+			gt = _mm256_or_si256(greater256(aHigh, bHigh, isSigned), _mm256_and_si256(eqHigh, greater256(aLow, bLow, false)));
+			lt = _mm256_or_si256(greater256(bHigh, aHigh, isSigned), _mm256_and_si256(eqHigh, greater256(bLow, aLow, false)));
+			eq = _mm256_and_si256(eq, eqHigh);
+			if (k.format == RamSearch::Format::bcd)
+				valid = validBcd256(aHigh);
+		}
+		if (k.format == RamSearch::Format::bcd)
+			valid = _mm256_and_si256(valid, validBcd256(aLow));
+
+		__m256i pass = eq;
+		switch (k.compare)
+		{
+			case RamSearch::Compare::equal: pass = eq; break;
+			case RamSearch::Compare::notEqual: pass = _mm256_andnot_si256(eq, _mm256_set1_epi8(-1)); break;
+			case RamSearch::Compare::greater: pass = gt; break;
+			case RamSearch::Compare::less: pass = lt; break;
+		}
+		return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(pass, valid)));
+	}
+
+	GB_TARGET_AVX2 void filterAvx2(Kernel const& k, uint64_t* candidates)
+	{
+		for (size_t w = 0; w < RamSearch::size / 64; w++)
+		{
+			if (candidates[w] == 0)
+				continue;
+			uint64_t const mask = passMask256(k, w * 64) | uint64_t(passMask256(k, w * 64 + 32)) << 32;
+			candidates[w] &= mask;
+		}
+	}
+#endif
+}
+
+void RamSearch::snapshot(uint8_t const* memory)
+{
+	memcpy(current.data(), memory + lowFirst, lowSize);
+	memcpy(current.data() + lowSize, memory + highFirst, highSize);
+}
+
+void RamSearch::start(uint8_t const* memory, Width width, Format format)
+{
+	searchWidth = width;
+	searchFormat = format;
+	isStarted = true;
+	snapshot(memory);
+	previous = current;
+	candidates.fill(UINT64_MAX);
+
+	// IE isn't ram, and a word can't straddle the gap between the two regions
+	auto const drop = [this](size_t index) { candidates[index / 64] &= ~(uint64_t(1) << (index % 64)); };
+	drop(size - 1);
+	if (width == Width::word)
+	{
+		drop(lowSize - 1);
+		drop(size - 2);
+	}
+}
+
+uint32_t RamSearch::filter(uint8_t const* memory, Compare compare)
+{
+	return filter(memory, compare, previous.data(), 0);
+}
+
+uint32_t RamSearch::filter(uint8_t const* memory, Compare compare, int32_t value)
+{
+	uint16_t raw = 0;
+	if (!encode(value, searchWidth, searchFormat, raw))
+	{
+		// nothing holds a value the format can't encode
+		candidates.fill(0);
+		snapshot(memory);
+		previous = current;
+		return 0;
+	}
+	return filter(memory, compare, nullptr, raw);
+}
+
+uint32_t RamSearch::filter(uint8_t const* memory, Compare compare, uint8_t const* reference, uint16_t raw)
+{
+	snapshot(memory);
+	Kernel const kernel = { searchWidth, searchFormat, compare, current.data(), reference, raw };
+#if GB_SIMD_X86
+	if (simd::hasAvx2())
+		filterAvx2(kernel, candidates.data());
+	else
+		filterSse2(kernel, candidates.data());
+#else
+	filterScalar(kernel, candidates.data());
+#endif
+	previous = current;
+	return count();
+}
+
+uint32_t RamSearch::count() const
+{
+	uint32_t total = 0;
+	for (uint64_t const bits : candidates)
+		total += std::popcount(bits);
+	return total;
+}
+
+std::vector<uint16_t> RamSearch::results(size_t limit) const
+{
+	std::vector<uint16_t> addresses;
+	for (size_t w = 0; w < candidates.size() && addresses.size() < limit; w++)
+	{
+		for (uint64_t bits = candidates[w]; bits != 0 && addresses.size() < limit; bits &= bits - 1)
+			addresses.push_back(addressOf(w * 64 + std::countr_zero(bits)));
+	}
+	return addresses;
+}
+
+int32_t RamSearch::decode(uint8_t low, uint8_t high) const
+{
+	bool const word = searchWidth == Width::word;
+	switch (searchFormat)
+	{
+		case Format::signedInt:
+			return word ? static_cast<int16_t>(low | high << 8) : static_cast<int8_t>(low);
+		case Format::bcd:
+		{
+			int32_t const lowDigits = (low >> 4) * 10 + (low & 0x0F);
+			return word ? ((high >> 4) * 10 + (high & 0x0F)) * 100 + lowDigits : lowDigits;
+		}
+		default:
+			return word ? low | high << 8 : low;
+	}
+}
+
+int32_t RamSearch::value(uint8_t const* memory, uint16_t address) const
+{
+	return decode(memory[address], memory[static_cast<uint16_t>(address + 1)]);
+}
+
+int32_t RamSearch::previousValue(uint16_t address) const
+{
+	size_t const index = indexOf(address);
+	if (index == SIZE_MAX)
+		return 0;
+	return decode(previous[index], previous[index + 1]);
+}
+
+bool RamSearch::encode(int32_t value, Width width, Format format, uint16_t& raw)
+{
+	bool const word = width == Width::word;
+	switch (format)
+	{
+		case Format::signedInt:
+			if (value < (word ? INT16_MIN : INT8_MIN) || value > (word ? INT16_MAX : INT8_MAX))
+				return false;
+			raw = static_cast<uint16_t>(value);
+			return true;
+		case Format::bcd:
+		{
+			if (value < 0 || value > (word ? 9999 : 99))
+				return false;
+			raw = 0;
+			for (int shift = 0; value > 0; shift += 4, value /= 10)
+				raw |= static_cast<uint16_t>((value % 10) << shift);
+			return true;
+		}
+		default:
+			if (value < 0 || value > (word ? UINT16_MAX : UINT8_MAX))
+				return false;
+			raw = static_cast<uint16_t>(value);
+			return true;
+	}
+}
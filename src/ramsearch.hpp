@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Cheat finder over the writable memory a game keeps its state in: cart ram, wram and hram.
+// Every address starts as a candidate holding an 8 or 16 bit value starting there, each filter
+// compares the values against the snapshot of the filter before or against a constant and drops
+// the addresses that fail. Candidates are one bit each, the compares run 32 or 16 addresses at a time.
+class RamSearch
+{
+	public:
+
+	enum class Width : uint8_t
+	{
+		byte,
+		word, // little endian, the high byte at the next address
+	};
+
+	enum class Format : uint8_t
+	{
+		unsignedInt,
+		signedInt,
+		bcd, // two decimal digits a byte, bytes with a nibble above 9 never match
+	};
+
+	enum class Compare : uint8_t
+	{
+		equal,
+		notEqual,
+		greater,
+		less,
+	};
+
+	// cart ram and wram are next to each other, hram is packed after them
+	static uint16_t constexpr lowFirst = 0xA000;
+	static size_t constexpr lowSize = 0x4000;
+	static uint16_t constexpr highFirst = 0xFF80;
+	static size_t constexpr highSize = 0x80; // IE at FFFF pads it, it's never a candidate
+	static size_t constexpr size = lowSize + highSize;
+
+	static uint16_t addressOf(size_t index) { return static_cast<uint16_t>(index < lowSize ? lowFirst + index : highFirst + (index - lowSize)); }
+	// SIZE_MAX outside of the searched memory
+	static size_t indexOf(uint16_t address)
+	{
+		if (address >= lowFirst && address < lowFirst + lowSize)
+			return address - lowFirst;
+		if (address >= highFirst)
+			return lowSize + (address - highFirst);
+		return SIZE_MAX;
+	}
+
+	RamSearch() { candidates.fill(0); }
+
+	// every address a candidate again, memory is the first snapshot
+	void start(uint8_t const* memory, Width width, Format format);
+	// keeps the candidates whose value compares true against the last snapshot, or against value
+	// when one is given, memory becomes the next snapshot. Returns the candidates left
+	uint32_t filter(uint8_t const* memory, Compare compare);
+	uint32_t filter(uint8_t const* memory, Compare compare, int32_t value);
+
+	bool started() const { return isStarted; }
+	Width width() const { return searchWidth; }
+	Format format() const { return searchFormat; }
+	uint32_t count() const;
+	// first candidates in address order
+	std::vector<uint16_t> results(size_t limit) const;
+
+	// the value at address read the way the search reads it
+	int32_t value(uint8_t const* memory, uint16_t address) const;
+	int32_t previousValue(uint16_t address) const;
+
+	// the raw little endian bytes of a value, false when the format can't hold it
+	static bool encode(int32_t value, Width width, Format format, uint16_t& raw);
+
+	private:
+
+	uint32_t filter(uint8_t const* memory, Compare compare, uint8_t const* reference, uint16_t raw);
+	void snapshot(uint8_t const* memory);
+	int32_t decode(uint8_t low, uint8_t high) const;
+
+	// one byte past the end so the high byte of the last word can be loaded with the rest
+	alignas(32) std::array<uint8_t, size + 32> current = {};
+	alignas(32) std::array<uint8_t, size + 32> previous = {};
+	std::array<uint64_t, size / 64> candidates;
+	Width searchWidth = Width::byte;
+	Format searchFormat = Format::unsignedInt;
+	bool isStarted = false;
+};
@@ -0,0 +1,175 @@
+#include "rewind.hpp"
+
+#include <algorithm>
+#include <utility>
+
+void Rewind::configure(uint64_t interval, size_t memoryBudget)
+{
+	configuredInterval = std::max<uint64_t>(interval, 1);
+	currentInterval = configuredInterval;
+	budget = memoryBudget;
+	thin();
+}
+
+void Rewind::reset()
+{
+	keyframes.clear();
+	inputs.clear();
+	startsKeyframe = SIZE_MAX;
+	currentInterval = configuredInterval;
+}
+
+void Rewind::capture(Gameboy const& gb)
+{
+	uint64_t const now = gb.ticks;
+	startsKeyframe = SIZE_MAX;
+	while (!keyframes.empty() && keyframes.back()->ticks > now)
+		keyframes.pop_back();
+	while (!inputs.empty() && inputs.back().tick > now)
+		inputs.pop_back();
+
+	if (keyframes.empty() || now >= keyframes.back()->ticks + currentInterval)
+	{
+		auto keyframe = std::make_unique<GameboyState>();
+		gb.saveState(*keyframe);
+		keyframes.push_back(std::move(keyframe));
+		thin();
+	}
+
+	// the first keyframe holds the joypad state the log starts from
+	uint8_t const previous = !inputs.empty() ? inputs.back().buttons : keyframes.front()->buttons;
+	if (gb.mmu.buttons != previous)
+	{
+		if (!inputs.empty() && inputs.back().tick == now)
+			inputs.back().buttons = gb.mmu.buttons;
+		else
+			inputs.push_back({ now, gb.mmu.buttons });
+	}
+}
+
+void Rewind::thin()
+{
+	while (memoryUsed() > budget && keyframes.size() >= 3)
+	{
+		// keeps the first one, the joypad log starts there
+		size_t kept = 0;
+		for (size_t i = 0; i < keyframes.size(); i += 2)
+			keyframes[kept++] = std::move(keyframes[i]);
+		keyframes.resize(kept);
+		currentInterval *= 2;
+		startsKeyframe = SIZE_MAX;
+	}
+}
+
+size_t Rewind::keyframeBefore(uint64_t tick) const
+{
+	auto const it = std::lower_bound(keyframes.begin(), keyframes.end(), tick,
+		[](std::unique_ptr<GameboyState> const& keyframe, uint64_t t) { return keyframe->ticks < t; });
+	return it == keyframes.begin() ? SIZE_MAX : static_cast<size_t>(it - keyframes.begin()) - 1;
+}
+
+void Rewind::restore(Gameboy& gb, size_t keyframe) const
+{
+	gb.loadState(*keyframes[keyframe]);
+}
+
+Gameboy::RunResult Rewind::runRecorded(Gameboy& gb, uint64_t target, bool checkBreakpoints) const
+{
+	auto input = std::lower_bound(inputs.begin(), inputs.end(), gb.ticks,
+		[](InputChange const& change, uint64_t t) { return change.tick < t; });
+	for (;;)
+	{
+		// instructions end exactly on the recorded ticks since the run is the same as the first time
+		if (input != inputs.end() && input->tick <= gb.ticks)
+		{
+			gb.mmu.buttons = input->buttons;
+			++input;
+			continue;
+		}
+		if (gb.ticks >= target)
+			return Gameboy::RunResult::Completed;
+
+		uint64_t const stop = input != inputs.end() ? std::min(target, input->tick) : target;
+		Gameboy::RunResult const result = gb.replay(stop, checkBreakpoints);
+		if (result != Gameboy::RunResult::Completed)
+			return result;
+	}
+}
+
+bool Rewind::stepBack(Gameboy& gb)
+{
+	uint64_t const now = gb.ticks;
+	size_t const keyframe = keyframeBefore(now);
+	if (keyframe == SIZE_MAX)
+		return false;
+
+	if (startsKeyframe != keyframe || now > startsEnd || starts.empty() || now <= starts.front())
+		instructionStarts(gb, keyframe, now);
+	if (starts.empty() || starts.front() >= now)
+		return false;
+	auto const previous = std::lower_bound(starts.begin(), starts.end(), now) - 1;
+	gb.loadState(startsState);
+	runRecorded(gb, *previous, false);
+	return true;
+}
+
+void Rewind::instructionStarts(Gameboy& gb, size_t keyframe, uint64_t end)
+{
+	// a run stops on the first instruction boundary at or past its target, the window starts there
+	restore(gb, keyframe);
+	if (end > gb.ticks + stepBackWindow)
+		runRecorded(gb, end - stepBackWindow, false);
+	gb.saveState(startsState);
+
+	auto input = std::lower_bound(inputs.begin(), inputs.end(), gb.ticks,
+		[](InputChange const& change, uint64_t t) { return change.tick < t; });
+	starts.clear();
+	while (gb.ticks < end)
+	{
+		starts.push_back(gb.ticks);
+		for (; input != inputs.end() && input->tick <= gb.ticks; ++input)
+			gb.mmu.buttons = input->buttons;
+		if (gb.replayStep() == Gameboy::RunResult::Fault)
+			break;
+	}
+	startsKeyframe = keyframe;
+	startsEnd = end;
+}
+
+bool Rewind::reverseContinue(Gameboy& gb)
+{
+	uint64_t const now = gb.ticks;
+	if (!gb.breakpoints.armed() || keyframeBefore(now) == SIZE_MAX)
+		return false;
+
+	// newest keyframe first, the last hit of a span is the one closest to now
+	uint64_t limit = now;
+	for (size_t keyframe = keyframeBefore(now); keyframe != SIZE_MAX; keyframe = keyframe > 0 ? keyframe - 1 : SIZE_MAX)
+	{
+		restore(gb, keyframe);
+		uint64_t hit = UINT64_MAX;
+		// replay never checks the instruction it starts on, and like it this one isn't counted
+		bool const countHits = std::exchange(gb.breakpoints.countHits, false);
+		if (gb.breakpoints.hit(gb.mmu.bankOf(gb.registers.pc), gb.registers.pc, gb.registers, gb.mmu))
+			hit = gb.ticks;
+		gb.breakpoints.countHits = countHits;
+		while (gb.ticks < limit && runRecorded(gb, limit, true) == Gameboy::RunResult::Breakpoint)
+		{
+			if (gb.ticks < limit)
+				hit = gb.ticks;
+		}
+
+		if (hit != UINT64_MAX)
+		{
+			restore(gb, keyframe);
+			runRecorded(gb, hit, false);
+			return true;
+		}
+		limit = keyframes[keyframe]->ticks;
+	}
+
+	// no hit anywhere in the history, back to where it started
+	restore(gb, keyframeBefore(now));
+	runRecorded(gb, now, false);
+	return false;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "gameboy.hpp"
+
+// Reverse execution for the debugger. Keyframes of the whole console are taken every interval
+// cycles and the joypad changes in between are logged, going back restores the closest earlier
+// keyframe and runs forward again, which is deterministic. When the keyframes outgrow the memory
+// budget every other one is dropped and the interval doubles, so a long session stays covered.
+class Rewind
+{
+	public:
+
+	static uint64_t constexpr defaultInterval = Gameboy::cyclesPerFrame;
+	static size_t constexpr defaultBudget = 256 * 1024 * 1024;
+	// cycles before the current position a step back re-executes one instruction at a time
+	static uint64_t constexpr stepBackWindow = 16384;
+
+	void configure(uint64_t interval, size_t memoryBudget);
+	// forgets the history, on rom load and console start
+	void reset();
+
+	// called before anything runs the console, frames and single steps alike, takes a keyframe when
+	// one is due and logs the joypad, history after the current tick is dropped first since the
+	// console went back in time
+	void capture(Gameboy const& gb);
+
+	// back to the start of the previous instruction, false when history doesn't reach it
+	bool stepBack(Gameboy& gb);
+	// back to the latest breakpoint hit before the current position, stays put when there's none
+	bool reverseContinue(Gameboy& gb);
+
+	size_t keyframeCount() const { return keyframes.size(); }
+	size_t memoryUsed() const { return keyframes.size() * sizeof(GameboyState) + inputs.size() * sizeof(InputChange); }
+	uint64_t oldestTick() const { return keyframes.empty() ? 0 : keyframes.front()->ticks; }
+	// current spacing, grows past the configured one as keyframes are thinned
+	uint64_t interval() const { return currentInterval; }
+
+	private:
+
+	struct InputChange
+	{
+		uint64_t tick;
+		uint8_t buttons;
+	};
+
+	// last keyframe strictly before tick, SIZE_MAX when there's none
+	size_t keyframeBefore(uint64_t tick) const;
+	void restore(Gameboy& gb, size_t keyframe) const;
+	// runs to target from the restored state replaying the joypad log
+	Gameboy::RunResult runRecorded(Gameboy& gb, uint64_t target, bool checkBreakpoints) const;
+	void thin();
+	// replays up to stepBackWindow cycles before end and records the instruction starts from there
+	void instructionStarts(Gameboy& gb, size_t keyframe, uint64_t end);
+
+	std::vector<std::unique_ptr<GameboyState>> keyframes;
+	std::vector<InputChange> inputs;
+	uint64_t configuredInterval = defaultInterval;
+	uint64_t currentInterval = defaultInterval;
+	size_t budget = defaultBudget;
+	// where every instruction of the window before startsEnd starts, and the console at the first
+	// one, so repeated steps back only re-execute from there
+	std::vector<uint64_t> starts;
+	GameboyState startsState;
+	size_t startsKeyframe = SIZE_MAX;
+	uint64_t startsEnd = 0;
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+// DMG link port, SB (0xFF01) holds the byte to shift out and receives the remote byte,
+// SC (0xFF02) bit 7 starts a transfer and bit 0 selects the internal (master) clock
+struct Serial
+{
+	static uint8_t constexpr transferStart = 0x80;
+	static uint8_t constexpr internalClock = 0x01;
+	static uint8_t constexpr interruptFlag = 1 << 3;
+	// 8 bits shifted at 8192Hz
+	static uint32_t constexpr transferCycles = 4096;
+	// what a master reads when nothing is plugged in
+	static uint8_t constexpr disconnectedByte = 0xFF;
+
+	bool active = false;
+	uint64_t endTick = 0;
+};
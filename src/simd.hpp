@@ -0,0 +1,50 @@
+#pragma once
+
+// Vector paths for the hot loops that scan whole memory regions. SSE2 is always there on x86-64,
+// AVX2 is picked at runtime so the binary still runs on older cpus, anything else gets the scalar code.
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define GB_SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define GB_SIMD_X86 0
+#endif
+
+// msvc compiles any intrinsic without flags, gcc and clang want the target on the function
+#if GB_SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+#define GB_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define GB_TARGET_AVX2
+#endif
+
+namespace simd
+{
+	inline bool hasAvx2()
+	{
+#if GB_SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+		static bool const supported = __builtin_cpu_supports("avx2");
+		return supported;
+#elif GB_SIMD_X86
+		static bool const supported = []
+		{
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7)
+				return false;
+			__cpuid(info, 1);
+			// the os has to save the ymm registers too
+			bool const osxsave = (info[2] & (1 << 27)) != 0;
+			if (!osxsave || (_xgetbv(0) & 6) != 6)
+				return false;
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 5)) != 0;
+		}();
+		return supported;
+#else
+		return false;
+#endif
+	}
+}
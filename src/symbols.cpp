@@ -0,0 +1,123 @@
+#include "symbols.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+
+// rom0, romx, vram, cart ram, wram, echo and oam/io/hram, a label never covers another area
+static uint8_t memoryArea(uint16_t address)
+{
+	if (address < 0x4000) return 0;
+	if (address < 0x8000) return 1;
+	if (address < 0xA000) return 2;
+	if (address < 0xC000) return 3;
+	if (address < 0xE000) return 4;
+	if (address < 0xFE00) return 5;
+	return 6;
+}
+
+static int hexDigit(char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+static bool isSpace(char c)
+{
+	return c == ' ' || c == '\t';
+}
+
+bool SymbolTable::load(std::filesystem::path const& path)
+{
+	FILE* file = fopen(path.string().c_str(), "rb");
+	if (file == nullptr)
+	{
+		fprintf(stderr, "error : failed to open \"%s\"\n", path.string().c_str());
+		return false;
+	}
+	fseek(file, 0, SEEK_END);
+	long const fileSize = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	text.resize(fileSize > 0 ? static_cast<size_t>(fileSize) : 0);
+	size_t const size = fread(text.data(), 1, text.size(), file);
+	fclose(file);
+
+	symbols.clear();
+	symbols.reserve(std::count(text.begin(), text.begin() + size, '\n') + 1);
+
+	char const* const begin = text.data();
+	char const* const end = begin + size;
+	char const* c = begin;
+	while (c < end)
+	{
+		while (c < end && (isSpace(*c) || *c == '\r' || *c == '\n'))
+			c++;
+
+		// BB:AAAA Label, anything else up to the end of the line (comments, headers) is skipped
+		uint32_t bank = 0, address = 0;
+		int digits = 0;
+		for (; c < end && hexDigit(*c) >= 0; c++, digits++)
+			bank = bank << 4 | hexDigit(*c);
+		bool valid = digits > 0 && c < end && *c == ':';
+		if (valid)
+		{
+			c++;
+			digits = 0;
+			for (; c < end && hexDigit(*c) >= 0; c++, digits++)
+				address = address << 4 | hexDigit(*c);
+			valid = digits > 0 && digits <= 4 && bank <= 0xFFFF && c < end && isSpace(*c);
+		}
+		if (valid)
+		{
+			while (c < end && isSpace(*c))
+				c++;
+			char const* const name = c;
+			while (c < end && !isSpace(*c) && *c != ';' && *c != '\r' && *c != '\n')
+				c++;
+			if (c > name)
+				symbols.push_back({ bank << 16 | address, static_cast<uint32_t>(name - begin), static_cast<uint32_t>(c - name) });
+		}
+		while (c < end && *c != '\n')
+			c++;
+	}
+
+	// rgblink already sorts, stable so the first of several labels on an address wins
+	std::stable_sort(symbols.begin(), symbols.end(), [](Symbol const& a, Symbol const& b) { return a.key < b.key; });
+	return true;
+}
+
+SymbolTable::Match SymbolTable::find(uint16_t bank, uint16_t address) const
+{
+	uint32_t const key = static_cast<uint32_t>(bank) << 16 | address;
+	auto it = std::upper_bound(symbols.begin(), symbols.end(), key, [](uint32_t k, Symbol const& s) { return k < s.key; });
+	if (it == symbols.begin())
+		return {};
+
+	// back to the first label of that address
+	uint32_t const found = std::prev(it)->key;
+	it = std::lower_bound(symbols.begin(), it, found, [](Symbol const& s, uint32_t k) { return s.key < k; });
+
+	uint16_t const symbolAddress = static_cast<uint16_t>(found);
+	if ((found >> 16) != bank || memoryArea(symbolAddress) != memoryArea(address))
+		return {};
+	return { name(*it), static_cast<uint16_t>(address - symbolAddress) };
+}
+
+void SymbolTable::format(uint16_t bank, uint16_t address, char* out, size_t size) const
+{
+	Match const match = find(bank, address);
+	if (match.name.empty())
+		snprintf(out, size, "0x%04X", address);
+	else if (match.offset == 0)
+		snprintf(out, size, "%.*s", static_cast<int>(match.name.size()), match.name.data());
+	else
+		snprintf(out, size, "%.*s+0x%X", static_cast<int>(match.name.size()), match.name.data(), match.offset);
+}
+
+std::filesystem::path symbolPathFor(std::filesystem::path const& romPath)
+{
+	std::filesystem::path path = romPath;
+	return path.replace_extension(".sym");
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+// Labels of an RGBDS or no$gmb .sym file ("BB:AAAA Label" lines), sorted on (bank, address).
+// Names point into the file content, loading allocates the content and the symbol array once.
+class SymbolTable
+{
+	public:
+
+	struct Symbol
+	{
+		uint32_t key; // bank << 16 | address
+		uint32_t nameOffset;
+		uint32_t nameLength;
+	};
+
+	struct Match
+	{
+		std::string_view name; // empty when no symbol covers the address
+		uint16_t offset;
+	};
+
+	bool load(std::filesystem::path const& path);
+
+	bool empty() const { return symbols.empty(); }
+	size_t size() const { return symbols.size(); }
+
+	// closest symbol at or below the address, in the same bank and memory area
+	Match find(uint16_t bank, uint16_t address) const;
+	// "label", "label+0x12", or "0x1234" when nothing covers the address
+	void format(uint16_t bank, uint16_t address, char* out, size_t size) const;
+
+	// every label sorted on key
+	std::vector<Symbol> const& all() const { return symbols; }
+	std::string_view name(Symbol const& symbol) const { return std::string_view(text.data() + symbol.nameOffset, symbol.nameLength); }
+
+	private:
+
+	std::vector<char> text;
+	std::vector<Symbol> symbols;
+};
+
+// the .sym file rgblink writes next to the rom
+std::filesystem::path symbolPathFor(std::filesystem::path const& romPath);
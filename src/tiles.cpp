@@ -0,0 +1,203 @@
+#include "tiles.hpp"
+
+#include "simd.hpp"
+
+namespace
+{
+	void decodeScalar(uint8_t const* rows, size_t rowCount, uint8_t* indices)
+	{
+		for (size_t row = 0; row < rowCount; row++)
+		{
+			uint8_t const low = rows[row * 2];
+			uint8_t const high = rows[row * 2 + 1];
+			for (int x = 0; x < 8; x++)
+				indices[row * 8 + x] = static_cast<uint8_t>((low >> (7 - x) & 1) | (high >> (7 - x) & 1) << 1);
+		}
+	}
+
+	void mapScalar(uint8_t const* indices, size_t count, uint8_t palette, uint32_t* rgba)
+	{
+		uint32_t colors[4];
+		tiles::paletteColors(palette, colors);
+		for (size_t i = 0; i < count; i++)
+			rgba[i] = colors[indices[i] & 3];
+	}
+
+#if GB_SIMD_X86
+	// a byte repeated over 8 lanes tested against the pixel bits, leftmost pixel first
+	__m128i pixelBits128(__m128i repeated, __m128i bits, __m128i value)
+	{
+		return _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(repeated, bits), bits), value);
+	}
+
+	void decodeSse2(uint8_t const* rows, size_t rowCount, uint8_t* indices)
+	{
+		__m128i const bits = _mm_setr_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1);
+		__m128i const one = _mm_set1_epi8(1);
+		__m128i const two = _mm_set1_epi8(2);
+		__m128i const zero = _mm_setzero_si128();
+		size_t row = 0;
+		// 8 rows a step, the low and high planes split then every byte spread over its 8 pixels
+		for (; row + 8 <= rowCount; row += 8)
+		{
+			__m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(rows + row * 2));
+			__m128i const low = _mm_packus_epi16(_mm_and_si128(v, _mm_set1_epi16(0x00FF)), zero);
+			__m128i const high = _mm_packus_epi16(_mm_srli_epi16(v, 8), zero);
+			__m128i const low2 = _mm_unpacklo_epi8(low, low);
+			__m128i const high2 = _mm_unpacklo_epi8(high, high);
+			__m128i const low4[2] = { _mm_unpacklo_epi16(low2, low2), _mm_unpackhi_epi16(low2, low2) };
+			__m128i const high4[2] = { _mm_unpacklo_epi16(high2, high2), _mm_unpackhi_epi16(high2, high2) };
+			for (int half = 0; half < 2; half++)
+			{
+				__m128i const low8[2] = { _mm_unpacklo_epi32(low4[half], low4[half]), _mm_unpackhi_epi32(low4[half], low4[half]) };
+				__m128i const high8[2] = { _mm_unpacklo_epi32(high4[half], high4[half]), _mm_unpackhi_epi32(high4[half], high4[half]) };
+				for (int pair = 0; pair < 2; pair++)
+				{
+					__m128i const pixels = _mm_or_si128(pixelBits128(low8[pair], bits, one), pixelBits128(high8[pair], bits, two));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(indices + (row + half * 4 + pair * 2) * 8), pixels);
+				}
+			}
+		}
+		decodeScalar(rows + row * 2, rowCount - row, indices + row * 8);
+	}
+
+	void mapSse2(uint8_t const* indices, size_t count, uint8_t palette, uint32_t* rgba)
+	{
+		uint32_t colors[4];
+		tiles::paletteColors(palette, colors);
+		__m128i color[4];
+		__m128i index[4];
+		for (int i = 0; i < 4; i++)
+		{
+			color[i] = _mm_set1_epi32(static_cast<int>(colors[i]));
+			index[i] = _mm_set1_epi32(i);
+		}
+
+		__m128i const zero = _mm_setzero_si128();
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			__m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(indices + i));
+			__m128i const words[2] = { _mm_unpacklo_epi8(v, zero), _mm_unpackhi_epi8(v, zero) };
+			for (int quarter = 0; quarter < 4; quarter++)
+			{
+				__m128i const lanes = quarter & 1 ? _mm_unpackhi_epi16(words[quarter >> 1], zero) : _mm_unpacklo_epi16(words[quarter >> 1], zero);
+				// no 32 bit gather before AVX2, four selects instead
+				__m128i result = _mm_and_si128(_mm_cmpeq_epi32(lanes, index[0]), color[0]);
+				for (int c = 1; c < 4; c++)
+					result = _mm_or_si128(result, _mm_and_si128(_mm_cmpeq_epi32(lanes, index[c]), color[c]));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + i + quarter * 4), result);
+			}
+		}
+		mapScalar(indices + i, count - i, palette, rgba + i);
+	}
+
+	GB_TARGET_AVX2 __m256i pixelBits256(__m256i repeated, __m256i bits, __m256i value)
+	{
+		return _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(repeated, bits), bits), value);
+	}
+
+	GB_TARGET_AVX2 void decodeAvx2(uint8_t const* rows, size_t rowCount, uint8_t* indices)
+	{
+		__m256i const bits = _mm256_setr_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1,
+			-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1);
+		__m256i const one = _mm256_set1_epi8(1);
+		__m256i const two = _mm256_set1_epi8(2);
+		// shuffles spread the low planes of 4 rows over 32 pixels, the high plane is the byte after
+		__m256i const lowFirst = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 2, 2, 2, 2,
+			4, 4, 4, 4, 4, 4, 4, 4, 6, 6, 6, 6, 6, 6, 6, 6);
+		__m256i const lowSecond = _mm256_add_epi8(lowFirst, _mm256_set1_epi8(8));
+		size_t row = 0;
+		for (; row + 8 <= rowCount; row += 8)
+		{
+			__m256i const v = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<__m128i const*>(rows + row * 2)));
+			__m256i const selects[2] = { lowFirst, lowSecond };
+			for (int half = 0; half < 2; half++)
+			{
+				__m256i const low = _mm256_shuffle_epi8(v, selects[half]);
+				__m256i const high = _mm256_shuffle_epi8(v, _mm256_add_epi8(selects[half], one));
+				__m256i const pixels = _mm256_or_si256(pixelBits256(low, bits, one), pixelBits256(high, bits, two));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(indices + (row + half * 4) * 8), pixels);
+			}
+		}
+		decodeScalar(rows + row * 2, rowCount - row, indices + row * 8);
+	}
+
+	GB_TARGET_AVX2 void mapAvx2(uint8_t const* indices, size_t count, uint8_t palette, uint32_t* rgba)
+	{
+		uint32_t colors[4];
+		tiles::paletteColors(palette, colors);
+		// the permute reads 3 bits of index, the table repeats for the ones above 3
+		__m256i const table = _mm256_setr_epi32(static_cast<int>(colors[0]), static_cast<int>(colors[1]), static_cast<int>(colors[2]), static_cast<int>(colors[3]),
+			static_cast<int>(colors[0]), static_cast<int>(colors[1]), static_cast<int>(colors[2]), static_cast<int>(colors[3]));
+		size_t i = 0;
+		for (; i + 32 <= count; i += 32)
+		{
+			for (int part = 0; part < 4; part++)
+			{
+				__m256i const lanes = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(indices + i + part * 8)));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + i + part * 8), _mm256_permutevar8x32_epi32(table, lanes));
+			}
+		}
+		mapScalar(indices + i, count - i, palette, rgba + i);
+	}
+#endif
+}
+
+namespace tiles
+{
+	Isa bestIsa()
+	{
+#if GB_SIMD_X86
+		return simd::hasAvx2() ? Isa::avx2 : Isa::sse2;
+#else
+		return Isa::scalar;
+#endif
+	}
+
+	char const* isaName(Isa isa)
+	{
+		switch (isa)
+		{
+			case Isa::sse2: return "SSE2";
+			case Isa::avx2: return "AVX2";
+			default: return "scalar";
+		}
+	}
+
+	void decodeRows(uint8_t const* rows, size_t rowCount, uint8_t* indices)
+	{
+		static Isa const isa = bestIsa();
+		decodeRows(isa, rows, rowCount, indices);
+	}
+
+	void decodeRows(Isa isa, uint8_t const* rows, size_t rowCount, uint8_t* indices)
+	{
+		switch (isa)
+		{
+#if GB_SIMD_X86
+			case Isa::avx2: decodeAvx2(rows, rowCount, indices); break;
+			case Isa::sse2: decodeSse2(rows, rowCount, indices); break;
+#endif
+			default: decodeScalar(rows, rowCount, indices); break;
+		}
+	}
+
+	void mapPalette(uint8_t const* indices, size_t count, uint8_t palette, uint32_t* rgba)
+	{
+		static Isa const isa = bestIsa();
+		mapPalette(isa, indices, count, palette, rgba);
+	}
+
+	void mapPalette(Isa isa, uint8_t const* indices, size_t count, uint8_t palette, uint32_t* rgba)
+	{
+		switch (isa)
+		{
+#if GB_SIMD_X86
+			case Isa::avx2: mapAvx2(indices, count, palette, rgba); break;
+			case Isa::sse2: mapSse2(indices, count, palette, rgba); break;
+#endif
+			default: mapScalar(indices, count, palette, rgba); break;
+		}
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 2bpp tile rows to palette indices, and palette indices to RGBA through a DMG palette register.
+// A tile row is two bytes, the low bits of its 8 pixels then the high bits, leftmost pixel in bit 7.
+// The vector paths decode 16 (SSE2) or 32 (AVX2) pixels a step, picked at runtime.
+namespace tiles
+{
+	enum class Isa : uint8_t
+	{
+		scalar,
+		sse2,
+		avx2,
+	};
+
+	// DMG greens from lightest to darkest, RGBA in memory order
+	inline uint32_t constexpr shades[4] = { 0xFFD0F8E0, 0xFF70C088, 0xFF566834, 0xFF201808 };
+
+	// the fastest the cpu runs
+	Isa bestIsa();
+	char const* isaName(Isa isa);
+
+	// rows is rowCount pairs of bytes, indices receives 8 per row
+	void decodeRows(uint8_t const* rows, size_t rowCount, uint8_t* indices);
+	void decodeRows(Isa isa, uint8_t const* rows, size_t rowCount, uint8_t* indices);
+
+	// palette is BGP, OBP0 or OBP1, two bits of shade per index
+	void mapPalette(uint8_t const* indices, size_t count, uint8_t palette, uint32_t* rgba);
+	void mapPalette(Isa isa, uint8_t const* indices, size_t count, uint8_t palette, uint32_t* rgba);
+
+	// the RGBA of every index a palette register maps
+	inline void paletteColors(uint8_t palette, uint32_t colors[4])
+	{
+		for (int i = 0; i < 4; i++)
+			colors[i] = shades[(palette >> (i * 2)) & 3];
+	}
+}
@@ -0,0 +1,123 @@
+#include "tracing.hpp"
+
+#ifdef GB_TRACING
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+
+namespace tracing
+{
+
+static size_t constexpr bufferCapacity = 1 << 16;
+
+struct ThreadBuffer
+{
+	uint32_t threadId = 0;
+	// monotonic, the slot of an event is its index modulo the capacity
+	std::atomic<uint64_t> written = 0;
+	std::unique_ptr<Event[]> events = std::make_unique<Event[]>(bufferCapacity);
+	uint64_t lastFrameMark = 0;
+	uint64_t frameMark = 0;
+};
+
+static std::mutex buffersMutex;
+static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+static auto const startTime = std::chrono::steady_clock::now();
+
+static ThreadBuffer& threadBuffer()
+{
+	thread_local ThreadBuffer* buffer = []()
+	{
+		std::lock_guard const lock(buffersMutex);
+		auto& newBuffer = buffers.emplace_back(std::make_unique<ThreadBuffer>());
+		newBuffer->threadId = static_cast<uint32_t>(buffers.size());
+		return newBuffer.get();
+	}();
+	return *buffer;
+}
+
+uint64_t now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void record(char const* name, uint64_t start, uint64_t end)
+{
+	ThreadBuffer& buffer = threadBuffer();
+	uint64_t const index = buffer.written.load(std::memory_order_relaxed);
+	buffer.events[index % bufferCapacity] = { name, start, end };
+	buffer.written.store(index + 1, std::memory_order_release);
+}
+
+void frameMark()
+{
+	ThreadBuffer& buffer = threadBuffer();
+	buffer.lastFrameMark = buffer.frameMark;
+	buffer.frameMark = now();
+}
+
+std::vector<ZoneStat> frameStats()
+{
+	ThreadBuffer& buffer = threadBuffer();
+	std::vector<ZoneStat> stats;
+
+	// newest first, stops at the first zone that started before the previous frame mark
+	uint64_t const written = buffer.written.load(std::memory_order_acquire);
+	uint64_t const oldest = written > bufferCapacity ? written - bufferCapacity : 0;
+	for (uint64_t i = written; i > oldest; i--)
+	{
+		Event const& event = buffer.events[(i - 1) % bufferCapacity];
+		if (event.start < buffer.lastFrameMark)
+			break;
+		if (event.end > buffer.frameMark)
+			continue;
+
+		auto it = std::find_if(stats.begin(), stats.end(), [&](ZoneStat const& stat) { return stat.name == event.name; });
+		if (it == stats.end())
+			it = stats.insert(stats.end(), { event.name, 0.0, 0 });
+		it->milliseconds += (event.end - event.start) / 1e6;
+		it->count++;
+	}
+
+	std::sort(stats.begin(), stats.end(), [](ZoneStat const& a, ZoneStat const& b) { return a.milliseconds > b.milliseconds; });
+	return stats;
+}
+
+bool exportChromeTrace(std::filesystem::path const& path)
+{
+	FILE* file = fopen(path.string().c_str(), "w");
+	if (file == nullptr)
+	{
+		fprintf(stderr, "error : failed to open \"%s\"\n", path.string().c_str());
+		return false;
+	}
+
+	fprintf(file, "{\"traceEvents\":[\n");
+	bool first = true;
+
+	std::lock_guard const lock(buffersMutex);
+	for (auto const& buffer : buffers)
+	{
+		uint64_t const written = buffer->written.load(std::memory_order_acquire);
+		uint64_t const oldest = written > bufferCapacity ? written - bufferCapacity : 0;
+		for (uint64_t i = oldest; i < written; i++)
+		{
+			Event const& event = buffer->events[i % bufferCapacity];
+			fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				first ? "" : ",\n", event.name, buffer->threadId, event.start / 1e3, (event.end - event.start) / 1e3);
+			first = false;
+		}
+	}
+
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	return true;
+}
+
+}
+
+#endif
@@ -0,0 +1,65 @@
+#pragma once
+
+// Scoped timing zones exported as Chrome trace events (about://tracing, ui.perfetto.dev).
+// Zones only exist when built with GB_TRACING, otherwise GB_TRACE_ZONE expands to nothing.
+
+#ifdef GB_TRACING
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace tracing
+{
+	struct Event
+	{
+		char const* name; // string literal, zones are grouped by pointer
+		uint64_t start;   // ns since the first zone
+		uint64_t end;
+	};
+
+	struct ZoneStat
+	{
+		char const* name;
+		double milliseconds;
+		uint32_t count;
+	};
+
+	uint64_t now();
+
+	// appends to the calling thread's ring buffer, no lock once the buffer exists
+	void record(char const* name, uint64_t start, uint64_t end);
+
+	class Zone
+	{
+		public:
+
+		explicit Zone(char const* name) : name(name), start(now()) {}
+		~Zone() { record(name, start, now()); }
+
+		Zone(Zone const&) = delete;
+		Zone& operator=(Zone const&) = delete;
+
+		private:
+
+		char const* name;
+		uint64_t start;
+	};
+
+	// marks the start of a host frame on the calling thread, frameStats() reports the frame before
+	void frameMark();
+	std::vector<ZoneStat> frameStats();
+
+	// call while other threads aren't recording, their newest events could be torn otherwise
+	bool exportChromeTrace(std::filesystem::path const& path);
+}
+
+#define GB_TRACE_CONCAT_IMPL(a, b) a##b
+#define GB_TRACE_CONCAT(a, b) GB_TRACE_CONCAT_IMPL(a, b)
+#define GB_TRACE_ZONE(name) ::tracing::Zone GB_TRACE_CONCAT(traceZone, __LINE__)(name)
+
+#else
+
+#define GB_TRACE_ZONE(name)
+
+#endif
@@ -0,0 +1,1031 @@
+#include "upscale.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+
+#include "simd.hpp"
+
+namespace
+{
+	using upscale::Filter;
+
+	// pixels repeated past both ends of the padded rows, xBRZ looks two away
+	uint32_t constexpr padding = 2;
+
+	// the rows from y - 2 to y + 2, rows[2] is the one being scaled. Every one can be read
+	// padding pixels before 0 and after width.
+	using Rows = uint32_t const* const*;
+
+	uint32_t channel(uint32_t color, int shift)
+	{
+		return color >> shift & 0xFF;
+	}
+
+	void nearestPixel(Rows rows, size_t x, uint32_t* out, size_t stride)
+	{
+		for (size_t line = 0; line < 4; line++)
+			std::fill_n(out + line * stride + x * 4, 4, rows[2][x]);
+	}
+
+	// the AdvMAME rules, a corner takes the neighbours' colour where they meet and nothing else does
+	void scale2xPixel(Rows rows, size_t x, uint32_t* out, size_t stride)
+	{
+		uint32_t const b = rows[1][x];
+		uint32_t const* const row = rows[2] + x;
+		uint32_t const d = row[-1], e = row[0], f = row[1];
+		uint32_t const h = rows[3][x];
+		out += x * 2;
+		out[0] = d == b && b != f && d != h ? d : e;
+		out[1] = b == f && b != d && f != h ? f : e;
+		out[stride] = d == h && d != b && h != f ? d : e;
+		out[stride + 1] = h == f && h != d && f != b ? f : e;
+	}
+
+	void scale3xPixel(Rows rows, size_t x, uint32_t* out, size_t stride)
+	{
+		uint32_t const* const up = rows[1] + x;
+		uint32_t const* const row = rows[2] + x;
+		uint32_t const* const down = rows[3] + x;
+		uint32_t const a = up[-1], b = up[0], c = up[1];
+		uint32_t const d = row[-1], e = row[0], f = row[1];
+		uint32_t const g = down[-1], h = down[0], i = down[1];
+		bool const topLeft = d == b && d != h && b != f;
+		bool const topRight = b == f && b != d && f != h;
+		bool const bottomLeft = d == h && d != b && h != f;
+		bool const bottomRight = h == f && d != h && b != f;
+		out += x * 3;
+		out[0] = topLeft ? d : e;
+		out[1] = (topLeft && e != c) || (topRight && e != a) ? b : e;
+		out[2] = topRight ? f : e;
+		out[stride] = (topLeft && e != g) || (bottomLeft && e != a) ? d : e;
+		out[stride + 1] = e;
+		out[stride + 2] = (topRight && e != i) || (bottomRight && e != c) ? f : e;
+		out[stride * 2] = bottomLeft ? d : e;
+		out[stride * 2 + 1] = (bottomLeft && e != i) || (bottomRight && e != g) ? h : e;
+		out[stride * 2 + 2] = bottomRight ? f : e;
+	}
+
+	// Y << 16 | U << 8 | V, the colour space hq2x compares in
+	uint32_t yuv(uint32_t color)
+	{
+		int const r = static_cast<int>(channel(color, 0));
+		int const g = static_cast<int>(channel(color, 8));
+		int const b = static_cast<int>(channel(color, 16));
+		int const y = (r + g + b) >> 2;
+		int const u = ((r - b) >> 2) + 128;
+		int const v = ((2 * g - r - b) >> 3) + 128;
+		return static_cast<uint32_t>(y << 16 | u << 8 | v);
+	}
+
+	// the hq2x thresholds
+	bool similar(uint32_t yuv0, uint32_t yuv1)
+	{
+		auto const difference = [&](int shift) { return std::abs(static_cast<int>(channel(yuv0, shift)) - static_cast<int>(channel(yuv1, shift))); };
+		return difference(16) <= 48 && difference(8) <= 7 && difference(0) <= 6;
+	}
+
+	// hq2x as a rule for the top left output pixel of each of the 256 patterns of neighbours that
+	// differ from e, the other three corners use the same rules with the neighbourhood turned.
+	// Interpolations are parts of 16 of e and of the corner's diagonal neighbour a, its vertical
+	// neighbour b and horizontal neighbour d; f and h are across from d and b.
+	namespace hq2x
+	{
+		// hq2x's interpolations of e and the neighbours named, Interp1 takes them 3:1, Interp2 2:1:1,
+		// Interp6 5:2:1 with the named one first, Interp7 6:1:1, Interp9 2:3:3 and Interp10 14:1:1
+		enum Formula : uint8_t
+		{
+			keep,
+			interp1A,
+			interp1D,
+			interp1B,
+			interp2,
+			interp2AB,
+			interp2AD,
+			interp6B,
+			interp6D,
+			interp7,
+			interp9,
+			interp10,
+			formulaCount,
+		};
+
+		// e | a << 8 | b << 16 | d << 24, each out of 16
+		uint32_t constexpr formulaWeights[formulaCount] =
+		{
+			16,
+			12 | 4 << 8,
+			12 | 4 << 24,
+			12 | 4 << 16,
+			8 | 4 << 16 | 4 << 24,
+			8 | 4 << 8 | 4 << 16,
+			8 | 4 << 8 | 4 << 24,
+			10 | 4 << 16 | 2 << 24,
+			10 | 2 << 16 | 4 << 24,
+			12 | 2 << 16 | 2 << 24,
+			4 | 6 << 16 | 6 << 24,
+			14 | 1 << 16 | 1 << 24,
+		};
+
+		// past the plain formulas, the rules that pick one from how two edge neighbours compare,
+		// bdInterp2ElseE is interp2 when b and d are alike and e when they aren't
+		enum Rule : uint8_t
+		{
+			bdInterp2ElseE = formulaCount,
+			bdInterp10ElseE,
+			bdInterp7ElseE,
+			bdInterp2ElseA,
+			bdInterp7ElseA,
+			bdInterp9ElseA,
+			bfInterp6ElseD,
+			dhInterp6ElseB,
+		};
+
+		// indexed on the differing neighbours, bit 0 to 7 for w1 w2 w3 w4 w6 w7 w8 w9 of
+		// w1 w2 w3 / w4 e w6 / w7 w8 w9
+		uint8_t constexpr rules[256] =
+		{
+			interp2, interp2, interp2AD, interp1D, interp2, interp2, interp2AD, interp1D, interp2AB, interp1B, bdInterp2ElseA, bdInterp2ElseE, interp2AB, interp1B, bdInterp9ElseA, bdInterp10ElseE,
+			interp2, interp2, interp2AD, bfInterp6ElseD, interp2, interp2, interp2AD, bfInterp6ElseD, interp2AB, interp1B, bdInterp2ElseE, bdInterp2ElseE, interp2AB, interp1B, interp1A, bdInterp2ElseE,
+			interp2, interp2, interp2AD, interp1D, interp2, interp2, interp2AD, interp1D, interp2AB, interp1B, bdInterp9ElseA, bdInterp10ElseE, interp2AB, interp1B, bdInterp7ElseA, bdInterp7ElseE,
+			interp2, interp2, interp2AD, bfInterp6ElseD, interp2, interp2, interp2AD, bfInterp6ElseD, interp2AB, interp1B, bdInterp7ElseA, bdInterp2ElseE, interp2AB, interp1B, interp1A, bdInterp7ElseE,
+			interp2, interp2, interp2AD, interp1D, interp2, interp2, interp2AD, interp1D, interp2AB, dhInterp6ElseB, bdInterp2ElseE, bdInterp2ElseE, interp2AB, dhInterp6ElseB, bdInterp7ElseA, bdInterp2ElseE,
+			interp2, interp2, interp2AD, interp1D, interp2, interp2, interp2AD, interp1D, interp2AB, interp1B, bdInterp7ElseA, bdInterp2ElseE, interp2AB, interp1B, bdInterp7ElseA, bdInterp2ElseE,
+			interp2, interp2, interp2AD, interp1D, interp2, interp2, interp2AD, interp1D, interp2AB, dhInterp6ElseB, interp1A, bdInterp2ElseE, interp2AB, dhInterp6ElseB, interp1A, bdInterp7ElseE,
+			interp2, interp2, interp2AD, interp1D, interp2, interp2, interp2AD, bfInterp6ElseD, interp2AB, interp1B, bdInterp7ElseA, bdInterp2ElseE, interp2AB, dhInterp6ElseB, interp1A, bdInterp7ElseE,
+			interp2, interp2, interp2AD, interp1D, interp2, interp2, interp2AD, interp1D, interp2AB, interp1B, bdInterp2ElseA, bdInterp2ElseE, interp2AB, interp1B, bdInterp9ElseA, bdInterp10ElseE,
+			interp2, interp2, interp2AD, interp1D, interp2, interp2, interp2AD, interp1D, interp2AB, interp1B, bdInterp7ElseA, bdInterp2ElseE, interp2AB, interp1B, bdInterp7ElseA, bdInterp2ElseE,
+			interp2, interp2, interp2AD, interp1D, interp2, interp2, interp2AD, interp1D, interp2AB, interp1B, bdInterp9ElseA, bdInterp10ElseE, interp2AB, interp1B, bdInterp7ElseA, bdInterp7ElseE,
+			interp2, interp2, interp2AD, interp1D, interp2, interp2, interp2AD, interp1D, interp2AB, interp1B, bdInterp7ElseA, bdInterp10ElseE, interp2AB, interp1B, interp1A, bdInterp7ElseE,
+			interp2, interp2, interp2AD, interp1D, interp2, interp2, interp2AD, interp1D, interp2AB, interp1B, bdInterp7ElseA, bdInterp2ElseE, interp2AB, interp1B, bdInterp7ElseA, bdInterp10ElseE,
+			interp2, interp2, interp2AD, interp1D, interp2, interp2, interp2AD, interp1D, interp2AB, interp1B, bdInterp7ElseA, bdInterp2ElseE, interp2AB, interp1B, interp1A, bdInterp2ElseE,
+			interp2, interp2, interp2AD, interp1D, interp2, interp2, interp2AD, interp1D, interp2AB, interp1B, bdInterp7ElseA, bdInterp2ElseE, interp2AB, interp1B, interp1A, bdInterp7ElseE,
+			interp2, interp2, interp2AD, interp1D, interp2, interp2, interp2AD, interp1D, interp2AB, interp1B, interp1A, bdInterp2ElseE, interp2AB, interp1B, interp1A, bdInterp7ElseE,
+		};
+
+		// The neighbours go clockwise from the top left, w1 w2 w3 w6 w9 w8 w7 w4, so turning the
+		// neighbourhood a quarter is a rotation of the ring by two. The edge neighbours at odd
+		// positions are compared with the next one, bit k for positions 2k + 1 and 2k + 3.
+		// Indexed on ring differences << 4 | edge similarities, both turned to the corner.
+		std::array<uint8_t, 256 * 16> constexpr formulas = []
+		{
+			// the rules bit of each ring position
+			int constexpr patternBit[8] = { 0, 1, 2, 4, 7, 6, 5, 3 };
+			std::array<uint8_t, 256 * 16> table = {};
+			for (uint32_t ring = 0; ring < 256; ring++)
+			{
+				uint32_t pattern = 0;
+				for (int position = 0; position < 8; position++)
+					pattern |= (ring >> position & 1) << patternBit[position];
+				for (uint32_t edges = 0; edges < 16; edges++)
+				{
+					// b is at 1, d at 7, f at 3 and h at 5
+					bool const bf = edges & 1, dh = edges & 4, bd = edges & 8;
+					uint8_t formula = rules[pattern];
+					switch (formula)
+					{
+						case bdInterp2ElseE: formula = bd ? interp2 : keep; break;
+						case bdInterp10ElseE: formula = bd ? interp10 : keep; break;
+						case bdInterp7ElseE: formula = bd ? interp7 : keep; break;
+						case bdInterp2ElseA: formula = bd ? interp2 : interp1A; break;
+						case bdInterp7ElseA: formula = bd ? interp7 : interp1A; break;
+						case bdInterp9ElseA: formula = bd ? interp9 : interp1A; break;
+						case bfInterp6ElseD: formula = bf ? interp6B : interp1D; break;
+						case dhInterp6ElseB: formula = dh ? interp6D : interp1B; break;
+						default: break;
+					}
+					table[ring << 4 | edges] = formula;
+				}
+			}
+			return table;
+		}();
+
+		// both masks turned so the corner is the top left one
+		uint8_t formula(uint32_t differs, uint32_t edgesSimilar, int corner)
+		{
+			uint32_t const ring = (differs >> corner * 2 | differs << (8 - corner * 2)) & 0xFF;
+			uint32_t const edges = (edgesSimilar >> corner | edgesSimilar << (4 - corner)) & 0xF;
+			return formulas[ring << 4 | edges];
+		}
+
+		uint32_t blend(uint32_t e, uint32_t a, uint32_t b, uint32_t d, uint8_t formula)
+		{
+			uint32_t const weights = formulaWeights[formula];
+			uint32_t result = 0;
+			for (int c = 0; c < 32; c += 8)
+			{
+				uint32_t const sum = channel(e, c) * (weights & 0xFF) + channel(a, c) * channel(weights, 8)
+					+ channel(b, c) * channel(weights, 16) + channel(d, c) * channel(weights, 24);
+				result |= sum >> 4 << c;
+			}
+			return result;
+		}
+
+		// the corners in ring order, top left, top right, bottom right, bottom left
+		void store(uint32_t* out, size_t stride, uint32_t const corners[4])
+		{
+			out[0] = corners[0];
+			out[1] = corners[1];
+			out[stride + 1] = corners[2];
+			out[stride] = corners[3];
+		}
+	}
+
+	// a blend of e with copies of itself is e, the flat pixels most of a screen is made of skip the patterns
+	void hq2xPixel(Rows rows, Rows yuvRows, size_t x, uint32_t* out, size_t stride)
+	{
+		uint32_t const ring[8] = { rows[1][x - 1], rows[1][x], rows[1][x + 1], rows[2][x + 1], rows[3][x + 1], rows[3][x], rows[3][x - 1], rows[2][x - 1] };
+		uint32_t const yuvRing[8] = { yuvRows[1][x - 1], yuvRows[1][x], yuvRows[1][x + 1], yuvRows[2][x + 1],
+			yuvRows[3][x + 1], yuvRows[3][x], yuvRows[3][x - 1], yuvRows[2][x - 1] };
+		uint32_t const e = rows[2][x];
+		if (std::all_of(ring, ring + 8, [e](uint32_t color) { return color == e; }))
+		{
+			std::fill_n(out + x * 2, 2, e);
+			std::fill_n(out + stride + x * 2, 2, e);
+			return;
+		}
+		uint32_t differs = 0;
+		for (int i = 0; i < 8; i++)
+			differs |= !similar(yuvRows[2][x], yuvRing[i]) << i;
+		uint32_t edgesSimilar = 0;
+		for (int i = 0; i < 4; i++)
+			edgesSimilar |= similar(yuvRing[i * 2 + 1], yuvRing[(i * 2 + 3) & 7]) << i;
+
+		uint32_t corners[4];
+		for (int corner = 0; corner < 4; corner++)
+		{
+			uint32_t const a = ring[corner * 2], b = ring[corner * 2 + 1], d = ring[(corner * 2 + 7) & 7];
+			corners[corner] = hq2x::blend(e, a, b, d, hq2x::formula(differs, edgesSimilar, corner));
+		}
+		hq2x::store(out + x * 2, stride, corners);
+	}
+
+	// xBRZ at 4x: each 2x2 block whose diagonal carries an edge has the corners it cuts blended
+	// with the colour across, along a shallow, steep or 45 degree line or only around the corner.
+	// Every corner is drawn as the bottom right one of the kernel turned a quarter at a time.
+	namespace xbrz
+	{
+		float constexpr equalTolerance = 30;
+		float constexpr dominantThreshold = 3.6f;
+		float constexpr steepThreshold = 2.2f;
+
+		// YCbCr weights, BT.2020
+		float constexpr redWeight = 0.2627f;
+		float constexpr blueWeight = 0.0593f;
+		float constexpr greenWeight = 1 - redWeight - blueWeight;
+		float constexpr blueScale = 0.5f / (1 - blueWeight);
+		float constexpr redScale = 0.5f / (1 - redWeight);
+
+		enum Blend : uint8_t
+		{
+			none,
+			normal,
+			dominant,
+		};
+
+		// corners in the order the kernel turns to them
+		enum Corner : uint8_t
+		{
+			bottomRight,
+			topRight,
+			topLeft,
+			bottomLeft,
+		};
+
+		float distance(uint32_t color0, uint32_t color1)
+		{
+			float const r = static_cast<float>(static_cast<int>(channel(color0, 0)) - static_cast<int>(channel(color1, 0)));
+			float const g = static_cast<float>(static_cast<int>(channel(color0, 8)) - static_cast<int>(channel(color1, 8)));
+			float const b = static_cast<float>(static_cast<int>(channel(color0, 16)) - static_cast<int>(channel(color1, 16)));
+			float const y = redWeight * r + greenWeight * g + blueWeight * b;
+			float const cb = blueScale * (b - y);
+			float const cr = redScale * (r - y);
+			return std::sqrt(y * y + cb * cb + cr * cr);
+		}
+
+		void distances(uint32_t const* colors0, uint32_t const* colors1, size_t count, float* out)
+		{
+			for (size_t i = 0; i < count; i++)
+				out[i] = distance(colors0[i], colors1[i]);
+		}
+
+		// All but two of the distances a pixel needs are between neighbours, worked out once for
+		// every padded pixel instead of again for each kernel around it. Laid out like the padded rows.
+		enum Neighbour : uint8_t
+		{
+			right,
+			down,
+			downRight,
+			downLeft,
+		};
+
+		struct Distances
+		{
+			uint32_t const* pixels;
+			float const* tables[4];
+
+			float operator()(Neighbour neighbour, uint32_t const* pixel) const
+			{
+				return tables[neighbour][pixel - pixels];
+			}
+		};
+
+		// two bits of Blend a corner
+		uint8_t cornerBlend(Blend blend, Corner corner)
+		{
+			return static_cast<uint8_t>(blend << corner * 2);
+		}
+
+		Blend blendOf(uint8_t blends, int corner)
+		{
+			return static_cast<Blend>(blends >> (corner & 3) * 2 & 3);
+		}
+
+		// the corners the 2x2 block with f at its top left cuts in its middle, from the 4x4 pixels
+		// around it. rowStep is the distance between two padded rows, blends one byte per pixel.
+		void blockBlends(uint32_t const* f, ptrdiff_t rowStep, Distances const& distances, uint8_t* blends, ptrdiff_t blendStep)
+		{
+			uint32_t const* const g = f + 1;
+			uint32_t const* const j = f + rowStep;
+			uint32_t const* const k = j + 1;
+			if ((*f == *g && *j == *k) || (*f == *j && *g == *k))
+				return;
+			// gradients along both diagonals, the lower one is the edge
+			float const jg = distances(downLeft, f) + distances(downLeft, g - rowStep) + distances(downLeft, k) + distances(downLeft, k - rowStep + 1)
+				+ 4 * distances(downLeft, g);
+			float const fk = distances(downRight, f - 1) + distances(downRight, j) + distances(downRight, f - rowStep) + distances(downRight, g)
+				+ 4 * distances(downRight, f);
+			if (jg < fk)
+			{
+				Blend const blend = dominantThreshold * jg < fk ? dominant : normal;
+				if (*f != *g && *f != *j)
+					blends[0] |= cornerBlend(blend, bottomRight);
+				if (*k != *j && *k != *g)
+					blends[blendStep + 1] |= cornerBlend(blend, topLeft);
+			}
+			else if (fk < jg)
+			{
+				Blend const blend = dominantThreshold * fk < jg ? dominant : normal;
+				if (*j != *f && *j != *k)
+					blends[blendStep] |= cornerBlend(blend, topRight);
+				if (*g != *f && *g != *k)
+					blends[1] |= cornerBlend(blend, bottomLeft);
+			}
+		}
+
+		// the 3x3 pixels around one, turned so the corner drawn is the bottom right one
+		struct Kernel
+		{
+			uint32_t const* center;
+			// source steps of one pixel right and one down as the kernel sees them
+			ptrdiff_t stepX;
+			ptrdiff_t stepY;
+			ptrdiff_t rowStep;
+			Distances const* distances;
+
+			Kernel(uint32_t const* center, ptrdiff_t rowStep, int corner, Distances const& distances)
+				: center(center), rowStep(rowStep), distances(&distances)
+			{
+				ptrdiff_t const steps[4][2] = { { 1, rowStep }, { -rowStep, 1 }, { -1, -rowStep }, { rowStep, -1 } };
+				stepX = steps[corner][0];
+				stepY = steps[corner][1];
+			}
+
+			uint32_t const* pixel(int dx, int dy) const
+			{
+				return center + dx * stepX + dy * stepY;
+			}
+
+			uint32_t operator()(int dx, int dy) const
+			{
+				return *pixel(dx, dy);
+			}
+
+			// between two neighbouring pixels, from the tables
+			float distance(int dx0, int dy0, int dx1, int dy1) const
+			{
+				uint32_t const* first = pixel(dx0, dy0);
+				uint32_t const* second = pixel(dx1, dy1);
+				if (first > second)
+					std::swap(first, second);
+				ptrdiff_t const step = second - first;
+				Neighbour const neighbour = step == 1 ? right : step == rowStep ? down : step > rowStep ? downRight : downLeft;
+				return (*distances)(neighbour, first);
+			}
+
+			bool equal(int dx0, int dy0, int dx1, int dy1) const
+			{
+				return distance(dx0, dy0, dx1, dy1) < equalTolerance;
+			}
+		};
+
+		// one 4x4 output block turned like the kernel
+		struct Block
+		{
+			uint32_t* origin;
+			// output steps of one row and one column down and right as the kernel sees them
+			ptrdiff_t rowStep;
+			ptrdiff_t columnStep;
+			int corner;
+
+			Block(uint32_t* out, size_t stride, int corner)
+				: corner(corner)
+			{
+				ptrdiff_t const line = static_cast<ptrdiff_t>(stride);
+				ptrdiff_t const origins[4] = { 0, 3 * line, 3 * line + 3, 3 };
+				ptrdiff_t const steps[4][2] = { { line, 1 }, { 1, -line }, { -line, -1 }, { -1, line } };
+				origin = out + origins[corner];
+				rowStep = steps[corner][0];
+				columnStep = steps[corner][1];
+			}
+
+			uint32_t& operator()(int row, int column) const
+			{
+				return origin[row * rowStep + column * columnStep];
+			}
+		};
+
+		// m / n of color over the pixel, constants so the division is a multiply
+		template<uint32_t m, uint32_t n>
+		void blendOver(uint32_t& pixel, uint32_t color)
+		{
+			uint32_t result = 0;
+			for (int c = 0; c < 32; c += 8)
+				result |= (channel(color, c) * m + channel(pixel, c) * (n - m)) / n << c;
+			pixel = result;
+		}
+
+		void blendCorner(Kernel const& at, Block const& block, uint8_t blends)
+		{
+			Blend const blend = blendOf(blends, block.corner);
+			uint32_t const b = at(0, -1), c = at(1, -1);
+			uint32_t const d = at(-1, 0), e = at(0, 0), f = at(1, 0);
+			uint32_t const g = at(-1, 1), h = at(0, 1);
+			bool lineBlend = true;
+			if (blend != dominant)
+			{
+				// another corner of the pixel cut too, unless it's a 90 degree one, leaves single pixels alone
+				if (blendOf(blends, block.corner + 1) != none && !at.equal(0, 0, -1, 1))
+					lineBlend = false;
+				else if (blendOf(blends, block.corner + 3) != none && !at.equal(0, 0, 1, -1))
+					lineBlend = false;
+				// L shapes only get the corner rounded
+				else if (!at.equal(0, 0, 1, 1) && at.equal(-1, 1, 0, 1) && at.equal(0, 1, 1, 1) && at.equal(1, 1, 1, 0) && at.equal(1, 0, 1, -1))
+					lineBlend = false;
+			}
+
+			uint32_t const color = at.distance(0, 0, 1, 0) <= at.distance(0, 0, 0, 1) ? f : h;
+			if (!lineBlend)
+			{
+				blendOver<68, 100>(block(3, 3), color);
+				blendOver<9, 100>(block(3, 2), color);
+				blendOver<9, 100>(block(2, 3), color);
+				return;
+			}
+
+			float const fg = distance(f, g);
+			float const hc = distance(h, c);
+			bool const shallow = steepThreshold * fg <= hc && e != g && d != g;
+			bool const steep = steepThreshold * hc <= fg && e != c && b != c;
+			if (shallow && steep)
+			{
+				blendOver<3, 4>(block(3, 1), color);
+				blendOver<3, 4>(block(1, 3), color);
+				blendOver<1, 4>(block(3, 0), color);
+				blendOver<1, 4>(block(0, 3), color);
+				blendOver<1, 3>(block(2, 2), color);
+				block(3, 3) = block(3, 2) = block(2, 3) = color;
+			}
+			else if (shallow)
+			{
+				blendOver<1, 4>(block(3, 0), color);
+				blendOver<1, 4>(block(2, 2), color);
+				blendOver<3, 4>(block(3, 1), color);
+				blendOver<3, 4>(block(2, 3), color);
+				block(3, 2) = block(3, 3) = color;
+			}
+			else if (steep)
+			{
+				blendOver<1, 4>(block(0, 3), color);
+				blendOver<1, 4>(block(2, 2), color);
+				blendOver<3, 4>(block(1, 3), color);
+				blendOver<3, 4>(block(3, 2), color);
+				block(2, 3) = block(3, 3) = color;
+			}
+			else
+			{
+				blendOver<1, 2>(block(3, 2), color);
+				blendOver<1, 2>(block(2, 3), color);
+				block(3, 3) = color;
+			}
+		}
+
+		void pixel(Rows rows, Distances const& distances, uint8_t blends, size_t x, uint32_t* out, size_t stride)
+		{
+			out += x * 4;
+			for (size_t line = 0; line < 4; line++)
+				std::fill_n(out + line * stride, 4, rows[2][x]);
+			if (blends == 0)
+				return;
+			ptrdiff_t const rowStep = rows[3] - rows[2];
+			for (int corner = 0; corner < 4; corner++)
+				if (blendOf(blends, corner) != none)
+					blendCorner({ rows[2] + x, rowStep, corner, distances }, { out, stride, corner }, blends);
+		}
+	}
+
+	// the buffers of a band
+	struct Scratch
+	{
+		std::vector<uint32_t> padded;
+		std::vector<uint32_t> yuv;
+		std::vector<float> distances;
+		std::vector<uint8_t> blends;
+	};
+
+	// what the kernels read around one row
+	struct Line
+	{
+		// rows y - 2 to y + 2, rows[2] is the one scaled. Every one can be read padding pixels
+		// before 0 and after width.
+		uint32_t const* rows[5];
+		// hq2x, the same rows as packed YUV
+		uint32_t const* yuvRows[5];
+		// xBRZ, the blends of each pixel of the row
+		xbrz::Distances const* distances;
+		uint8_t const* blends;
+	};
+
+	void scalarRow(Filter filter, Line const& line, size_t first, size_t width, uint32_t* out, size_t stride)
+	{
+		for (size_t x = first; x < width; x++)
+		{
+			switch (filter)
+			{
+				case Filter::nearest: nearestPixel(line.rows, x, out, stride); break;
+				case Filter::scale2x: scale2xPixel(line.rows, x, out, stride); break;
+				case Filter::scale3x: scale3xPixel(line.rows, x, out, stride); break;
+				case Filter::hq2x: hq2xPixel(line.rows, line.yuvRows, x, out, stride); break;
+				case Filter::xbrz: xbrz::pixel(line.rows, *line.distances, line.blends[x], x, out, stride); break;
+				default: out[x] = line.rows[2][x]; break;
+			}
+		}
+	}
+
+#if GB_SIMD_X86
+	__m128i load(uint32_t const* pixels)
+	{
+		return _mm_loadu_si128(reinterpret_cast<__m128i const*>(pixels));
+	}
+
+	void store(uint32_t* pixels, __m128i v)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pixels), v);
+	}
+
+	// lanes of a where mask is set, of b elsewhere
+	__m128i select(__m128i mask, __m128i a, __m128i b)
+	{
+		return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+	}
+
+	// mask set where a is, and neither b nor c
+	__m128i onlyFirst(__m128i a, __m128i b, __m128i c)
+	{
+		return _mm_andnot_si128(_mm_or_si128(b, c), a);
+	}
+
+	// a0 b0 c0 a1 b1 c1 a2 b2 c2 a3 b3 c3, the 3x output of 4 pixels
+	void store3(uint32_t* pixels, __m128i a, __m128i b, __m128i c)
+	{
+		__m128 const ab[2] = { _mm_castsi128_ps(_mm_unpacklo_epi32(a, b)), _mm_castsi128_ps(_mm_unpackhi_epi32(a, b)) };
+		__m128 const bc[2] = { _mm_castsi128_ps(_mm_unpacklo_epi32(b, c)), _mm_castsi128_ps(_mm_unpackhi_epi32(b, c)) };
+		__m128 const ca[2] = { _mm_castsi128_ps(_mm_unpacklo_epi32(c, a)), _mm_castsi128_ps(_mm_unpackhi_epi32(c, a)) };
+		store(pixels, _mm_castps_si128(_mm_shuffle_ps(ab[0], ca[0], _MM_SHUFFLE(3, 0, 1, 0))));
+		store(pixels + 4, _mm_castps_si128(_mm_shuffle_ps(bc[0], ab[1], _MM_SHUFFLE(1, 0, 3, 2))));
+		store(pixels + 8, _mm_castps_si128(_mm_shuffle_ps(ca[1], bc[1], _MM_SHUFFLE(3, 2, 3, 0))));
+	}
+
+	size_t nearestSse2(Rows rows, size_t width, uint32_t* out, size_t stride)
+	{
+		size_t x = 0;
+		for (; x + 4 <= width; x += 4)
+		{
+			__m128i const v = load(rows[2] + x);
+			__m128i const spread[4] = { _mm_shuffle_epi32(v, 0x00), _mm_shuffle_epi32(v, 0x55), _mm_shuffle_epi32(v, 0xAA), _mm_shuffle_epi32(v, 0xFF) };
+			for (size_t line = 0; line < 4; line++)
+				for (size_t i = 0; i < 4; i++)
+					store(out + line * stride + (x + i) * 4, spread[i]);
+		}
+		return x;
+	}
+
+	size_t scale2xSse2(Rows rows, size_t width, uint32_t* out, size_t stride)
+	{
+		size_t x = 0;
+		for (; x + 4 <= width; x += 4)
+		{
+			__m128i const b = load(rows[1] + x);
+			__m128i const d = load(rows[2] + x - 1), e = load(rows[2] + x), f = load(rows[2] + x + 1);
+			__m128i const h = load(rows[3] + x);
+			__m128i const db = _mm_cmpeq_epi32(d, b), bf = _mm_cmpeq_epi32(b, f);
+			__m128i const dh = _mm_cmpeq_epi32(d, h), hf = _mm_cmpeq_epi32(h, f);
+			__m128i const topLeft = select(onlyFirst(db, bf, dh), d, e);
+			__m128i const topRight = select(onlyFirst(bf, db, hf), f, e);
+			__m128i const bottomLeft = select(onlyFirst(dh, db, hf), d, e);
+			__m128i const bottomRight = select(onlyFirst(hf, dh, bf), f, e);
+			store(out + x * 2, _mm_unpacklo_epi32(topLeft, topRight));
+			store(out + x * 2 + 4, _mm_unpackhi_epi32(topLeft, topRight));
+			store(out + stride + x * 2, _mm_unpacklo_epi32(bottomLeft, bottomRight));
+			store(out + stride + x * 2 + 4, _mm_unpackhi_epi32(bottomLeft, bottomRight));
+		}
+		return x;
+	}
+
+	size_t scale3xSse2(Rows rows, size_t width, uint32_t* out, size_t stride)
+	{
+		size_t x = 0;
+		for (; x + 4 <= width; x += 4)
+		{
+			__m128i const a = load(rows[1] + x - 1), b = load(rows[1] + x), c = load(rows[1] + x + 1);
+			__m128i const d = load(rows[2] + x - 1), e = load(rows[2] + x), f = load(rows[2] + x + 1);
+			__m128i const g = load(rows[3] + x - 1), h = load(rows[3] + x), i = load(rows[3] + x + 1);
+			__m128i const db = _mm_cmpeq_epi32(d, b), bf = _mm_cmpeq_epi32(b, f);
+			__m128i const dh = _mm_cmpeq_epi32(d, h), hf = _mm_cmpeq_epi32(h, f);
+			__m128i const topLeft = onlyFirst(db, dh, bf);
+			__m128i const topRight = onlyFirst(bf, db, hf);
+			__m128i const bottomLeft = onlyFirst(dh, db, hf);
+			__m128i const bottomRight = onlyFirst(hf, dh, bf);
+			// corners that hold when e differs from the pixel across from them
+			__m128i const ea = _mm_cmpeq_epi32(e, a), ec = _mm_cmpeq_epi32(e, c);
+			__m128i const eg = _mm_cmpeq_epi32(e, g), ei = _mm_cmpeq_epi32(e, i);
+			__m128i const top = _mm_or_si128(_mm_andnot_si128(ec, topLeft), _mm_andnot_si128(ea, topRight));
+			__m128i const left = _mm_or_si128(_mm_andnot_si128(eg, topLeft), _mm_andnot_si128(ea, bottomLeft));
+			__m128i const right = _mm_or_si128(_mm_andnot_si128(ei, topRight), _mm_andnot_si128(ec, bottomRight));
+			__m128i const bottom = _mm_or_si128(_mm_andnot_si128(ei, bottomLeft), _mm_andnot_si128(eg, bottomRight));
+			store3(out + x * 3, select(topLeft, d, e), select(top, b, e), select(topRight, f, e));
+			store3(out + stride + x * 3, select(left, d, e), e, select(right, f, e));
+			store3(out + stride * 2 + x * 3, select(bottomLeft, d, e), select(bottom, h, e), select(bottomRight, f, e));
+		}
+		return x;
+	}
+
+	void yuvSse2(uint32_t const* colors, size_t count, uint32_t* out)
+	{
+		__m128i const mask = _mm_set1_epi32(0xFF);
+		__m128i const half = _mm_set1_epi32(128);
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i const v = load(colors + i);
+			__m128i const r = _mm_and_si128(v, mask);
+			__m128i const g = _mm_and_si128(_mm_srli_epi32(v, 8), mask);
+			__m128i const b = _mm_and_si128(_mm_srli_epi32(v, 16), mask);
+			__m128i const y = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(r, g), b), 2);
+			__m128i const u = _mm_add_epi32(_mm_srai_epi32(_mm_sub_epi32(r, b), 2), half);
+			__m128i const chroma = _mm_add_epi32(_mm_srai_epi32(_mm_sub_epi32(_mm_sub_epi32(_mm_add_epi32(g, g), r), b), 3), half);
+			store(out + i, _mm_or_si128(_mm_or_si128(_mm_slli_epi32(y, 16), _mm_slli_epi32(u, 8)), chroma));
+		}
+		std::transform(colors + i, colors + count, out + i, yuv);
+	}
+
+	// mask set where two packed YUV pixels are within the hq2x thresholds
+	__m128i similarSse2(__m128i yuv0, __m128i yuv1)
+	{
+		// V, U, Y and the unused top byte
+		__m128i const thresholds = _mm_set1_epi32(static_cast<int>(0xFF300706));
+		__m128i const difference = _mm_or_si128(_mm_subs_epu8(yuv0, yuv1), _mm_subs_epu8(yuv1, yuv0));
+		return _mm_cmpeq_epi32(_mm_subs_epu8(difference, thresholds), _mm_setzero_si128());
+	}
+
+	// bit i of a movemask of 4 lanes moved to bit 0 of byte i
+	uint32_t laneBytes(int mask)
+	{
+		return static_cast<uint32_t>(mask) * 0x00204081 & 0x01010101;
+	}
+
+	// adds each channel times the weight at index of its pixel's weights, 16 bits a channel
+	template<int index>
+	void accumulate(__m128i color, __m128i weightsLow, __m128i weightsHigh, __m128i& low, __m128i& high)
+	{
+		int constexpr spread = index * 0x55;
+		__m128i const zero = _mm_setzero_si128();
+		low = _mm_add_epi16(low, _mm_mullo_epi16(_mm_unpacklo_epi8(color, zero), _mm_shufflehi_epi16(_mm_shufflelo_epi16(weightsLow, spread), spread)));
+		high = _mm_add_epi16(high, _mm_mullo_epi16(_mm_unpackhi_epi8(color, zero), _mm_shufflehi_epi16(_mm_shufflelo_epi16(weightsHigh, spread), spread)));
+	}
+
+	// hq2x::blend of 4 pixels, each with its own weights
+	__m128i hq2xBlendSse2(__m128i e, __m128i a, __m128i b, __m128i d, __m128i weights)
+	{
+		__m128i const zero = _mm_setzero_si128();
+		__m128i const weightsLow = _mm_unpacklo_epi8(weights, zero), weightsHigh = _mm_unpackhi_epi8(weights, zero);
+		__m128i low = zero, high = zero;
+		accumulate<0>(e, weightsLow, weightsHigh, low, high);
+		accumulate<1>(a, weightsLow, weightsHigh, low, high);
+		accumulate<2>(b, weightsLow, weightsHigh, low, high);
+		accumulate<3>(d, weightsLow, weightsHigh, low, high);
+		return _mm_packus_epi16(_mm_srli_epi16(low, 4), _mm_srli_epi16(high, 4));
+	}
+
+	// the patterns come from the vector compares, the table lookups are done a lane at a time
+	size_t hq2xSse2(Rows rows, Rows yuvRows, size_t width, uint32_t* out, size_t stride)
+	{
+		size_t x = 0;
+		for (; x + 4 <= width; x += 4)
+		{
+			// clockwise from the top left like hq2x::formula takes them
+			__m128i const ring[8] = { load(rows[1] + x - 1), load(rows[1] + x), load(rows[1] + x + 1), load(rows[2] + x + 1),
+				load(rows[3] + x + 1), load(rows[3] + x), load(rows[3] + x - 1), load(rows[2] + x - 1) };
+			__m128i const e = load(rows[2] + x);
+			__m128i flat = _mm_cmpeq_epi32(ring[0], e);
+			for (int i = 1; i < 8; i++)
+				flat = _mm_and_si128(flat, _mm_cmpeq_epi32(ring[i], e));
+			__m128i corners[4] = { e, e, e, e };
+			if (_mm_movemask_epi8(flat) != 0xFFFF)
+			{
+				__m128i const yuvRing[8] = { load(yuvRows[1] + x - 1), load(yuvRows[1] + x), load(yuvRows[1] + x + 1), load(yuvRows[2] + x + 1),
+					load(yuvRows[3] + x + 1), load(yuvRows[3] + x), load(yuvRows[3] + x - 1), load(yuvRows[2] + x - 1) };
+				__m128i const eYuv = load(yuvRows[2] + x);
+				// one byte a lane
+				uint32_t differs = 0;
+				for (int i = 0; i < 8; i++)
+					differs |= laneBytes(~_mm_movemask_ps(_mm_castsi128_ps(similarSse2(eYuv, yuvRing[i]))) & 0xF) << i;
+				uint32_t edgesSimilar = 0;
+				for (int i = 0; i < 4; i++)
+					edgesSimilar |= laneBytes(_mm_movemask_ps(_mm_castsi128_ps(similarSse2(yuvRing[i * 2 + 1], yuvRing[(i * 2 + 3) & 7])))) << i;
+
+				for (int corner = 0; corner < 4; corner++)
+				{
+					uint32_t weights[4];
+					uint32_t kept = 0;
+					for (int lane = 0; lane < 4; lane++)
+					{
+						uint8_t const formula = hq2x::formula(differs >> lane * 8 & 0xFF, edgesSimilar >> lane * 8 & 0xF, corner);
+						weights[lane] = hq2x::formulaWeights[formula];
+						kept += formula == hq2x::keep;
+					}
+					if (kept < 4)
+						corners[corner] = hq2xBlendSse2(e, ring[corner * 2], ring[corner * 2 + 1], ring[(corner * 2 + 7) & 7], load(weights));
+				}
+			}
+			// ring order, the bottom right corner comes before the bottom left one
+			store(out + x * 2, _mm_unpacklo_epi32(corners[0], corners[1]));
+			store(out + x * 2 + 4, _mm_unpackhi_epi32(corners[0], corners[1]));
+			store(out + stride + x * 2, _mm_unpacklo_epi32(corners[3], corners[2]));
+			store(out + stride + x * 2 + 4, _mm_unpackhi_epi32(corners[3], corners[2]));
+		}
+		return x;
+	}
+
+	// the same operations in the same order as xbrz::distance, the results match to the bit
+	void distancesSse2(uint32_t const* colors0, uint32_t const* colors1, size_t count, float* out)
+	{
+		__m128i const mask = _mm_set1_epi32(0xFF);
+		__m128 const redWeight = _mm_set1_ps(xbrz::redWeight);
+		__m128 const greenWeight = _mm_set1_ps(xbrz::greenWeight);
+		__m128 const blueWeight = _mm_set1_ps(xbrz::blueWeight);
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i const a = load(colors0 + i);
+			__m128i const b = load(colors1 + i);
+			__m128 const red = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+			__m128 const green = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(a, 8), mask), _mm_and_si128(_mm_srli_epi32(b, 8), mask)));
+			__m128 const blue = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(a, 16), mask), _mm_and_si128(_mm_srli_epi32(b, 16), mask)));
+			__m128 const y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(redWeight, red), _mm_mul_ps(greenWeight, green)), _mm_mul_ps(blueWeight, blue));
+			__m128 const cb = _mm_mul_ps(_mm_set1_ps(xbrz::blueScale), _mm_sub_ps(blue, y));
+			__m128 const cr = _mm_mul_ps(_mm_set1_ps(xbrz::redScale), _mm_sub_ps(red, y));
+			_mm_storeu_ps(out + i, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(y, y), _mm_mul_ps(cb, cb)), _mm_mul_ps(cr, cr))));
+		}
+		xbrz::distances(colors0 + i, colors1 + i, count - i, out + i);
+	}
+
+	// pixels the vector kernel did, the scalar one takes the rest of the row
+	size_t vectorRow(Filter filter, Line const& line, size_t width, uint32_t* out, size_t stride)
+	{
+		switch (filter)
+		{
+			case Filter::nearest: return nearestSse2(line.rows, width, out, stride);
+			case Filter::scale2x: return scale2xSse2(line.rows, width, out, stride);
+			case Filter::scale3x: return scale3xSse2(line.rows, width, out, stride);
+			case Filter::hq2x: return hq2xSse2(line.rows, line.yuvRows, width, out, stride);
+			default: return 0;
+		}
+	}
+#endif
+
+	// the xBRZ neighbour tables of padded rows, four of paddedWidth * paddedRows floats
+	void neighbourDistances(bool vectorized, uint32_t const* padded, size_t paddedWidth, size_t paddedRows, float* tables)
+	{
+		size_t const tableSize = paddedWidth * paddedRows;
+		auto const distances = [vectorized](uint32_t const* colors0, uint32_t const* colors1, size_t count, float* out)
+		{
+#if GB_SIMD_X86
+			if (vectorized)
+			{
+				distancesSse2(colors0, colors1, count, out);
+				return;
+			}
+#else
+			(void)vectorized;
+#endif
+			xbrz::distances(colors0, colors1, count, out);
+		};
+		for (size_t i = 0; i < paddedRows; i++)
+		{
+			uint32_t const* const row = padded + i * paddedWidth;
+			float* const out = tables + i * paddedWidth;
+			distances(row, row + 1, paddedWidth - 1, out + xbrz::right * tableSize);
+			// the last row is only ever the lower pixel
+			if (i + 1 == paddedRows)
+				continue;
+			distances(row, row + paddedWidth, paddedWidth, out + xbrz::down * tableSize);
+			distances(row, row + paddedWidth + 1, paddedWidth - 1, out + xbrz::downRight * tableSize);
+			distances(row + 1, row + paddedWidth, paddedWidth - 1, out + xbrz::downLeft * tableSize + 1);
+		}
+	}
+}
+
+namespace upscale
+{
+	char const* filterName(Filter filter)
+	{
+		switch (filter)
+		{
+			case Filter::nearest: return "Nearest 4x";
+			case Filter::scale2x: return "Scale2x";
+			case Filter::scale3x: return "Scale3x";
+			case Filter::hq2x: return "HQ2x";
+			case Filter::xbrz: return "xBRZ 4x";
+			default: return "None";
+		}
+	}
+
+	uint32_t factor(Filter filter)
+	{
+		switch (filter)
+		{
+			case Filter::nearest: return 4;
+			case Filter::scale2x: return 2;
+			case Filter::scale3x: return 3;
+			case Filter::hq2x: return 2;
+			case Filter::xbrz: return 4;
+			default: return 1;
+		}
+	}
+
+	void filterRows(Filter filter, bool vectorized, uint32_t const* source, uint32_t width, uint32_t height,
+		uint32_t firstRow, uint32_t endRow, uint32_t* destination)
+	{
+		if (firstRow >= endRow)
+			return;
+		uint32_t const scale = factor(filter);
+		size_t const stride = static_cast<size_t>(width) * scale;
+		if (filter == Filter::none)
+		{
+			std::memcpy(destination + firstRow * stride, source + firstRow * stride, (endRow - firstRow) * stride * sizeof(uint32_t));
+			return;
+		}
+
+		// kept between calls, the workers run a band each frame and would allocate it all again
+		thread_local Scratch scratch;
+
+		// the band's rows and the two past each end, edge pixels repeated around them
+		size_t const paddedWidth = width + padding * 2;
+		uint32_t const paddedRows = endRow - firstRow + padding * 2;
+		std::vector<uint32_t>& padded = scratch.padded;
+		padded.resize(paddedWidth * paddedRows);
+		std::vector<uint32_t>& yuvPadded = scratch.yuv;
+		yuvPadded.resize(filter == Filter::hq2x ? padded.size() : 0);
+		for (uint32_t i = 0; i < paddedRows; i++)
+		{
+			int64_t const y = std::clamp<int64_t>(static_cast<int64_t>(firstRow) + i - padding, 0, height - 1);
+			uint32_t const* const row = source + y * width;
+			uint32_t* const out = padded.data() + i * paddedWidth;
+			std::fill_n(out, padding, row[0]);
+			std::copy(row, row + width, out + padding);
+			std::fill_n(out + padding + width, padding, row[width - 1]);
+			if (yuvPadded.empty())
+				continue;
+#if GB_SIMD_X86
+			if (vectorized)
+			{
+				yuvSse2(out, paddedWidth, yuvPadded.data() + i * paddedWidth);
+				continue;
+			}
+#endif
+			std::transform(out, out + paddedWidth, yuvPadded.data() + i * paddedWidth, yuv);
+		}
+
+		// xBRZ decides the corners of the band's pixels from the blocks they're part of,
+		// those of the rows and columns just past the band included
+		xbrz::Distances distances = { padded.data(), {} };
+		size_t const blendWidth = width + 2;
+		std::vector<uint8_t>& blends = scratch.blends;
+		blends.clear();
+		if (filter == Filter::xbrz)
+		{
+			scratch.distances.resize(padded.size() * 4);
+			neighbourDistances(vectorized, padded.data(), paddedWidth, paddedRows, scratch.distances.data());
+			for (size_t i = 0; i < 4; i++)
+				distances.tables[i] = scratch.distances.data() + i * padded.size();
+			blends.resize(blendWidth * (endRow - firstRow + 2), 0);
+			for (uint32_t y = 0; y + 1 < endRow - firstRow + 2; y++)
+			{
+				uint32_t const* const row = padded.data() + (y + padding - 1) * paddedWidth + padding - 1;
+				for (size_t x = 0; x + 1 < blendWidth; x++)
+					xbrz::blockBlends(row + x, static_cast<ptrdiff_t>(paddedWidth), distances, blends.data() + y * blendWidth + x,
+						static_cast<ptrdiff_t>(blendWidth));
+			}
+		}
+
+		for (uint32_t y = firstRow; y < endRow; y++)
+		{
+			Line line = {};
+			for (uint32_t i = 0; i < 5; i++)
+			{
+				line.rows[i] = padded.data() + (y - firstRow + i) * paddedWidth + padding;
+				if (!yuvPadded.empty())
+					line.yuvRows[i] = yuvPadded.data() + (y - firstRow + i) * paddedWidth + padding;
+			}
+			line.distances = &distances;
+			if (!blends.empty())
+				line.blends = blends.data() + (y - firstRow + 1) * blendWidth + 1;
+			uint32_t* const out = destination + y * scale * stride;
+			size_t done = 0;
+#if GB_SIMD_X86
+			if (vectorized)
+				done = vectorRow(filter, line, width, out, stride);
+#else
+			(void)vectorized;
+#endif
+			scalarRow(filter, line, done, width, out, stride);
+		}
+	}
+}
+
+Upscaler::Upscaler(uint32_t threadCount)
+{
+	for (uint32_t band = 1; band < std::max(1u, threadCount); band++)
+		workers.emplace_back(&Upscaler::work, this, band);
+}
+
+Upscaler::~Upscaler()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	started.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+void Upscaler::run(upscale::Filter filter, uint32_t const* source, uint32_t width, uint32_t height, uint32_t* destination,
+	bool vectorized)
+{
+	// bands thinner than a few rows cost more in padding and wake ups than they save
+	uint32_t constexpr minimumBandRows = 8;
+	uint32_t const bands = std::clamp(height / minimumBandRows, 1u, threadCount());
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = { filter, vectorized, source, width, height, destination, bands };
+		pending = bands - 1;
+		generation++;
+	}
+	if (bands > 1)
+		started.notify_all();
+	runBand(0);
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [this] { return pending == 0; });
+}
+
+void Upscaler::work(uint32_t band)
+{
+	uint64_t done = 0;
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;)
+	{
+		started.wait(lock, [&] { return stopping || generation != done; });
+		if (stopping)
+			return;
+		done = generation;
+		if (band >= job.bands)
+			continue;
+		lock.unlock();
+		runBand(band);
+		lock.lock();
+		if (--pending == 0)
+			finished.notify_one();
+	}
+}
+
+void Upscaler::runBand(uint32_t band)
+{
+	uint32_t const firstRow = static_cast<uint32_t>(static_cast<uint64_t>(job.height) * band / job.bands);
+	uint32_t const endRow = static_cast<uint32_t>(static_cast<uint64_t>(job.height) * (band + 1) / job.bands);
+	upscale::filterRows(job.filter, job.vectorized, job.source, job.width, job.height, firstRow, endRow, job.destination);
+}
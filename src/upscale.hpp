@@ -0,0 +1,81 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Pixel art upscalers for the Game window, run on the cpu so they don't need a gpu shader.
+// Nearest, Scale2x, Scale3x and HQ2x take 4 pixels a step with SSE2, HQ2x looking its patterns up a
+// pixel at a time. xBRZ branches per pixel corner so only its colour distances are vectorized.
+// Images are RGBA in memory order, rows packed.
+namespace upscale
+{
+	enum class Filter : uint8_t
+	{
+		// the picture as it is, the gpu scales it
+		none,
+		nearest,
+		scale2x,
+		scale3x,
+		// hq2x, its 256 neighbourhood patterns as one table turned to each corner
+		hq2x,
+		xbrz,
+		count,
+	};
+
+	char const* filterName(Filter filter);
+	// output pixels per source pixel on each axis
+	uint32_t factor(Filter filter);
+
+	// scales source rows [firstRow, endRow) into destination, factor lines of width * factor pixels
+	// each, the first one at firstRow * factor. Neighbours past the edges repeat the edge pixels.
+	// vectorized picks the SSE2 kernels where the filter has some and the cpu runs them
+	void filterRows(Filter filter, bool vectorized, uint32_t const* source, uint32_t width, uint32_t height,
+		uint32_t firstRow, uint32_t endRow, uint32_t* destination);
+}
+
+// runs a filter over a whole image, the rows split in one band per thread. The workers stay
+// up between frames, waking one takes far less than the few hundred microseconds a frame is.
+class Upscaler
+{
+	public:
+
+	explicit Upscaler(uint32_t threadCount = std::thread::hardware_concurrency());
+	~Upscaler();
+	Upscaler(Upscaler const&) = delete;
+	Upscaler& operator=(Upscaler const&) = delete;
+
+	// destination holds width * height * factor(filter)^2 pixels, returns once it's all written
+	void run(upscale::Filter filter, uint32_t const* source, uint32_t width, uint32_t height, uint32_t* destination,
+		bool vectorized = true);
+	// the calling thread takes a band too
+	uint32_t threadCount() const { return static_cast<uint32_t>(workers.size()) + 1; }
+
+	private:
+
+	void work(uint32_t band);
+	void runBand(uint32_t band);
+
+	struct Job
+	{
+		upscale::Filter filter = upscale::Filter::none;
+		bool vectorized = true;
+		uint32_t const* source = nullptr;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t* destination = nullptr;
+		uint32_t bands = 0;
+	};
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable started;
+	std::condition_variable finished;
+	Job job;
+	// bumped for every job, a worker runs its band once per generation
+	uint64_t generation = 0;
+	uint32_t pending = 0;
+	bool stopping = false;
+};
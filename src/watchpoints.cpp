@@ -0,0 +1,118 @@
+#include "watchpoints.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+
+void Watchpoints::add(uint16_t first, uint16_t last, uint8_t kinds)
+{
+	if (first > last)
+		std::swap(first, last);
+	watchpoints.push_back({ first, last, kinds });
+	rebuild();
+}
+
+void Watchpoints::remove(size_t index)
+{
+	watchpoints.erase(watchpoints.begin() + index);
+	rebuild();
+}
+
+void Watchpoints::setEnabled(size_t index, bool enabled)
+{
+	watchpoints[index].enabled = enabled;
+	rebuild();
+}
+
+void Watchpoints::clear()
+{
+	watchpoints.clear();
+	pending.clear();
+	rebuild();
+}
+
+void Watchpoints::rebuild()
+{
+	std::fill(kinds.begin(), kinds.end(), 0);
+	std::fill(std::begin(pages), std::end(pages), 0);
+	armedCount = 0;
+	for (Watchpoint const& watchpoint : watchpoints)
+	{
+		if (!watchpoint.enabled)
+			continue;
+		armedCount++;
+		for (uint32_t address = watchpoint.first; address <= watchpoint.last; address++)
+		{
+			kinds[address] |= watchpoint.kinds;
+			pages[address >> 8] |= watchpoint.kinds;
+		}
+	}
+	dirty = true;
+}
+
+bool Watchpoints::queue(uint16_t address, uint8_t kind, uint8_t oldValue, uint8_t newValue)
+{
+	for (Watchpoint& watchpoint : watchpoints)
+	{
+		if (countHits && watchpoint.enabled && (watchpoint.kinds & kind) && address >= watchpoint.first && address <= watchpoint.last)
+			watchpoint.hits++;
+	}
+	pending.push_back({ address, 0, kind, oldValue, newValue });
+	return true;
+}
+
+char const* watchKindName(uint8_t kind)
+{
+	switch (kind)
+	{
+		case Watchpoints::read: return "read";
+		case Watchpoints::write: return "write";
+		default: return "change";
+	}
+}
+
+bool parseWatchpoint(std::string_view text, uint16_t& first, uint16_t& last, uint8_t& kinds)
+{
+	auto const parseHex = [&](size_t& pos, uint16_t& value) -> bool
+	{
+		while (pos < text.size() && isspace(static_cast<unsigned char>(text[pos])))
+			pos++;
+		if (text.substr(pos, 2) == "0x" || text.substr(pos, 2) == "0X")
+			pos += 2;
+		else if (pos < text.size() && text[pos] == '$')
+			pos++;
+		size_t const start = pos;
+		uint32_t result = 0;
+		for (; pos < text.size() && isxdigit(static_cast<unsigned char>(text[pos])) && result <= 0xFFFF; pos++)
+			result = result << 4 | (isdigit(static_cast<unsigned char>(text[pos])) ? text[pos] - '0' : tolower(text[pos]) - 'a' + 10);
+		value = static_cast<uint16_t>(result);
+		return pos > start && result <= 0xFFFF;
+	};
+
+	size_t pos = 0;
+	if (!parseHex(pos, first))
+		return false;
+	last = first;
+	if (pos < text.size() && text[pos] == '-' && !parseHex(++pos, last))
+		return false;
+	if (last < first)
+		return false;
+
+	kinds = Watchpoints::write;
+	if (pos < text.size() && text[pos] == ',')
+	{
+		kinds = 0;
+		for (pos++; pos < text.size(); pos++)
+		{
+			switch (tolower(text[pos]))
+			{
+				case 'r': kinds |= Watchpoints::read; break;
+				case 'w': kinds |= Watchpoints::write; break;
+				case 'c': kinds |= Watchpoints::change; break;
+				default: return false;
+			}
+		}
+		return kinds != 0;
+	}
+	return pos == text.size();
+}
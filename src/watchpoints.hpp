@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Memory watchpoints on address ranges. The MMU only calls in here for accesses to pages that have one,
+// hits are queued and the Gameboy reports them after the instruction with the pc filled in.
+class Watchpoints
+{
+	public:
+
+	// kinds, a change only hits when a write stores a different value
+	static uint8_t constexpr read = 1 << 0;
+	static uint8_t constexpr write = 1 << 1;
+	static uint8_t constexpr change = 1 << 2;
+
+	struct Watchpoint
+	{
+		uint16_t first;
+		uint16_t last;
+		uint8_t kinds;
+		bool enabled = true;
+		uint64_t hits = 0;
+	};
+
+	struct Hit
+	{
+		uint16_t address;
+		uint16_t pc; // start of the instruction that made the access
+		uint8_t kind;
+		uint8_t oldValue;
+		uint8_t newValue; // same as oldValue for reads
+	};
+
+	void add(uint16_t first, uint16_t last, uint8_t kinds);
+	void remove(size_t index);
+	void setEnabled(size_t index, bool enabled);
+	void clear();
+
+	bool armed() const { return armedCount > 0; }
+	std::vector<Watchpoint> const& list() const { return watchpoints; }
+
+	// watched kinds of a 256 byte page, what the MMU page flags are built from
+	uint8_t pageKinds(uint8_t page) const { return pages[page]; }
+
+	// called from the MMU slow path, return true when a hit was queued
+	bool onRead(uint16_t address, uint8_t value)
+	{
+		if (!(kinds[address] & read))
+			return false;
+		return queue(address, read, value, value);
+	}
+
+	bool onWrite(uint16_t address, uint8_t oldValue, uint8_t newValue)
+	{
+		uint8_t const watched = kinds[address];
+		if (watched & write)
+			return queue(address, write, oldValue, newValue);
+		if ((watched & change) && oldValue != newValue)
+			return queue(address, change, oldValue, newValue);
+		return false;
+	}
+
+	// hits of the last instruction, pc isn't known until it completes
+	std::vector<Hit> pending;
+	// stop the run on a hit, headless logging turns it off
+	bool breakOnHit = true;
+	// replays turn this off so the hit counters only count the first run
+	bool countHits = true;
+	// the MMU page flags have to be rebuilt before the next run
+	bool dirty = false;
+
+	private:
+
+	bool queue(uint16_t address, uint8_t kind, uint8_t oldValue, uint8_t newValue);
+	void rebuild();
+
+	std::vector<Watchpoint> watchpoints;
+	std::vector<uint8_t> kinds = std::vector<uint8_t>(0x10000);
+	uint8_t pages[0x100] = {};
+	uint32_t armedCount = 0;
+};
+
+char const* watchKindName(uint8_t kind);
+
+// "C000", "C000-C0FF" with an optional ",rwc" kind list, write when there's none
+bool parseWatchpoint(std::string_view text, uint16_t& first, uint16_t& last, uint8_t& kinds);
@@ -38,6 +38,7 @@
 // - v0.42 (2020/10/14): fix for . character in ASCII view always being greyed out.
 // - v0.43 (2021/03/12): added OptFooterExtraHeight to allow for custom drawing at the bottom of the editor [@leiradel]
 // - v0.44 (2021/03/12): use ImGuiInputTextFlags_AlwaysOverwrite in 1.82 + fix hardcoded width.
+// - local: added BgColorFn + UserData for per-byte background colors (as upstream v0.50).
 //
 // Todo/Bugs:
 // - This is generally old code, it should work but please don't use this as reference!
@@ -89,6 +90,8 @@ struct MemoryEditor
     ImU8            (*ReadFn)(const ImU8* data, size_t off);    // = 0      // optional handler to read bytes.
     void            (*WriteFn)(ImU8* data, size_t off, ImU8 d); // = 0      // optional handler to write bytes.
     bool            (*HighlightFn)(const ImU8* data, size_t off);//= 0      // optional handler to return Highlight property (to support non-contiguous highlighting).
+    ImU32           (*BgColorFn)(const ImU8* data, size_t off, void* user_data); // = 0 // optional handler to return custom background color of individual bytes (0 for none).
+    void*           UserData;                                   // = NULL   // user data forwarded to BgColorFn.
 
     // [Internal State]
     bool            ContentsWidthChanged;
@@ -121,6 +124,8 @@ struct MemoryEditor
         ReadFn = NULL;
         WriteFn = NULL;
         HighlightFn = NULL;
+        BgColorFn = NULL;
+        UserData = NULL;
 
         // State/Internals
         ContentsWidthChanged = false;
@@ -307,6 +312,19 @@ struct MemoryEditor
                     }
                     draw_list->AddRectFilled(pos, ImVec2(pos.x + highlight_width, pos.y + s.LineHeight), HighlightColor);
                 }
+                else if (ImU32 bg_color = BgColorFn ? BgColorFn(mem_data, addr, UserData) : 0)
+                {
+                    ImVec2 pos = ImGui::GetCursorScreenPos();
+                    float highlight_width = s.GlyphWidth * 2;
+                    bool is_next_byte_colored = (addr + 1 < mem_size) && BgColorFn(mem_data, addr + 1, UserData) != 0;
+                    if (is_next_byte_colored || (n + 1 == Cols))
+                    {
+                        highlight_width = s.HexCellWidth;
+                        if (OptMidColsCount > 0 && n > 0 && (n + 1) < Cols && ((n + 1) % OptMidColsCount) == 0)
+                            highlight_width += s.SpacingBetweenMidCols;
+                    }
+                    draw_list->AddRectFilled(pos, ImVec2(pos.x + highlight_width, pos.y + s.LineHeight), bg_color);
+                }
 
                 if (DataEditingAddr == addr)
                 {